@@ -0,0 +1,188 @@
+// Helpers shared by the benchmarks
+
+#pragma once
+
+#include <curl-asio.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <fstream>
+#endif
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+namespace benchmark
+{
+	typedef std::chrono::steady_clock clock_type;
+
+	inline double elapsed_ms(clock_type::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	}
+
+	// Sample below which the given fraction of all samples lies
+	inline double percentile(std::vector<double> samples, double fraction)
+	{
+		if (samples.empty())
+		{
+			return 0.0;
+		}
+
+		std::sort(samples.begin(), samples.end());
+		std::size_t index = static_cast<std::size_t>(fraction * (samples.size() - 1) + 0.5);
+		return samples[index];
+	}
+
+	// Peak resident set size of the process in MB, or 0 where it is not available
+	inline double peak_rss_mb()
+	{
+#if defined(_WIN32)
+		return 0.0;
+#else
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+		return usage.ru_maxrss / 1048576.0;
+#else
+		return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+	}
+
+	// Current resident memory of the process in MB which is not backed by files, or 0 where it is not available. Unlike peak_rss_mb, this leaves out pages of mapped files, which the system can write back and reclaim.
+	inline double anonymous_rss_mb()
+	{
+#if defined(__linux__)
+		std::ifstream status("/proc/self/status");
+		std::string field;
+
+		while (status >> field)
+		{
+			if (field == "RssAnon:")
+			{
+				double kilobytes = 0.0;
+				status >> kilobytes;
+				return kilobytes / 1024.0;
+			}
+		}
+#endif
+		return 0.0;
+	}
+
+	// User and system CPU time the process used so far in milliseconds, or 0 where it is not available
+	inline double cpu_ms()
+	{
+#if defined(_WIN32)
+		return 0.0;
+#else
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+#endif
+	}
+
+	// Records the outcome of an asynchronous operation
+	struct completion
+	{
+		completion():
+			done(false)
+		{
+		}
+
+		void handle(const asio::error_code& err)
+		{
+			result = err;
+			done = true;
+		}
+
+		bool done;
+		asio::error_code result;
+	};
+
+	// Buffer sink which consumes response bodies without keeping them
+	struct discard
+	{
+		std::size_t operator()(asio::const_buffer data) const
+		{
+			return asio::buffer_size(data);
+		}
+	};
+
+	inline double megabytes_per_second(double bytes, double ms)
+	{
+		return (ms > 0.0) ? bytes / 1e3 / ms : 0.0;
+	}
+
+	// Keeps a number of requests in flight until the given total has completed, recording their latencies. Responses with a status of 400 or above count as failures.
+	class request_loop
+	{
+	public:
+		typedef std::function<void(curl::easy& easy)> prepare_type;
+
+		request_loop(curl::multi& manager, std::size_t total, std::size_t concurrency, prepare_type prepare):
+			failures(0),
+			manager_(manager),
+			left_(total),
+			handles_(concurrency),
+			prepare_(prepare)
+		{
+		}
+
+		void run()
+		{
+			for (std::size_t i = 0; i < handles_.size(); ++i)
+			{
+				start(i);
+			}
+
+			manager_.get_io_service().run();
+			manager_.get_io_service().reset();
+		}
+
+		std::vector<double> latencies;
+		std::size_t failures;
+
+	private:
+		// Every slot holds the handle of its current request. Binding the handle into its own completion handler would keep it alive for good, as the easy keeps the handler.
+		void start(std::size_t slot)
+		{
+			if (left_ == 0)
+			{
+				return;
+			}
+
+			--left_;
+			handles_[slot] = std::make_shared<curl::easy>(manager_);
+			curl::easy& easy = *handles_[slot];
+			easy.set_buffer_sink(discard());
+			prepare_(easy);
+			easy.async_perform(std::bind(&request_loop::handle_request, this, slot, clock_type::now(), std::placeholders::_1));
+		}
+
+		void handle_request(std::size_t slot, clock_type::time_point start_time, const asio::error_code& err)
+		{
+			latencies.push_back(elapsed_ms(start_time));
+
+			if (err || handles_[slot]->get_reponse_code() >= 400)
+			{
+				++failures;
+			}
+
+			start(slot);
+		}
+
+		curl::multi& manager_;
+		std::size_t left_;
+		std::vector<std::shared_ptr<curl::easy> > handles_;
+		prepare_type prepare_;
+	};
+}
@@ -0,0 +1,119 @@
+#include "benchmark.h"
+
+// keeps a number of fetches in flight until the given total has completed
+class fetch_loop
+{
+public:
+	fetch_loop(curl::multi& manager, const std::string& url, bool chain, std::size_t total, std::size_t concurrency):
+		bytes(0),
+		failures(0),
+		manager_(manager),
+		url_(url),
+		chain_(chain),
+		left_(total),
+		handles_(concurrency)
+	{
+	}
+
+	void run()
+	{
+		for (std::size_t i = 0; i < handles_.size(); ++i)
+		{
+			start(i);
+		}
+
+		manager_.get_io_service().run();
+	}
+
+	std::size_t bytes;
+	std::size_t failures;
+
+private:
+	// every slot holds the handle of its current fetch, since the easy keeps its handler after completion
+	void start(std::size_t slot)
+	{
+		if (left_ == 0)
+		{
+			return;
+		}
+
+		--left_;
+		handles_[slot].reset(new curl::easy(manager_));
+		curl::easy& easy = *handles_[slot];
+		easy.set_url(url_);
+
+		if (chain_)
+		{
+			easy.async_fetch_chain(std::bind(&fetch_loop::handle_fetch_chain, this, slot, std::placeholders::_1, std::placeholders::_2));
+		}
+		else
+		{
+			easy.async_fetch(std::bind(&fetch_loop::handle_fetch, this, slot, std::placeholders::_1, std::placeholders::_2));
+		}
+	}
+
+	void handle_fetch(std::size_t slot, const asio::error_code& err, std::string body)
+	{
+		complete(slot, err, body.size());
+	}
+
+	void handle_fetch_chain(std::size_t slot, const asio::error_code& err, curl::chunk_chain body)
+	{
+		complete(slot, err, body.size());
+	}
+
+	void complete(std::size_t slot, const asio::error_code& err, std::size_t size)
+	{
+		bytes += size;
+
+		if (err)
+		{
+			++failures;
+		}
+
+		start(slot);
+	}
+
+	curl::multi& manager_;
+	std::string url_;
+	bool chain_;
+	std::size_t left_;
+	std::vector<std::unique_ptr<curl::easy> > handles_;
+};
+
+int main(int argc, char* argv[])
+{
+	// expect a url, a mode and optionally the number of requests and how many of them run at once
+	if (argc < 3 || argc > 5 || (std::string(argv[2]) != "string" && std::string(argv[2]) != "chain"))
+	{
+		std::cerr << "usage: " << argv[0] << " url string|chain [requests] [concurrency]" << std::endl;
+		return 1;
+	}
+
+	// peak RSS only ever grows, so every run measures a single mode
+	std::string url = argv[1];
+	bool chain = std::string(argv[2]) == "chain";
+	std::size_t requests = (argc >= 4) ? std::strtoul(argv[3], 0, 10) : 2000;
+	std::size_t concurrency = (argc == 5) ? std::strtoul(argv[4], 0, 10) : 64;
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+	fetch_loop loop(manager, url, chain, requests, concurrency);
+
+	double start_cpu = benchmark::cpu_ms();
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+	loop.run();
+	double ms = benchmark::elapsed_ms(start);
+
+	std::cout << (chain ? "async_fetch_chain" : "async_fetch") << ": " << loop.bytes << " bytes in " << ms << "ms, "
+		<< benchmark::megabytes_per_second(loop.bytes, ms) << "MB/s, CPU " << (benchmark::cpu_ms() - start_cpu) << "ms"
+		<< ", peak RSS " << benchmark::peak_rss_mb() << "MB, failed " << loop.failures << std::endl;
+
+	if (chain)
+	{
+		std::cout << "slabs allocated " << manager.get_buffer_pool()->get_slabs_allocated() << std::endl;
+	}
+
+	return 0;
+}
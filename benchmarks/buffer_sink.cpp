@@ -0,0 +1,114 @@
+#include "benchmark.h"
+#include <streambuf>
+
+// stream buffer which drops everything written to it, the cheapest sink an ostream can have
+class null_buffer:
+	public std::streambuf
+{
+protected:
+	int_type overflow(int_type c)
+	{
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(const char*, std::streamsize count)
+	{
+		return count;
+	}
+};
+
+class null_stream:
+	public std::ostream
+{
+public:
+	null_stream():
+		std::ostream(&buffer_)
+	{
+	}
+
+private:
+	null_buffer buffer_;
+};
+
+// counts the bytes it consumes, so both sinks do the same work with the data
+struct counting_sink
+{
+	explicit counting_sink(std::size_t& bytes):
+		bytes(bytes)
+	{
+	}
+
+	std::size_t operator()(asio::const_buffer data) const
+	{
+		bytes += asio::buffer_size(data);
+		return asio::buffer_size(data);
+	}
+
+	std::size_t& bytes;
+};
+
+void run_downloads(asio::io_service& io_service, curl::multi& manager, const std::string& url, bool buffer_sink, int rounds)
+{
+	std::size_t bytes = 0;
+	int failed = 0;
+	double start_cpu = benchmark::cpu_ms();
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+	for (int i = 0; i < rounds; ++i)
+	{
+		curl::easy easy(manager);
+		easy.set_url(url);
+
+		if (buffer_sink)
+		{
+			easy.set_buffer_sink(counting_sink(bytes));
+		}
+		else
+		{
+			easy.set_sink(std::make_shared<null_stream>());
+		}
+
+		benchmark::completion r;
+		easy.async_perform(std::bind(&benchmark::completion::handle, &r, std::placeholders::_1));
+		io_service.run();
+		io_service.reset();
+
+		if (r.result)
+		{
+			++failed;
+		}
+		else if (!buffer_sink)
+		{
+			bytes += static_cast<std::size_t>(easy.get_size_download());
+		}
+	}
+
+	double ms = benchmark::elapsed_ms(start);
+	double cpu = benchmark::cpu_ms() - start_cpu;
+	std::cout << (buffer_sink ? "buffer sink" : "ostream sink") << ": " << bytes << " bytes in " << ms << "ms, "
+		<< benchmark::megabytes_per_second(bytes, ms) << "MB/s, " << (bytes ? cpu * 1e9 / bytes : 0.0) << "ms CPU per GB"
+		<< ", failed " << failed << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect the url of a large object and optionally how often to download it
+	if (argc != 2 && argc != 3)
+	{
+		std::cerr << "usage: " << argv[0] << " url [rounds]" << std::endl;
+		return 1;
+	}
+
+	std::string url = argv[1];
+	int rounds = (argc == 3) ? std::atoi(argv[2]) : 3;
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	// the ostream sink copies every piece into the stream buffer, the buffer sink sees curl's buffer in place
+	run_downloads(io_service, manager, url, false, rounds);
+	run_downloads(io_service, manager, url, true, rounds);
+	run_downloads(io_service, manager, url, false, rounds);
+	run_downloads(io_service, manager, url, true, rounds);
+	return 0;
+}
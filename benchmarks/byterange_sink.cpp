@@ -0,0 +1,87 @@
+#include "benchmark.h"
+
+// hands out the ranges in turn to the requests of a request_loop
+struct range_requests
+{
+	range_requests(const std::string& url, const std::vector<std::uint64_t>& offsets, std::size_t range_size):
+		url(url),
+		offsets(offsets),
+		range_size(range_size),
+		next(0)
+	{
+	}
+
+	void prepare(curl::easy& easy)
+	{
+		std::uint64_t offset = offsets[next++];
+		easy.set_url(url);
+		easy.set_range(std::to_string(offset) + "-" + std::to_string(offset + range_size - 1));
+	}
+
+	std::string url;
+	std::vector<std::uint64_t> offsets;
+	std::size_t range_size;
+	std::size_t next;
+};
+
+int main(int argc, char* argv[])
+{
+	// expect the url of a large resource and optionally the number and size of the ranges
+	if (argc < 2 || argc > 4)
+	{
+		std::cerr << "usage: " << argv[0] << " url [ranges] [range-bytes]" << std::endl;
+		return 1;
+	}
+
+	std::string url = argv[1];
+	std::size_t count = (argc >= 3) ? std::strtoul(argv[2], 0, 10) : 64;
+	std::size_t range_size = (argc == 4) ? std::strtoul(argv[3], 0, 10) : 16384;
+
+	// ranges spread over the first 64MB of the resource, as a reader of an archive's index would pick them
+	std::vector<std::uint64_t> offsets;
+
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		offsets.push_back(i * (64 * 1024 * 1024 / count));
+	}
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	{
+		std::vector<char> data(count * range_size);
+		std::shared_ptr<curl::byterange_sink> sink = std::make_shared<curl::byterange_sink>();
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			sink->add_target(offsets[i], asio::buffer(&data[i * range_size], range_size));
+		}
+
+		curl::easy easy(manager);
+		easy.set_url(url);
+		easy.set_range(sink->get_range());
+		easy.set_byterange_sink(sink);
+
+		benchmark::completion r;
+		benchmark::clock_type::time_point start = benchmark::clock_type::now();
+		easy.async_perform(std::bind(&benchmark::completion::handle, &r, std::placeholders::_1));
+		io_service.run();
+		io_service.reset();
+		std::cout << "one request for " << count << " ranges: " << benchmark::elapsed_ms(start) << "ms, " << sink->get_parts() << " parts"
+			<< (sink->is_filled() ? "" : ", targets not filled") << (r.result ? ", failed: " + r.result.message() : std::string()) << std::endl;
+	}
+
+	// a request per range, one after the other and then several at once
+	const std::size_t concurrencies[] = { 1, 8 };
+
+	for (std::size_t i = 0; i < 2; ++i)
+	{
+		range_requests ranges(url, offsets, range_size);
+		benchmark::request_loop loop(manager, count, concurrencies[i], std::bind(&range_requests::prepare, &ranges, std::placeholders::_1));
+		benchmark::clock_type::time_point start = benchmark::clock_type::now();
+		loop.run();
+		std::cout << count << " requests, " << concurrencies[i] << " at a time: " << benchmark::elapsed_ms(start) << "ms, failed " << loop.failures << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include "benchmark.h"
+
+const char* algorithm_name(curl::checksum::algorithm algo)
+{
+	switch (algo)
+	{
+	case curl::checksum::crc32c:
+		return "crc32c";
+	case curl::checksum::sha256:
+		return "sha256";
+	default:
+		return "xxh64";
+	}
+}
+
+// feeds the data in pieces of the size libcurl hands to write callbacks
+void hash_memory(curl::checksum::algorithm algo, const std::string& data)
+{
+	curl::checksum sum(algo);
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+	for (std::size_t offset = 0; offset < data.size(); offset += CURL_MAX_WRITE_SIZE)
+	{
+		sum.update(data.data() + offset, std::min<std::size_t>(CURL_MAX_WRITE_SIZE, data.size() - offset));
+	}
+
+	double ms = benchmark::elapsed_ms(start);
+	std::cout << algorithm_name(algo) << (curl::checksum::is_accelerated(algo) ? " (accelerated)" : " (portable)") << ": "
+		<< benchmark::megabytes_per_second(data.size(), ms) << "MB/s, digest " << sum.hex_digest() << std::endl;
+}
+
+// downloads the url with the checksum computed along the way, or without one
+void hash_download(asio::io_service& io_service, curl::multi& manager, const std::string& url, const curl::checksum::algorithm* algo)
+{
+	curl::easy easy(manager);
+	easy.set_url(url);
+	easy.set_buffer_sink(benchmark::discard());
+
+	if (algo)
+	{
+		easy.add_checksum(std::make_shared<curl::checksum>(*algo));
+	}
+
+	benchmark::completion r;
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+	easy.async_perform(std::bind(&benchmark::completion::handle, &r, std::placeholders::_1));
+	io_service.run();
+	io_service.reset();
+	double ms = benchmark::elapsed_ms(start);
+
+	std::cout << "download with " << (algo ? algorithm_name(*algo) : "no checksum") << ": "
+		<< benchmark::megabytes_per_second(easy.get_size_download(), ms) << "MB/s" << (r.result ? ", failed: " + r.result.message() : std::string()) << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect optionally the url of a large object to download while computing checksums
+	if (argc > 2)
+	{
+		std::cerr << "usage: " << argv[0] << " [url]" << std::endl;
+		return 1;
+	}
+
+	const curl::checksum::algorithm algorithms[] = { curl::checksum::crc32c, curl::checksum::sha256, curl::checksum::xxh64 };
+	std::string data(256 * 1024 * 1024, '\0');
+
+	for (std::size_t i = 0; i < data.size(); ++i)
+	{
+		data[i] = static_cast<char>(i * 2654435761u >> 24);
+	}
+
+	// the portable code runs wherever the processor lacks the instructions, so compare both
+	for (int accelerated = 1; accelerated >= 0; --accelerated)
+	{
+		curl::checksum::set_acceleration(accelerated != 0);
+
+		for (std::size_t i = 0; i < 3; ++i)
+		{
+			hash_memory(algorithms[i], data);
+		}
+	}
+
+	curl::checksum::set_acceleration(true);
+
+	if (argc == 2)
+	{
+		asio::io_service io_service;
+		curl::multi manager(io_service);
+		hash_download(io_service, manager, argv[1], 0);
+
+		for (std::size_t i = 0; i < 3; ++i)
+		{
+			hash_download(io_service, manager, argv[1], &algorithms[i]);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include "benchmark.h"
+
+struct burst
+{
+	burst():
+		completed(0),
+		failed(0),
+		body_bytes(0)
+	{
+	}
+
+	void handle_fetch(curl::easy* easy, const asio::error_code& err, std::string body)
+	{
+		count(err, easy->get_reponse_code(), body.size());
+	}
+
+	void handle_get(const asio::error_code& err, long response_code, curl::coalescer::body_ptr body)
+	{
+		count(err, response_code, body ? body->size() : 0);
+	}
+
+	void count(const asio::error_code& err, long response_code, std::size_t size)
+	{
+		++completed;
+		body_bytes += size;
+
+		if (err || response_code >= 400)
+		{
+			++failed;
+		}
+	}
+
+	std::size_t completed;
+	std::size_t failed;
+	std::size_t body_bytes;
+};
+
+int main(int argc, char* argv[])
+{
+	// expect a url and optionally the number of concurrent requests for it
+	if (argc != 2 && argc != 3)
+	{
+		std::cerr << "usage: " << argv[0] << " url [requests]" << std::endl;
+		return 1;
+	}
+
+	// this benchmark starts a burst of identical GET requests, as many clients asking for the same hot object would
+	std::string url = argv[1];
+	std::size_t requests = (argc == 3) ? std::strtoul(argv[2], 0, 10) : 200;
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	{
+		// the handles stay here rather than in their handlers, which the easy keeps after completion
+		burst b;
+		std::vector<std::unique_ptr<curl::easy> > handles;
+		benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+		for (std::size_t i = 0; i < requests; ++i)
+		{
+			handles.push_back(std::unique_ptr<curl::easy>(new curl::easy(manager)));
+			curl::easy* easy = handles.back().get();
+			easy->set_url(url);
+			easy->async_fetch(std::bind(&burst::handle_fetch, &b, easy, std::placeholders::_1, std::placeholders::_2));
+		}
+
+		io_service.run();
+		io_service.reset();
+		std::cout << "separate: " << requests << " transfers in " << benchmark::elapsed_ms(start) << "ms, "
+			<< b.body_bytes << " body bytes held, failed " << b.failed << std::endl;
+	}
+
+	{
+		// all requests share the transfer and the body of the first one
+		burst b;
+		curl::coalescer coalescer(manager);
+		benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+		for (std::size_t i = 0; i < requests; ++i)
+		{
+			coalescer.async_get(url, std::bind(&burst::handle_get, &b, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+		}
+
+		io_service.run();
+		io_service.reset();
+		std::cout << "coalesced: " << coalescer.get_transfers_started() << " transfers in " << benchmark::elapsed_ms(start) << "ms, "
+			<< (b.body_bytes / requests) << " body bytes held, failed " << b.failed << std::endl;
+	}
+
+	return 0;
+}
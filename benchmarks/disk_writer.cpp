@@ -0,0 +1,140 @@
+#include "benchmark.h"
+#include <fstream>
+
+// fires every millisecond while the downloads run, recording how late the io_service got to it
+class lateness_probe
+{
+public:
+	explicit lateness_probe(asio::io_service& io_service):
+		timer_(io_service),
+		stopped_(false)
+	{
+	}
+
+	void start()
+	{
+		expected_ = benchmark::clock_type::now() + std::chrono::milliseconds(1);
+		timer_.expires_at(expected_);
+		timer_.async_wait(std::bind(&lateness_probe::handle_wait, this, std::placeholders::_1));
+	}
+
+	// A wait which already expired completes without an error, so the flag ends the probe as well
+	void stop()
+	{
+		stopped_ = true;
+		timer_.cancel();
+	}
+
+	std::vector<double> lateness;
+
+private:
+	void handle_wait(const asio::error_code& err)
+	{
+		if (err || stopped_)
+		{
+			return;
+		}
+
+		lateness.push_back(std::chrono::duration<double, std::milli>(benchmark::clock_type::now() - expected_).count());
+		start();
+	}
+
+	asio::steady_timer timer_;
+	benchmark::clock_type::time_point expected_;
+	bool stopped_;
+};
+
+struct downloads
+{
+	downloads(lateness_probe& probe, std::size_t left):
+		probe(probe),
+		left(left),
+		failures(0)
+	{
+	}
+
+	void handle_download(const asio::error_code& err)
+	{
+		if (err)
+		{
+			++failures;
+		}
+
+		if (--left == 0)
+		{
+			probe.stop();
+		}
+	}
+
+	lateness_probe& probe;
+	std::size_t left;
+	std::size_t failures;
+};
+
+void run_downloads(asio::io_service& io_service, curl::multi& manager, const std::string& url, const std::string& directory, std::size_t files, bool writer_threads)
+{
+	std::shared_ptr<curl::disk_writer> writer = std::make_shared<curl::disk_writer>(io_service);
+	lateness_probe probe(io_service);
+	downloads d(probe, files);
+
+	// the handles stay here rather than in their handlers, which the easy keeps after completion
+	std::vector<std::shared_ptr<curl::easy> > handles;
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+	for (std::size_t i = 0; i < files; ++i)
+	{
+		std::string path = directory + "/disk_writer_benchmark." + std::to_string(i);
+		std::shared_ptr<curl::easy> easy = std::make_shared<curl::easy>(manager);
+		easy->set_url(url);
+
+		// the ofstream is written on the thread running the io_service, the file sink on the writer's threads
+		if (writer_threads)
+		{
+			easy->set_file_sink(writer->open(path));
+		}
+		else
+		{
+			easy->set_sink(std::make_shared<std::ofstream>(path.c_str(), std::ios::binary));
+		}
+
+		easy->async_perform(std::bind(&downloads::handle_download, &d, std::placeholders::_1));
+		handles.push_back(easy);
+	}
+
+	probe.start();
+	io_service.run();
+	io_service.reset();
+	double ms = benchmark::elapsed_ms(start);
+
+	for (std::size_t i = 0; i < files; ++i)
+	{
+		std::remove((directory + "/disk_writer_benchmark." + std::to_string(i)).c_str());
+	}
+
+	std::cout << (writer_threads ? "disk_writer" : "ofstream") << ": " << files << " files in " << ms << "ms"
+		<< ", loop lateness median " << benchmark::percentile(probe.lateness, 0.5) << "ms p99 " << benchmark::percentile(probe.lateness, 0.99)
+		<< "ms max " << benchmark::percentile(probe.lateness, 1.0) << "ms, failed " << d.failures << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect a url, a directory on the disk to measure and optionally the number of files downloaded at once
+	if (argc != 3 && argc != 4)
+	{
+		std::cerr << "usage: " << argv[0] << " url directory [files]" << std::endl;
+		return 1;
+	}
+
+	std::string url = argv[1];
+	std::string directory = argv[2];
+	std::size_t files = (argc == 4) ? std::strtoul(argv[3], 0, 10) : 4;
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	run_downloads(io_service, manager, url, directory, files, false);
+	run_downloads(io_service, manager, url, directory, files, true);
+	run_downloads(io_service, manager, url, directory, files, false);
+	run_downloads(io_service, manager, url, directory, files, true);
+	return 0;
+}
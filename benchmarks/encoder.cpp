@@ -0,0 +1,71 @@
+#include "benchmark.h"
+
+// uploads the file with a PUT request, compressed with the coding unless it is null
+void run_upload(asio::io_service& io_service, curl::multi& manager, const std::string& url, const std::string& path, const curl::encoder::coding* coding, int level)
+{
+	curl::easy easy(manager);
+	easy.set_url(url);
+	easy.set_upload(true);
+	easy.add_header("Expect:");
+	easy.set_buffer_sink(benchmark::discard());
+
+	std::shared_ptr<curl::file_source> source = std::make_shared<curl::file_source>();
+	source->open(path);
+	easy.set_file_source(source);
+
+	std::string name = "identity";
+
+	if (coding)
+	{
+		easy.set_upload_encoding(*coding, level);
+		curl::encoder e(*coding, level);
+		name = std::string(e.name()) + " " + std::to_string(level);
+	}
+
+	benchmark::completion r;
+	double start_cpu = benchmark::cpu_ms();
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+	easy.async_perform(std::bind(&benchmark::completion::handle, &r, std::placeholders::_1));
+	io_service.run();
+	io_service.reset();
+	double ms = benchmark::elapsed_ms(start);
+	double body_mb = source->get_size() / 1e6;
+
+	// the encoder runs inside the read callback, so the bytes libcurl read are the bytes on the wire
+	std::cout << name << ": " << (easy.get_size_upload() / 1e6) << "MB of " << body_mb << "MB sent in " << ms << "ms, "
+		<< ((benchmark::cpu_ms() - start_cpu) / body_mb) << "ms CPU per MB, peak RSS " << benchmark::peak_rss_mb() << "MB"
+		<< ((r.result || easy.get_reponse_code() >= 400) ? ", failed" : "") << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect a url accepting uploads and a file to send
+	if (argc != 3)
+	{
+		std::cerr << "usage: " << argv[0] << " url file" << std::endl;
+		return 1;
+	}
+
+	const curl::encoder::coding codings[] = { curl::encoder::gzip, curl::encoder::zstd };
+	const int levels[][4] = { { 1, 6, 9, 0 }, { 1, 3, 9, 19 } };
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+	run_upload(io_service, manager, argv[1], argv[2], 0, -1);
+
+	// higher levels take more memory, so peak RSS grows along the way
+	for (std::size_t i = 0; i < 2; ++i)
+	{
+		if (!curl::encoder::is_supported(codings[i]))
+		{
+			continue;
+		}
+
+		for (std::size_t j = 0; j < 4 && levels[i][j] != 0; ++j)
+		{
+			run_upload(io_service, manager, argv[1], argv[2], &codings[i], levels[i][j]);
+		}
+	}
+
+	return 0;
+}
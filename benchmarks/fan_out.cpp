@@ -0,0 +1,80 @@
+#include "benchmark.h"
+
+// sends the same body to every url, and measures how long it takes until all of them, or only a quorum, have answered
+void run_rounds(asio::io_service& io_service, curl::multi& manager, const std::vector<std::string>& urls, std::shared_ptr<const std::string> body, bool shared_body, std::size_t quorum, int rounds)
+{
+	std::vector<double> setup;
+	std::vector<double> latency;
+	int failed = 0;
+
+	for (int i = 0; i < rounds; ++i)
+	{
+		curl::fan_out fan_out(manager);
+		benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+		for (std::size_t j = 0; j < urls.size(); ++j)
+		{
+			curl::easy& easy = fan_out.add(urls[j]);
+			easy.set_buffer_sink(benchmark::discard());
+
+			// without a shared body, every request gets a copy of its own
+			if (!shared_body)
+			{
+				easy.set_post_fields(*body);
+			}
+		}
+
+		if (shared_body)
+		{
+			fan_out.set_body(body);
+		}
+
+		fan_out.set_quorum(quorum);
+		setup.push_back(benchmark::elapsed_ms(start));
+
+		benchmark::completion r;
+		start = benchmark::clock_type::now();
+		fan_out.async_perform(std::bind(&benchmark::completion::handle, &r, std::placeholders::_1));
+		io_service.run();
+		io_service.reset();
+		latency.push_back(benchmark::elapsed_ms(start));
+
+		if (r.result)
+		{
+			++failed;
+		}
+	}
+
+	std::cout << (shared_body ? "shared body" : "copied body") << ", quorum " << quorum << "/" << urls.size()
+		<< ": setup median " << benchmark::percentile(setup, 0.5) << "ms"
+		<< ", completion median " << benchmark::percentile(latency, 0.5) << "ms p99 " << benchmark::percentile(latency, 0.99) << "ms"
+		<< ", failed rounds " << failed << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect a body size, a quorum and at least one url
+	if (argc < 4)
+	{
+		std::cerr << "usage: " << argv[0] << " body-bytes quorum url..." << std::endl;
+		return 1;
+	}
+
+	std::shared_ptr<const std::string> body = std::make_shared<const std::string>(std::strtoul(argv[1], 0, 10), 'x');
+	std::size_t quorum = std::strtoul(argv[2], 0, 10);
+	std::vector<std::string> urls(argv + 3, argv + argc);
+	const int rounds = 20;
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	// waiting for all responses, first with a copy of the body per request, then sharing one
+	run_rounds(io_service, manager, urls, body, false, urls.size(), rounds);
+	run_rounds(io_service, manager, urls, body, true, urls.size(), rounds);
+
+	// completing once the quorum has answered leaves the slowest requests behind
+	run_rounds(io_service, manager, urls, body, true, quorum, rounds);
+
+	std::cout << "peak RSS " << benchmark::peak_rss_mb() << "MB" << std::endl;
+	return 0;
+}
@@ -0,0 +1,131 @@
+#include "benchmark.h"
+#include <new>
+#include <sstream>
+
+// every allocation made through operator new is counted, those of the standard library's strings and streams included
+static std::size_t allocations = 0;
+static std::size_t allocated_bytes = 0;
+
+void* operator new(std::size_t size)
+{
+	++allocations;
+	allocated_bytes += size;
+
+	if (void* p = std::malloc(size ? size : 1))
+	{
+		return p;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) throw()
+{
+	std::free(p);
+}
+
+struct allocation_count
+{
+	std::size_t allocations;
+	std::size_t bytes;
+	std::size_t body_size;
+	asio::error_code result;
+};
+
+enum collect_mode { discard_body, stringstream_body, fetch_body };
+
+void handle_fetch(allocation_count* count, const asio::error_code& err, std::string body)
+{
+	count->result = err;
+	count->body_size = body.size();
+}
+
+allocation_count run_download(asio::io_service& io_service, curl::multi& manager, const std::string& url, collect_mode mode)
+{
+	allocation_count count = allocation_count();
+	std::size_t start_allocations = allocations;
+	std::size_t start_bytes = allocated_bytes;
+
+	{
+		curl::easy easy(manager);
+		easy.set_url(url);
+
+		if (mode == fetch_body)
+		{
+			easy.async_fetch(std::bind(handle_fetch, &count, std::placeholders::_1, std::placeholders::_2));
+			io_service.run();
+			io_service.reset();
+		}
+		else
+		{
+			// the way to collect a body without async_fetch: a stream, and a copy of its contents once the transfer is done
+			std::shared_ptr<std::stringstream> stream;
+			benchmark::completion c;
+
+			if (mode == stringstream_body)
+			{
+				stream = std::make_shared<std::stringstream>();
+				easy.set_sink(stream);
+			}
+			else
+			{
+				easy.set_buffer_sink(benchmark::discard());
+			}
+
+			easy.async_perform(std::bind(&benchmark::completion::handle, &c, std::placeholders::_1));
+			io_service.run();
+			io_service.reset();
+			handle_fetch(&count, c.result, stream ? stream->str() : std::string());
+		}
+	}
+
+	count.allocations = allocations - start_allocations;
+	count.bytes = allocated_bytes - start_bytes;
+	return count;
+}
+
+void print_count(const char* name, const allocation_count& count, const allocation_count& baseline)
+{
+	// the transfer's own bookkeeping is what the download allocates when the body is thrown away
+	std::size_t extra_allocations = (count.allocations > baseline.allocations) ? count.allocations - baseline.allocations : 0;
+	std::size_t extra_bytes = (count.bytes > baseline.bytes) ? count.bytes - baseline.bytes : 0;
+
+	// a buffer which grows copies what it holds into the next one, and taking a string out of a stream copies all of it, so whatever was allocated beyond one buffer for the body is about what was copied
+	std::size_t copied = (extra_bytes > count.body_size) ? extra_bytes - count.body_size : 0;
+
+	std::cout << "  " << name << ": " << extra_allocations << " allocations, " << extra_bytes << " bytes allocated, ~"
+		<< copied << " bytes copied (" << (count.body_size ? static_cast<double>(copied) / count.body_size : 0.0) << "x the body)";
+
+	if (count.result)
+	{
+		std::cout << ", failed: " << count.result.message();
+	}
+
+	std::cout << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect the urls of bodies of different sizes, such as 1KB, 64KB, 1MB and 100MB, with or without a Content-Length
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " url..." << std::endl;
+		return 1;
+	}
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	for (int i = 1; i < argc; ++i)
+	{
+		allocation_count baseline = run_download(io_service, manager, argv[i], discard_body);
+		allocation_count stream = run_download(io_service, manager, argv[i], stringstream_body);
+		allocation_count fetch = run_download(io_service, manager, argv[i], fetch_body);
+
+		std::cout << argv[i] << ": " << fetch.body_size << " bytes" << std::endl;
+		print_count("stringstream", stream, baseline);
+		print_count("async_fetch ", fetch, baseline);
+	}
+
+	return 0;
+}
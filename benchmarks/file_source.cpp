@@ -0,0 +1,95 @@
+#include "benchmark.h"
+#include <fstream>
+
+enum source_type { source_ifstream, source_pread, source_mapped };
+
+const char* source_name(source_type type)
+{
+	switch (type)
+	{
+	case source_ifstream:
+		return "ifstream";
+	case source_pread:
+		return "file_source (pread)";
+	default:
+		return "file_source (mapped)";
+	}
+}
+
+// uploads the file with a PUT request once per round
+void run_uploads(asio::io_service& io_service, curl::multi& manager, const std::string& url, const std::string& path, source_type type, int rounds)
+{
+	double bytes = 0.0;
+	int failed = 0;
+	double start_cpu = benchmark::cpu_ms();
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+	for (int i = 0; i < rounds; ++i)
+	{
+		curl::easy easy(manager);
+		easy.set_url(url);
+		easy.set_upload(true);
+		easy.set_buffer_sink(benchmark::discard());
+
+		if (type == source_ifstream)
+		{
+			std::shared_ptr<std::ifstream> stream = std::make_shared<std::ifstream>(path.c_str(), std::ios::binary);
+			stream->seekg(0, std::ios::end);
+			easy.set_in_file_size_large(stream->tellg());
+			stream->seekg(0);
+			easy.set_source(stream);
+		}
+		else
+		{
+			std::shared_ptr<curl::file_source> source = std::make_shared<curl::file_source>();
+			source->open(path, (type == source_mapped) ? curl::file_source::read_mapped : curl::file_source::read_pread);
+			easy.set_file_source(source);
+		}
+
+		benchmark::completion r;
+		easy.async_perform(std::bind(&benchmark::completion::handle, &r, std::placeholders::_1));
+		io_service.run();
+		io_service.reset();
+
+		if (r.result || easy.get_reponse_code() >= 400)
+		{
+			++failed;
+		}
+		else
+		{
+			bytes += easy.get_size_upload();
+		}
+	}
+
+	double ms = benchmark::elapsed_ms(start);
+	double cpu = benchmark::cpu_ms() - start_cpu;
+	std::cout << source_name(type) << ": " << static_cast<std::uint64_t>(bytes) << " bytes in " << ms << "ms, " << benchmark::megabytes_per_second(bytes, ms) << "MB/s, "
+		<< (bytes > 0.0 ? cpu * 1e9 / bytes : 0.0) << "ms CPU per GB, failed " << failed << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect a url accepting uploads, a large file and optionally how often to upload it
+	if (argc != 3 && argc != 4)
+	{
+		std::cerr << "usage: " << argv[0] << " url file [rounds]" << std::endl;
+		return 1;
+	}
+
+	std::string url = argv[1];
+	std::string path = argv[2];
+	int rounds = (argc == 4) ? std::atoi(argv[3]) : 3;
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	// a first pass brings the file into the page cache, so that all sources read it from memory
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		run_uploads(io_service, manager, url, path, source_ifstream, rounds);
+		run_uploads(io_service, manager, url, path, source_pread, rounds);
+		run_uploads(io_service, manager, url, path, source_mapped, rounds);
+	}
+
+	return 0;
+}
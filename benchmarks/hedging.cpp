@@ -0,0 +1,49 @@
+#include "benchmark.h"
+
+void prepare_request(const std::string& url, std::shared_ptr<curl::hedging_policy> policy, curl::easy& easy)
+{
+	easy.set_url(url);
+
+	if (policy)
+	{
+		easy.set_hedging_policy(policy);
+	}
+}
+
+void run_requests(curl::multi& manager, const std::string& url, std::shared_ptr<curl::hedging_policy> policy, std::size_t requests, std::size_t concurrency)
+{
+	benchmark::request_loop loop(manager, requests, concurrency, std::bind(prepare_request, url, policy, std::placeholders::_1));
+	loop.run();
+
+	std::cout << (policy ? "hedged" : "plain ") << ": p50 " << benchmark::percentile(loop.latencies, 0.5) << "ms"
+		<< ", p99 " << benchmark::percentile(loop.latencies, 0.99) << "ms"
+		<< ", p99.9 " << benchmark::percentile(loop.latencies, 0.999) << "ms"
+		<< ", hedges " << (policy ? policy->get_hedges_sent() : 0)
+		<< ", failures " << loop.failures << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect a url and optionally the number of requests and their concurrency
+	if (argc < 2 || argc > 4)
+	{
+		std::cerr << "usage: " << argv[0] << " url [requests] [concurrency]" << std::endl;
+		return 1;
+	}
+
+	// this benchmark measures the latency percentiles of a url which occasionally stalls, with and without hedging
+	std::string url = argv[1];
+	std::size_t requests = (argc > 2) ? std::strtoul(argv[2], 0, 10) : 2000;
+	std::size_t concurrency = (argc > 3) ? std::strtoul(argv[3], 0, 10) : 8;
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	run_requests(manager, url, std::shared_ptr<curl::hedging_policy>(), requests, concurrency);
+
+	// the default budget of 5% leaves headroom for stalls affecting up to a few percent of all requests
+	std::shared_ptr<curl::hedging_policy> policy = std::make_shared<curl::hedging_policy>();
+	run_requests(manager, url, policy, requests, concurrency);
+
+	return 0;
+}
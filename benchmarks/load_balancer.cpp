@@ -0,0 +1,110 @@
+#include "benchmark.h"
+#include <random>
+#include <sstream>
+
+// pins each request to an endpoint drawn uniformly at random, which is what spreading requests over the addresses of a name amounts to without a balancer
+void prepare_random(const std::string& url, const std::vector<std::string>& addresses, std::mt19937* random, std::vector<std::size_t>* requests, curl::easy& easy)
+{
+	curl::origin target(url);
+	std::size_t index = (*random)() % addresses.size();
+	std::string port = std::to_string(static_cast<unsigned int>(target.port));
+
+	easy.set_url(url);
+	easy.add_connect_to(target.host_entry() + ":" + port + ":" + addresses[index] + ":" + port);
+	++(*requests)[index];
+}
+
+void prepare_balanced(const std::string& url, curl::easy& easy)
+{
+	easy.set_url(url);
+}
+
+void print_results(const char* name, const benchmark::request_loop& loop, double total_ms, const std::vector<std::string>& addresses, const std::vector<std::size_t>& requests)
+{
+	std::cout << name << ": " << total_ms << "ms"
+		<< ", p50 " << benchmark::percentile(loop.latencies, 0.5) << "ms"
+		<< ", p99 " << benchmark::percentile(loop.latencies, 0.99) << "ms"
+		<< ", p99.9 " << benchmark::percentile(loop.latencies, 0.999) << "ms"
+		<< ", failures " << loop.failures << std::endl;
+
+	for (std::size_t i = 0; i < addresses.size(); ++i)
+	{
+		std::cout << "  " << addresses[i] << ": " << requests[i] << " requests" << std::endl;
+	}
+}
+
+void run_random(curl::multi& manager, const std::string& url, const std::vector<std::string>& addresses, std::size_t requests, std::size_t concurrency)
+{
+	std::mt19937 random(1);
+	std::vector<std::size_t> counts(addresses.size());
+	benchmark::request_loop loop(manager, requests, concurrency, std::bind(prepare_random, url, std::cref(addresses), &random, &counts, std::placeholders::_1));
+
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+	loop.run();
+	print_results("random  ", loop, benchmark::elapsed_ms(start), addresses, counts);
+}
+
+void run_balanced(curl::multi& manager, const std::string& url, const std::vector<std::string>& addresses, std::size_t requests, std::size_t concurrency)
+{
+	std::shared_ptr<curl::load_balancer> balancer = std::make_shared<curl::load_balancer>();
+	balancer->set_endpoints(url, addresses);
+	manager.set_load_balancer(balancer);
+
+	benchmark::request_loop loop(manager, requests, concurrency, std::bind(prepare_balanced, url, std::placeholders::_1));
+
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+	loop.run();
+	manager.set_load_balancer(std::shared_ptr<curl::load_balancer>());
+
+	// the stats come in the order the endpoints were set
+	std::vector<curl::load_balancer::endpoint_stats> stats = balancer->get_stats(url);
+	std::vector<std::size_t> counts;
+
+	for (std::size_t i = 0; i < stats.size(); ++i)
+	{
+		counts.push_back(stats[i].requests);
+	}
+
+	print_results("balanced", loop, benchmark::elapsed_ms(start), addresses, counts);
+}
+
+int main(int argc, char* argv[])
+{
+	// expect a url, a comma-separated list of addresses serving it, and optionally the number of requests and their concurrency
+	if (argc < 3 || argc > 5)
+	{
+		std::cerr << "usage: " << argv[0] << " url address[,address...] [requests] [concurrency]" << std::endl;
+		return 1;
+	}
+
+	// this benchmark measures how requests spread over the endpoints of an origin, and the latency percentiles that result, when one of them is slower than the others
+	std::string url = argv[1];
+	std::size_t requests = (argc > 3) ? std::strtoul(argv[3], 0, 10) : 2000;
+	std::size_t concurrency = (argc > 4) ? std::strtoul(argv[4], 0, 10) : 8;
+
+	std::vector<std::string> addresses;
+	std::istringstream list(argv[2]);
+	std::string address;
+
+	while (std::getline(list, address, ','))
+	{
+		if (!address.empty())
+		{
+			addresses.push_back(address);
+		}
+	}
+
+	if (addresses.empty())
+	{
+		std::cerr << "no addresses given" << std::endl;
+		return 1;
+	}
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	run_random(manager, url, addresses, requests, concurrency);
+	run_balanced(manager, url, addresses, requests, concurrency);
+
+	return 0;
+}
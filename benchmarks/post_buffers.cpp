@@ -0,0 +1,96 @@
+#include "benchmark.h"
+
+// request body assembled from parts, as a serializer writing into several buffers would produce it
+struct body_parts
+{
+	body_parts(std::size_t count, std::size_t size)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			parts.push_back(std::string(size, static_cast<char>('a' + i % 26)));
+		}
+	}
+
+	std::string join() const
+	{
+		std::string body;
+
+		for (std::size_t i = 0; i < parts.size(); ++i)
+		{
+			body += parts[i];
+		}
+
+		return body;
+	}
+
+	std::vector<asio::const_buffer> buffers() const
+	{
+		std::vector<asio::const_buffer> result;
+
+		for (std::size_t i = 0; i < parts.size(); ++i)
+		{
+			result.push_back(asio::buffer(parts[i]));
+		}
+
+		return result;
+	}
+
+	std::vector<std::string> parts;
+};
+
+int main(int argc, char* argv[])
+{
+	// expect a url accepting POST requests, a mode and optionally the number and size of the parts
+	std::string mode = (argc >= 3) ? argv[2] : "";
+
+	if (argc < 3 || argc > 5 || (mode != "copy" && mode != "move" && mode != "buffers"))
+	{
+		std::cerr << "usage: " << argv[0] << " url copy|move|buffers [parts] [part-megabytes]" << std::endl;
+		return 1;
+	}
+
+	// peak RSS only ever grows, so every run measures a single mode
+	std::size_t count = (argc >= 4) ? std::strtoul(argv[3], 0, 10) : 8;
+	std::size_t size = ((argc == 5) ? std::strtoul(argv[4], 0, 10) : 128) * 1024 * 1024;
+	body_parts body(count, size);
+	double parts_mb = benchmark::peak_rss_mb();
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+	curl::easy easy(manager);
+	easy.set_url(argv[1]);
+	easy.add_header("Expect:");
+	easy.set_buffer_sink(benchmark::discard());
+
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+	// copying and moving both join the parts first; the buffers are sent as they are
+	if (mode == "copy")
+	{
+		std::string joined = body.join();
+		easy.set_post_fields(joined);
+	}
+	else if (mode == "move")
+	{
+		easy.set_post_fields(body.join());
+	}
+	else
+	{
+		easy.set_post_buffers(body.buffers());
+	}
+
+	benchmark::completion r;
+	easy.async_perform(std::bind(&benchmark::completion::handle, &r, std::placeholders::_1));
+	io_service.run();
+	double ms = benchmark::elapsed_ms(start);
+
+	if (r.result || easy.get_reponse_code() >= 400)
+	{
+		std::cerr << "Upload failed: " << (r.result ? r.result.message() : std::to_string(easy.get_reponse_code())) << std::endl;
+		return 1;
+	}
+
+	std::cout << mode << ": " << static_cast<std::uint64_t>(easy.get_size_upload()) << " bytes in " << ms << "ms"
+		<< ", peak RSS " << benchmark::peak_rss_mb() << "MB of which " << parts_mb << "MB before the request" << std::endl;
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include "benchmark.h"
+
+// stream of NDJSON records or server-sent events of about the given size each
+std::string make_stream(curl::record_sink::format fmt, std::size_t record_size, std::size_t total)
+{
+	std::string stream;
+	std::string payload = "{\"v\":\"" + std::string(record_size > 10 ? record_size - 10 : 1, 'x') + "\"}";
+
+	while (stream.size() < total)
+	{
+		stream += (fmt == curl::record_sink::sse) ? "data: " + payload + "\n\n" : payload + "\n";
+	}
+
+	return stream;
+}
+
+struct record_counter
+{
+	record_counter():
+		records(0),
+		bytes(0)
+	{
+	}
+
+	bool handle(const curl::record_sink::record& r)
+	{
+		++records;
+		bytes += asio::buffer_size(r.data);
+		return true;
+	}
+
+	std::uint64_t records;
+	std::uint64_t bytes;
+};
+
+// splits lines the way a std::getline loop over the received data does, copying every record out of the buffer
+std::uint64_t split_lines(const std::string& stream, std::uint64_t& bytes)
+{
+	std::string buffer;
+	std::uint64_t records = 0;
+
+	for (std::size_t offset = 0; offset < stream.size(); offset += CURL_MAX_WRITE_SIZE)
+	{
+		buffer.append(stream, offset, CURL_MAX_WRITE_SIZE);
+		std::size_t begin = 0;
+		std::size_t end;
+
+		while ((end = buffer.find('\n', begin)) != std::string::npos)
+		{
+			std::string line = buffer.substr(begin, end - begin);
+			bytes += line.size();
+			++records;
+			begin = end + 1;
+		}
+
+		buffer.erase(0, begin);
+	}
+
+	return records;
+}
+
+void run_format(curl::record_sink::format fmt, std::size_t record_size)
+{
+	std::string stream = make_stream(fmt, record_size, 256 * 1024 * 1024);
+	const char* name = (fmt == curl::record_sink::sse) ? "sse" : "ndjson";
+
+	record_counter counter;
+	curl::record_sink sink(fmt, std::bind(&record_counter::handle, &counter, std::placeholders::_1));
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+	// pieces of the size libcurl hands to write callbacks
+	for (std::size_t offset = 0; offset < stream.size(); offset += CURL_MAX_WRITE_SIZE)
+	{
+		sink.write(stream.data() + offset, std::min<std::size_t>(CURL_MAX_WRITE_SIZE, stream.size() - offset));
+	}
+
+	sink.finish();
+	double ms = benchmark::elapsed_ms(start);
+	std::cout << name << " " << record_size << "B: record_sink " << (counter.records / ms / 1e3) << "M records/s, "
+		<< benchmark::megabytes_per_second(stream.size(), ms) << "MB/s, " << (100.0 * sink.get_copied_records() / counter.records) << "% copied";
+
+	if (fmt == curl::record_sink::ndjson)
+	{
+		std::uint64_t bytes = 0;
+		start = benchmark::clock_type::now();
+		std::uint64_t records = split_lines(stream, bytes);
+		ms = benchmark::elapsed_ms(start);
+		std::cout << "; line splitting " << (records / ms / 1e3) << "M records/s";
+	}
+
+	std::cout << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect optionally the url of an NDJSON stream to split while it is received
+	if (argc > 2)
+	{
+		std::cerr << "usage: " << argv[0] << " [ndjson-url]" << std::endl;
+		return 1;
+	}
+
+	const std::size_t record_sizes[] = { 16, 64, 256 };
+
+	for (std::size_t i = 0; i < 3; ++i)
+	{
+		run_format(curl::record_sink::ndjson, record_sizes[i]);
+	}
+
+	for (std::size_t i = 0; i < 3; ++i)
+	{
+		run_format(curl::record_sink::sse, record_sizes[i]);
+	}
+
+	if (argc == 2)
+	{
+		asio::io_service io_service;
+		curl::multi manager(io_service);
+		curl::easy easy(manager);
+		easy.set_url(argv[1]);
+
+		record_counter counter;
+		easy.set_record_sink(std::make_shared<curl::record_sink>(curl::record_sink::ndjson, std::bind(&record_counter::handle, &counter, std::placeholders::_1)));
+
+		benchmark::completion r;
+		benchmark::clock_type::time_point start = benchmark::clock_type::now();
+		easy.async_perform(std::bind(&benchmark::completion::handle, &r, std::placeholders::_1));
+		io_service.run();
+		double ms = benchmark::elapsed_ms(start);
+		std::cout << "over HTTP: " << counter.records << " records in " << ms << "ms, " << (counter.records / ms / 1e3) << "M records/s"
+			<< (r.result ? ", failed: " + r.result.message() : std::string()) << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,139 @@
+#include "benchmark.h"
+
+using asio::ip::tcp;
+
+// one client of the gateway: the gateway forwards the upstream response to the server side of a connected socket pair, and the client side reads it
+class connection
+{
+public:
+	connection(curl::multi& manager, tcp::acceptor& acceptor, std::size_t& bytes_received):
+		client_(manager.get_io_service()),
+		server_(manager.get_io_service()),
+		easy_(manager),
+		relay_(easy_),
+		buffer_(65536),
+		bytes_received_(bytes_received)
+	{
+		client_.connect(acceptor.local_endpoint());
+		acceptor.accept(server_);
+	}
+
+	void start(const std::string& url, bool relayed)
+	{
+		easy_.set_url(url);
+		read();
+
+		// buffering fetches the whole response before writing it to the client, relaying writes it as it arrives
+		if (relayed)
+		{
+			relay_.async_download(server_, std::bind(&connection::handle_relay, this, std::placeholders::_1));
+		}
+		else
+		{
+			easy_.async_fetch(std::bind(&connection::handle_fetch, this, std::placeholders::_1, std::placeholders::_2));
+		}
+	}
+
+	asio::error_code result;
+
+private:
+	void handle_relay(const asio::error_code& err)
+	{
+		result = err;
+		server_.shutdown(tcp::socket::shutdown_send);
+	}
+
+	void handle_fetch(const asio::error_code& err, std::string body)
+	{
+		if (err)
+		{
+			result = err;
+			server_.shutdown(tcp::socket::shutdown_send);
+			return;
+		}
+
+		body_ = std::move(body);
+		asio::async_write(server_, asio::buffer(body_), std::bind(&connection::handle_write, this, std::placeholders::_1));
+	}
+
+	void handle_write(const asio::error_code& err)
+	{
+		result = err;
+		std::string().swap(body_);
+		server_.shutdown(tcp::socket::shutdown_send);
+	}
+
+	void read()
+	{
+		client_.async_read_some(asio::buffer(buffer_), std::bind(&connection::handle_read, this, std::placeholders::_1, std::placeholders::_2));
+	}
+
+	void handle_read(const asio::error_code& err, std::size_t size)
+	{
+		bytes_received_ += size;
+
+		if (!err)
+		{
+			read();
+		}
+	}
+
+	tcp::socket client_;
+	tcp::socket server_;
+	curl::easy easy_;
+	curl::relay relay_;
+	std::string body_;
+	std::vector<char> buffer_;
+	std::size_t& bytes_received_;
+};
+
+int main(int argc, char* argv[])
+{
+	// expect an upstream url, a mode and optionally the number of clients served at once
+	std::string mode = (argc >= 3) ? argv[2] : "";
+
+	if (argc < 3 || argc > 4 || (mode != "relay" && mode != "buffered"))
+	{
+		std::cerr << "usage: " << argv[0] << " url relay|buffered [clients]" << std::endl;
+		return 1;
+	}
+
+	// peak RSS only ever grows, so every run measures a single mode
+	std::size_t clients = (argc == 4) ? std::strtoul(argv[3], 0, 10) : 64;
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+	tcp::acceptor acceptor(io_service, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+	std::size_t bytes_received = 0;
+	std::vector<std::unique_ptr<connection> > connections;
+
+	for (std::size_t i = 0; i < clients; ++i)
+	{
+		connections.push_back(std::unique_ptr<connection>(new connection(manager, acceptor, bytes_received)));
+	}
+
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+	for (std::size_t i = 0; i < clients; ++i)
+	{
+		connections[i]->start(argv[1], mode == "relay");
+	}
+
+	io_service.run();
+	double ms = benchmark::elapsed_ms(start);
+
+	std::size_t failed = 0;
+
+	for (std::size_t i = 0; i < clients; ++i)
+	{
+		if (connections[i]->result)
+		{
+			++failed;
+		}
+	}
+
+	std::cout << mode << ": " << clients << " clients received " << bytes_received << " bytes in " << ms << "ms, "
+		<< benchmark::megabytes_per_second(bytes_received, ms) << "MB/s, peak RSS " << benchmark::peak_rss_mb() << "MB, failed " << failed << std::endl;
+	return 0;
+}
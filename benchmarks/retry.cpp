@@ -0,0 +1,65 @@
+#include "benchmark.h"
+
+void prepare_request(const std::string& url, std::shared_ptr<curl::retry_policy> policy, curl::easy& easy)
+{
+	easy.set_url(url);
+
+	if (policy)
+	{
+		easy.set_retry_policy(policy);
+	}
+}
+
+void run_requests(curl::multi& manager, const char* label, const std::string& url, std::shared_ptr<curl::retry_policy> policy, std::size_t requests)
+{
+	benchmark::request_loop loop(manager, requests, 8, std::bind(prepare_request, url, policy, std::placeholders::_1));
+	loop.run();
+
+	std::size_t retries = policy ? policy->get_retries_sent() : 0;
+	std::cout << label << ": failed " << (100.0 * loop.failures / requests) << "%"
+		<< ", retries " << retries << " (" << (100.0 * retries / requests) << "% extra load)"
+		<< ", p50 " << benchmark::percentile(loop.latencies, 0.5) << "ms"
+		<< ", p99 " << benchmark::percentile(loop.latencies, 0.99) << "ms" << std::endl;
+}
+
+std::shared_ptr<curl::retry_policy> make_policy(bool budget)
+{
+	std::shared_ptr<curl::retry_policy> policy = std::make_shared<curl::retry_policy>();
+	policy->set_backoff(std::chrono::milliseconds(5), std::chrono::milliseconds(50));
+
+	// a bucket which never runs dry shows what retrying costs without a budget
+	if (!budget)
+	{
+		policy->set_retry_budget(1.0, 1e9);
+	}
+
+	return policy;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect a url failing some requests with a retryable status, and optionally one failing all of them
+	if (argc < 2 || argc > 4)
+	{
+		std::cerr << "usage: " << argv[0] << " flaky-url [down-url] [requests]" << std::endl;
+		return 1;
+	}
+
+	std::size_t requests = (argc > 3) ? std::strtoul(argv[3], 0, 10) : 1000;
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	// transient failures are hidden by retries
+	run_requests(manager, "flaky, no retries", argv[1], std::shared_ptr<curl::retry_policy>(), requests);
+	run_requests(manager, "flaky, retries", argv[1], make_policy(true), requests);
+
+	// during an outage, the budget keeps retries from multiplying the load on the origin
+	if (argc > 2)
+	{
+		run_requests(manager, "down, retries without budget", argv[2], make_policy(false), requests);
+		run_requests(manager, "down, retries with budget", argv[2], make_policy(true), requests);
+	}
+
+	return 0;
+}
@@ -0,0 +1,40 @@
+#include "benchmark.h"
+#include <cstdio>
+
+int main(int argc, char* argv[])
+{
+	// expect the url of a large object, a file to download it to and optionally the most connections to try
+	if (argc != 3 && argc != 4)
+	{
+		std::cerr << "usage: " << argv[0] << " url file [max-connections]" << std::endl;
+		return 1;
+	}
+
+	// per-connection limits, such as a server's bandwidth cap per client or TCP windows on long paths, are what more connections overcome
+	std::string file_name = argv[2];
+	std::size_t max_connections = (argc == 4) ? std::strtoul(argv[3], 0, 10) : 8;
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+
+	for (std::size_t connections = 1; connections <= max_connections; connections *= 2)
+	{
+		curl::segmented_download download(manager);
+		download.add_url(argv[1]);
+		download.set_connections(connections);
+
+		benchmark::completion r;
+		benchmark::clock_type::time_point start = benchmark::clock_type::now();
+		download.async_download(file_name, std::bind(&benchmark::completion::handle, &r, std::placeholders::_1));
+		io_service.run();
+		io_service.reset();
+		double ms = benchmark::elapsed_ms(start);
+		std::remove(file_name.c_str());
+
+		std::cout << connections << " connections: " << download.get_bytes_received() << " bytes in " << ms << "ms, "
+			<< benchmark::megabytes_per_second(download.get_bytes_received(), ms) << "MB/s, " << download.get_splits() << " segments split"
+			<< (r.result ? ", failed: " + r.result.message() : std::string()) << std::endl;
+	}
+
+	return 0;
+}
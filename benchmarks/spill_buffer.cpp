@@ -0,0 +1,68 @@
+#include "benchmark.h"
+
+// measures memory while the body is still held, which is when the two modes differ
+void handle_fetch(std::size_t& size, double& anonymous_mb, asio::error_code& result, const asio::error_code& err, std::string body)
+{
+	size = body.size();
+	anonymous_mb = benchmark::anonymous_rss_mb();
+	result = err;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect the url of a large object and a mode
+	if (argc != 3 || (std::string(argv[2]) != "fetch" && std::string(argv[2]) != "spill"))
+	{
+		std::cerr << "usage: " << argv[0] << " url fetch|spill" << std::endl;
+		return 1;
+	}
+
+	// peak RSS only ever grows, so every run measures a single mode; the spilled body counts towards it as mapped file pages, but not towards anonymous memory
+	bool spill = std::string(argv[2]) == "spill";
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+	curl::easy easy(manager);
+	easy.set_url(argv[1]);
+
+	std::size_t size = 0;
+	double anonymous_mb = 0.0;
+	asio::error_code result;
+	std::shared_ptr<curl::spill_buffer> buffer = std::make_shared<curl::spill_buffer>();
+	benchmark::clock_type::time_point start = benchmark::clock_type::now();
+
+	if (spill)
+	{
+		benchmark::completion r;
+		easy.set_spill_sink(buffer);
+		easy.async_perform(std::bind(&benchmark::completion::handle, &r, std::placeholders::_1));
+		io_service.run();
+		size = buffer->size();
+		anonymous_mb = benchmark::anonymous_rss_mb();
+		result = r.result;
+	}
+	else
+	{
+		easy.async_fetch(std::bind(handle_fetch, std::ref(size), std::ref(anonymous_mb), std::ref(result), std::placeholders::_1, std::placeholders::_2));
+		io_service.run();
+	}
+
+	double ms = benchmark::elapsed_ms(start);
+
+	if (result)
+	{
+		std::cerr << "Transfer failed: " << result.message() << std::endl;
+		return 1;
+	}
+
+	std::cout << (spill ? "spill sink" : "async_fetch") << ": " << size << " bytes in " << ms << "ms, "
+		<< benchmark::megabytes_per_second(size, ms) << "MB/s, anonymous RSS " << anonymous_mb << "MB, peak RSS including mapped files " << benchmark::peak_rss_mb() << "MB";
+
+	if (spill)
+	{
+		std::cout << (buffer->is_spilled() ? ", spilled to disk" : ", kept in memory");
+	}
+
+	std::cout << std::endl;
+	return 0;
+}
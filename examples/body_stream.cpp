@@ -0,0 +1,91 @@
+#include <curl-asio.h>
+#include <iostream>
+
+// reads the response through curl::body_stream, waiting a while after every read like a consumer which cannot keep up
+struct slow_reader
+{
+	slow_reader(curl::body_stream& stream, std::chrono::milliseconds delay):
+		stream(stream),
+		timer(stream.get_io_service()),
+		delay(delay),
+		buffer(4096),
+		bytes_read(0)
+	{
+	}
+
+	void read()
+	{
+		stream.async_read_some(asio::buffer(buffer), std::bind(&slow_reader::handle_read, this, std::placeholders::_1, std::placeholders::_2));
+	}
+
+	void handle_read(const asio::error_code& err, std::size_t size)
+	{
+		bytes_read += size;
+
+		if (err)
+		{
+			result = err;
+			return;
+		}
+
+		timer.expires_from_now(delay);
+		timer.async_wait(std::bind(&slow_reader::read, this));
+	}
+
+	curl::body_stream& stream;
+	asio::steady_timer timer;
+	std::chrono::milliseconds delay;
+	std::vector<char> buffer;
+	std::size_t bytes_read;
+	asio::error_code result;
+};
+
+void handle_transfer(const asio::error_code& err)
+{
+	if (err)
+	{
+		std::cerr << "Transfer failed: " << err.message() << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	// expect one or two arguments
+	if (argc != 2 && argc != 3)
+	{
+		std::cerr << "usage: " << argv[0] << " url [delay-ms]" << std::endl;
+		return 1;
+	}
+
+	// this example program reads the body of argv[1] in 4KB pieces, pausing for argv[2] milliseconds (default: 1) after each of them
+	std::chrono::milliseconds delay(argc == 3 ? std::atoi(argv[2]) : 1);
+
+	asio::io_service io_service;
+	curl::multi manager(io_service);
+	curl::easy easy(manager);
+	easy.set_url(argv[1]);
+
+	// the transfer is paused whenever no read is pending, so the body stream holds at most what a single write callback delivered
+	slow_reader reader(easy.body_stream(), delay);
+	easy.async_perform(handle_transfer);
+	reader.read();
+
+	io_service.run();
+
+	std::size_t peak = reader.stream.get_peak_buffered_bytes();
+	std::cout << "Read " << reader.bytes_read << " bytes, at most " << peak << " bytes were buffered (limit: " << CURL_MAX_WRITE_SIZE << ")" << std::endl;
+
+	if (reader.result != asio::error::eof)
+	{
+		std::cerr << "Reading failed: " << reader.result.message() << std::endl;
+		return 1;
+	}
+
+	if (peak > CURL_MAX_WRITE_SIZE)
+	{
+		std::cerr << "The body stream buffered more than a single write callback" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,131 @@
+#include <curl-asio.h>
+#include <iostream>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// progress a download process shares with its parent, which survives the process being killed
+struct progress
+{
+	std::uint64_t size;
+	std::uint64_t received;
+	std::uint64_t resumed;
+	bool finished;
+};
+
+void publish(asio::steady_timer& timer, curl::segmented_download& download, progress* shared, const asio::error_code& err)
+{
+	if (err)
+	{
+		return;
+	}
+
+	shared->size = download.get_size();
+	shared->received = download.get_bytes_received();
+	shared->resumed = download.get_bytes_resumed();
+	timer.expires_from_now(std::chrono::milliseconds(1));
+	timer.async_wait(std::bind(publish, std::ref(timer), std::ref(download), shared, std::placeholders::_1));
+}
+
+void handle_download(asio::steady_timer& timer, asio::error_code& result, const asio::error_code& err)
+{
+	result = err;
+	timer.cancel();
+}
+
+// downloads the url in a process of its own, resuming from the journal, and returns false if the process did not finish
+bool run_download(const std::string& url, const std::string& file_name, int kill_after_ms, progress* shared)
+{
+	shared->size = 0;
+	shared->received = 0;
+	shared->resumed = 0;
+	shared->finished = false;
+
+	pid_t pid = fork();
+
+	if (pid == 0)
+	{
+		asio::io_service io_service;
+		curl::multi manager(io_service);
+		curl::segmented_download download(manager);
+		download.add_url(url);
+
+		std::shared_ptr<curl::download_journal> journal = std::make_shared<curl::download_journal>(file_name + ".journal");
+		journal->set_interval(std::chrono::milliseconds(100));
+		download.set_journal(journal);
+
+		asio::steady_timer timer(io_service);
+		asio::error_code result;
+		publish(timer, download, shared, asio::error_code());
+		download.async_download(file_name, std::bind(handle_download, std::ref(timer), std::ref(result), std::placeholders::_1));
+		io_service.run();
+
+		publish(timer, download, shared, asio::error_code());
+		shared->finished = !result;
+		_exit(result ? 1 : 0);
+	}
+
+	if (kill_after_ms > 0)
+	{
+		usleep(kill_after_ms * 1000);
+		kill(pid, SIGKILL);
+	}
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	return shared->finished;
+}
+
+int main(int argc, char* argv[])
+{
+	// expect two or three arguments
+	if (argc != 3 && argc != 4)
+	{
+		std::cerr << "usage: " << argv[0] << " url file [kill-after-ms]" << std::endl;
+		return 1;
+	}
+
+	// this example program downloads argv[1] to argv[2], kills the download after argv[3] milliseconds (default: 1000) as a crash would, and resumes it from the journal
+	std::string url = argv[1];
+	std::string file_name = argv[2];
+	int kill_after_ms = (argc == 4) ? std::atoi(argv[3]) : 1000;
+
+	void* memory = mmap(0, sizeof(progress), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (memory == MAP_FAILED)
+	{
+		std::cerr << "Cannot share memory with the download process" << std::endl;
+		return 1;
+	}
+
+	progress* shared = static_cast<progress*>(memory);
+
+	if (run_download(url, file_name, kill_after_ms, shared))
+	{
+		std::cerr << "The download finished before it was killed; pick a larger object or kill it sooner" << std::endl;
+		return 1;
+	}
+
+	std::uint64_t killed_received = shared->received;
+	std::cout << "Killed after receiving " << killed_received << " bytes" << std::endl;
+
+	if (!run_download(url, file_name, 0, shared))
+	{
+		std::cerr << "Resuming the download failed" << std::endl;
+		return 1;
+	}
+
+	// everything fetched beyond the object's size was fetched twice, since the journal did not record it before the kill
+	std::uint64_t refetched = killed_received + shared->received - shared->size;
+	std::cout << "Resumed " << shared->resumed << " bytes and received " << shared->received << " more, re-fetching " << refetched << " bytes (" << (100.0 * refetched / shared->size) << "% of " << shared->size << ")" << std::endl;
+
+	// the journal may only claim data which reached the file before the kill
+	if (shared->resumed > killed_received || shared->resumed + shared->received != shared->size)
+	{
+		std::cerr << "The journal claimed data that was never received" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -7,10 +7,33 @@
 #pragma once
 
 #include "curl-asio/config.h"
+#include "curl-asio/bandwidth_shaper.h"
+#include "curl-asio/body_stream.h"
+#include "curl-asio/buffer_pool.h"
+#include "curl-asio/byterange_sink.h"
+#include "curl-asio/checksum.h"
+#include "curl-asio/circuit_breaker.h"
+#include "curl-asio/coalescer.h"
+#include "curl-asio/disk_writer.h"
+#include "curl-asio/download_journal.h"
 #include "curl-asio/easy.h"
+#include "curl-asio/encoder.h"
 #include "curl-asio/error_code.h"
+#include "curl-asio/fan_out.h"
+#include "curl-asio/file_source.h"
 #include "curl-asio/form.h"
+#include "curl-asio/hedging.h"
 #include "curl-asio/initialization.h"
+#include "curl-asio/load_balancer.h"
 #include "curl-asio/multi.h"
+#include "curl-asio/origin.h"
+#include "curl-asio/pipeline.h"
+#include "curl-asio/rate_limiter.h"
+#include "curl-asio/record_sink.h"
+#include "curl-asio/relay.h"
+#include "curl-asio/retry.h"
+#include "curl-asio/segmented_download.h"
 #include "curl-asio/share.h"
+#include "curl-asio/spill_buffer.h"
 #include "curl-asio/string_list.h"
+#include "curl-asio/upload_stream.h"
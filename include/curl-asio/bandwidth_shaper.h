@@ -0,0 +1,104 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Aggregate bandwidth caps across the transfers of a multi handle
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <asio/steady_timer.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace curl
+{
+	class easy;
+
+	// Hierarchical token bucket: the total rate of all transfers is split among classes, and each class' share among its transfers, both weighted by easy::set_bandwidth_weight and both bounded by the configured rates. Transfers are keyed by easy::set_bandwidth_class, or by their origin if no class was set.
+	// Transfers which overdraw their credit are paused by returning CURL_WRITEFUNC_PAUSE or CURL_READFUNC_PAUSE from libcurl's callbacks, and released with easy::release_pause once a tick of the shaper's timer refilled their credit. Only upload data read from a source stream is shaped; post fields are handed to libcurl in one piece.
+	// Attach it with multi::set_bandwidth_shaper. Several multi handles may share a shaper as long as they run on the same io_service.
+	class CURLASIO_API bandwidth_shaper:
+		public std::enable_shared_from_this<bandwidth_shaper>,
+		public asio::noncopyable
+	{
+	public:
+		typedef std::chrono::steady_clock clock_type;
+		enum direction_t { recv = 0, send = 1 };
+
+		bandwidth_shaper(asio::io_service& io_service);
+		~bandwidth_shaper();
+
+		// Bytes per second. Zero (the default) means unlimited.
+		void set_rate(direction_t direction, double bytes_per_second);
+		void set_class_rate(const std::string& class_key, direction_t direction, double bytes_per_second);
+
+		// Period of credit refills (default: 10ms). Shorter periods smooth the traffic at the cost of more wakeups.
+		void set_interval(clock_type::duration interval);
+
+		// Achieved rates in bytes per second, averaged over about one second
+		double get_rate(direction_t direction) const;
+		double get_class_rate(const std::string& class_key, direction_t direction) const;
+
+		void add(easy* easy_handle, const std::string& class_key, unsigned int weight);
+		void remove(easy* easy_handle);
+
+		// Returns false if the transfer has overdrawn its credit and has to be paused. Otherwise the data it moves is charged afterwards.
+		bool acquire(easy* easy_handle, direction_t direction);
+		void charge(easy* easy_handle, direction_t direction, std::size_t bytes);
+
+	private:
+		struct lane
+		{
+			lane();
+
+			double credit;
+			double bytes;
+			bool paused;
+			bool demand;
+		};
+
+		struct transfer
+		{
+			std::string class_key;
+			unsigned int weight;
+			lane lanes[2];
+		};
+
+		struct traffic_class
+		{
+			traffic_class();
+
+			double limits[2];
+			double rates[2];
+			double bytes[2];
+			double weights[2];
+			double budgets[2];
+			std::size_t transfers;
+		};
+
+		typedef std::map<easy*, transfer> transfer_map;
+		typedef std::map<std::string, traffic_class> class_map;
+
+		void schedule();
+		void handle_tick(const asio::error_code& err);
+		void refill(direction_t direction, double seconds);
+		void resume(easy* easy_handle, transfer& t);
+		double idle_decay() const;
+
+		asio::steady_timer timer_;
+		clock_type::duration interval_;
+		clock_type::time_point last_tick_;
+		bool ticking_;
+		double limits_[2];
+		double rates_[2];
+		transfer_map transfers_;
+		class_map classes_;
+	};
+}
@@ -0,0 +1,74 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Response body of a transfer exposed as an asio AsyncReadStream
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <functional>
+#include <string>
+
+namespace curl
+{
+	class easy;
+
+	// Returned by easy::body_stream. Reads are satisfied from within libcurl's write callback; while no read is pending, the transfer is paused with CURL_WRITEFUNC_PAUSE and resumed by the next read. At most the tail of a single write callback is kept in between, so memory stays bounded however slowly the body is consumed.
+	// Reads complete with asio::error::eof once the transfer has finished and everything has been read, or with the transfer's error if it failed. As with any stream, only one read may be pending at a time.
+	class CURLASIO_API body_stream:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::function<void(const asio::error_code& err, std::size_t bytes_transferred)> read_handler_type;
+
+		body_stream(asio::io_service& io_service);
+		~body_stream();
+
+		inline asio::io_service& get_io_service() { return io_service_; }
+
+		template <typename MutableBufferSequence, typename ReadHandler>
+		void async_read_some(const MutableBufferSequence& buffers, ReadHandler handler)
+		{
+			asio::mutable_buffer buffer;
+
+			for (typename MutableBufferSequence::const_iterator it = buffers.begin(); it != buffers.end(); ++it)
+			{
+				if (asio::buffer_size(*it) > 0)
+				{
+					buffer = *it;
+					break;
+				}
+			}
+
+			start_read(buffer, read_handler_type(handler));
+		}
+
+		// Bytes received from libcurl which were not read yet, and the maximum of it since the transfer started
+		inline std::size_t get_buffered_bytes() const { return buffered_.size() - buffered_offset_; }
+		inline std::size_t get_peak_buffered_bytes() const { return peak_buffered_; }
+
+	private:
+		friend class easy;
+
+		void start_read(asio::mutable_buffer buffer, read_handler_type handler);
+		void reset();
+		std::size_t deliver(easy* easy_handle, const char* data, std::size_t size);
+		void finish(const asio::error_code& err);
+		void complete_read(const asio::error_code& err, std::size_t size);
+
+		asio::io_service& io_service_;
+		asio::mutable_buffer read_buffer_;
+		read_handler_type read_handler_;
+		std::string buffered_;
+		std::size_t buffered_offset_;
+		std::size_t peak_buffered_;
+		easy* paused_;
+		bool finished_;
+		asio::error_code error_;
+	};
+}
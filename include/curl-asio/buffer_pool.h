@@ -0,0 +1,163 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Pool of fixed-size slabs and bodies made of chains of slabs
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace curl
+{
+	class slab_ref;
+
+	// Hands out fixed-size slabs carved from large arenas, so that bodies of many concurrent transfers neither fragment the heap nor return memory to it piecemeal. Released slabs are kept for reuse until the pool is destroyed.
+	// A pool may be shared by several multi handles and threads. It must outlive all references to its slabs; chunk_chain takes care of this by holding on to its pool.
+	class CURLASIO_API buffer_pool:
+		public asio::noncopyable
+	{
+	public:
+		struct slab;
+
+		// With huge_pages, arenas are backed by 2MB pages where the system provides them (MAP_HUGETLB, or transparent huge pages as a fallback). Other platforms ignore the flag.
+		explicit buffer_pool(std::size_t slab_size = 16384, bool huge_pages = false);
+		~buffer_pool();
+
+		slab_ref acquire();
+
+		inline std::size_t get_slab_size() const { return slab_size_; }
+		inline bool get_huge_pages() const { return huge_pages_; }
+		std::size_t get_slabs_allocated() const;
+		std::size_t get_slabs_in_use() const;
+
+	private:
+		friend class slab_ref;
+
+		struct arena
+		{
+			char* memory;
+			std::size_t size;
+			bool mapped;
+			slab* slabs;
+		};
+
+		void grow();
+		void release(slab* s);
+
+		std::size_t slab_size_;
+		bool huge_pages_;
+		mutable std::mutex mutex_;
+		std::vector<arena> arenas_;
+		slab* free_list_;
+		std::size_t slabs_allocated_;
+		std::size_t slabs_in_use_;
+	};
+
+	// Counted reference to a slab of a buffer_pool
+	class CURLASIO_API slab_ref
+	{
+	public:
+		slab_ref();
+		slab_ref(const slab_ref& other);
+		slab_ref(slab_ref&& other);
+		~slab_ref();
+
+		slab_ref& operator=(slab_ref other);
+
+		char* data() const;
+		std::size_t capacity() const;
+
+		// True if no other reference to the slab exists, in which case its unused tail may be written to
+		bool unique() const;
+
+		inline bool empty() const { return !slab_; }
+
+	private:
+		friend class buffer_pool;
+
+		explicit slab_ref(buffer_pool::slab* s);
+
+		buffer_pool::slab* slab_;
+	};
+
+	// Body made of a chain of slabs, filled by easy::async_fetch_chain. It models ConstBufferSequence, so it can be passed to asio::async_write without copying the data; copies of a chain share its slabs.
+	class CURLASIO_API chunk_chain
+	{
+	private:
+		struct segment
+		{
+			slab_ref slab;
+			std::size_t begin;
+			std::size_t end;
+		};
+
+		typedef std::vector<segment> segment_list;
+
+	public:
+		typedef asio::const_buffer value_type;
+
+		class const_iterator
+		{
+		public:
+			typedef std::bidirectional_iterator_tag iterator_category;
+			typedef asio::const_buffer value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const asio::const_buffer* pointer;
+			typedef asio::const_buffer reference;
+
+			const_iterator() {}
+			explicit const_iterator(segment_list::const_iterator it): it_(it) {}
+
+			inline reference operator*() const { return asio::const_buffer(it_->slab.data() + it_->begin, it_->end - it_->begin); }
+			inline const_iterator& operator++() { ++it_; return *this; }
+			inline const_iterator operator++(int) { const_iterator tmp(*this); ++it_; return tmp; }
+			inline const_iterator& operator--() { --it_; return *this; }
+			inline const_iterator operator--(int) { const_iterator tmp(*this); --it_; return tmp; }
+			inline bool operator==(const const_iterator& other) const { return it_ == other.it_; }
+			inline bool operator!=(const const_iterator& other) const { return it_ != other.it_; }
+
+		private:
+			segment_list::const_iterator it_;
+		};
+
+		chunk_chain();
+		explicit chunk_chain(std::shared_ptr<buffer_pool> pool);
+
+		// Copies the data into the tail of the last slab, and into fresh slabs of the pool once that is full
+		void append(const char* data, std::size_t size);
+
+		// Drops the given number of bytes from the front, e.g. after a partial write
+		void consume(std::size_t size);
+
+		void clear();
+
+		inline std::size_t size() const { return size_; }
+		inline bool empty() const { return size_ == 0; }
+		inline std::size_t chunk_count() const { return segments_.size(); }
+		inline const std::shared_ptr<buffer_pool>& get_pool() const { return pool_; }
+
+		inline const_iterator begin() const { return const_iterator(segments_.begin()); }
+		inline const_iterator end() const { return const_iterator(segments_.end()); }
+
+		// Copies the body into contiguous memory
+		std::string str() const;
+
+	private:
+		// Declared first, so that the slabs are released before the pool
+		std::shared_ptr<buffer_pool> pool_;
+		segment_list segments_;
+		std::size_t size_;
+	};
+}
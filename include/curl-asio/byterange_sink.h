@@ -0,0 +1,95 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Incremental parser for multipart/byteranges responses
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace curl
+{
+	// Takes apart the response to a request for several ranges, see easy::set_byterange_sink. The body of each part is read by the length its Content-Range announces and handed on in place, so neither the response nor a part is ever buffered. Data goes to the handler with its offset within the resource, and is copied into any target buffer it overlaps. Responses to a single range (206 with a Content-Range header) and complete responses of servers ignoring the Range header (200) are treated as one part. Servers may merge adjacent ranges into one part, which the offsets account for.
+	class CURLASIO_API byterange_sink:
+		public asio::noncopyable
+	{
+	public:
+		static const std::uint64_t unknown_length = ~static_cast<std::uint64_t>(0);
+
+		struct part
+		{
+			// Offsets of the first and last byte of the part, and the size of the resource or unknown_length if the server did not tell
+			std::uint64_t first;
+			std::uint64_t last;
+			std::uint64_t length;
+			std::string content_type;
+		};
+
+		// Receives the data of a part in pieces. Returning false aborts the transfer with write_error.
+		typedef std::function<bool(const part& p, std::uint64_t offset, asio::const_buffer data)> handler_type;
+
+		byterange_sink();
+		byterange_sink(handler_type handler);
+		~byterange_sink();
+
+		// Has the bytes of the resource starting at offset copied into the buffer. Targets must not overlap.
+		void add_target(std::uint64_t offset, asio::mutable_buffer buffer);
+		void clear_targets();
+
+		// The targets as a value for easy::set_range, such as "0-99,500-599", with adjacent targets joined
+		std::string get_range() const;
+
+		// Starts a response given its Content-Type and Content-Range header fields. Fails for multipart responses lacking a boundary.
+		bool start(const std::string& content_type, const std::string& content_range);
+
+		// Feeds the next piece of the body. Returns false if the body is malformed or the handler asked to stop.
+		bool write(const char* data, std::size_t size);
+
+		// Whether the response ended where it should, after the closing delimiter or the announced range
+		bool finish();
+
+		void reset();
+
+		inline bool is_started() const { return state_ != idle; }
+		inline std::size_t get_parts() const { return parts_; }
+		inline std::uint64_t get_bytes() const { return bytes_; }
+
+		// Whether every byte of the targets has been received
+		inline bool is_filled() const { return filled_ >= target_bytes_; }
+
+	private:
+		enum state_type { idle, preamble, headers, body, epilogue, single };
+
+		struct target
+		{
+			std::uint64_t offset;
+			asio::mutable_buffer buffer;
+		};
+
+		bool handle_line(const char* line, std::size_t size);
+		bool deliver(const char* data, std::size_t size);
+
+		handler_type handler_;
+		std::vector<target> targets_;
+		std::uint64_t target_bytes_;
+		state_type state_;
+		std::string delimiter_;
+		std::string line_;
+		part part_;
+		bool has_range_;
+		std::uint64_t offset_;
+		std::uint64_t remaining_;
+		std::size_t parts_;
+		std::uint64_t bytes_;
+		std::uint64_t filled_;
+	};
+}
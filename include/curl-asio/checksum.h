@@ -0,0 +1,62 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Incremental checksums verifying response bodies as they are received
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <cstdint>
+#include <string>
+
+namespace curl
+{
+	// Computes a checksum over data fed to it in pieces, see easy::add_checksum. On x86-64 processors supporting them, CRC32C uses the SSE4.2 crc32 instruction on three interleaved streams and SHA-256 uses the SHA extensions; both fall back to portable table-driven and scalar code elsewhere. XXH64 is portable code throughout, as its four independent lanes already keep a scalar pipeline busy.
+	class CURLASIO_API checksum:
+		public asio::noncopyable
+	{
+	public:
+		enum algorithm { crc32c, sha256, xxh64 };
+
+		checksum(algorithm algo);
+		~checksum();
+
+		inline algorithm get_algorithm() const { return algorithm_; }
+
+		void update(const void* data, std::size_t size);
+		inline void update(asio::const_buffer data) { update(asio::buffer_cast<const void*>(data), asio::buffer_size(data)); }
+		void reset();
+
+		// The digest of the data fed so far in its canonical big-endian byte order, as carried by Digest headers. Does not end the computation.
+		std::string digest() const;
+		std::string hex_digest() const;
+		static std::size_t digest_size(algorithm algo);
+
+		// Whether the processor's instructions are used for the algorithm. Disabling acceleration affects all checksums and exists for comparing both implementations.
+		static bool is_accelerated(algorithm algo);
+		static void set_acceleration(bool enabled);
+
+		// Returns the digest a response header field announces for the algorithm in raw bytes, or an empty string if it announces none. Understands Digest (RFC 3230), Content-Digest and Repr-Digest (RFC 9530), x-goog-hash, and X-Checksum-<algorithm> or x-amz-checksum-<algorithm> carrying a hex or base64 value.
+		static std::string announced_digest(algorithm algo, const std::string& name, const std::string& value);
+
+		// Decodes a digest given in hex, or returns an empty string if it is not valid hex of the algorithm's digest size
+		static std::string parse_hex_digest(algorithm algo, const std::string& hex);
+
+	private:
+		void update_sha256(const unsigned char* data, std::size_t size);
+		void update_xxh64(const unsigned char* data, std::size_t size);
+
+		algorithm algorithm_;
+		std::uint64_t length_;
+		std::uint32_t crc_;
+		std::uint32_t sha_state_[8];
+		std::uint64_t xxh_state_[4];
+		unsigned char block_[64];
+		std::size_t block_size_;
+	};
+}
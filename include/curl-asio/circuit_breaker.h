@@ -0,0 +1,78 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Per-origin circuit breaker which fails requests to unhealthy origins without touching the network
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio/detail/noncopyable.hpp>
+#include <asio/error_code.hpp>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace curl
+{
+	// Attached to a multi handle with multi::set_circuit_breaker and fed by the results of its transfers. Transfer errors which are not caused locally and 5xx responses count as failures.
+	// closed: requests pass; the circuit opens after a number of consecutive failures.
+	// open: requests complete immediately with errc::wrapper::circuit_open until the open duration has passed.
+	// half_open: a limited number of probe requests pass. The circuit closes once enough probes succeeded, and opens again on the first failed probe.
+	class CURLASIO_API circuit_breaker:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::chrono::steady_clock clock_type;
+		enum state_t { closed, open, half_open };
+
+		circuit_breaker();
+
+		// Consecutive failures which open the circuit (default: 5)
+		void set_failure_threshold(unsigned int failures);
+
+		// Time the circuit stays open before probing the origin (default: 5s)
+		void set_open_duration(clock_type::duration duration);
+
+		// Number of probes allowed in flight while half-open, which is also the number of successful probes required to close the circuit (default: 1)
+		void set_probe_count(unsigned int probes);
+
+		state_t get_state(const std::string& origin);
+
+		// Returns false if the request must fail fast. Otherwise, probe is set if the request was admitted as one of the half-open trickle.
+		bool admit(const std::string& origin, bool& probe);
+		void record_result(const std::string& origin, bool probe, bool success);
+		void release_probe(const std::string& origin);
+
+		static bool is_failure(const asio::error_code& err, long response_code);
+
+		inline std::size_t get_rejected() const { return rejected_; }
+
+	private:
+		struct circuit
+		{
+			circuit();
+
+			state_t state;
+			unsigned int failures;
+			unsigned int probes_in_flight;
+			unsigned int probes_succeeded;
+			clock_type::time_point opened_at;
+		};
+
+		typedef std::map<std::string, circuit> circuit_map;
+
+		void trip(circuit& c);
+		void update(circuit& c);
+
+		std::mutex mutex_;
+		circuit_map circuits_;
+		unsigned int failure_threshold_;
+		clock_type::duration open_duration_;
+		unsigned int probe_count_;
+		std::size_t rejected_;
+	};
+}
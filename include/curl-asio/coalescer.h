@@ -0,0 +1,72 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Single-flight coalescing of identical in-flight requests
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace curl
+{
+	class easy;
+	class multi;
+
+	// Requests with the same method, URL and key headers which are started while an identical request is in flight attach to its transfer instead of sending their own. All of them receive the same immutable response body.
+	class CURLASIO_API coalescer:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::shared_ptr<const std::string> body_ptr;
+		typedef std::function<void(const asio::error_code& err, long response_code, body_ptr body)> handler_type;
+		typedef std::function<void(easy& handle)> setup_type;
+
+		coalescer(multi& multi_handle);
+		~coalescer();
+
+		// Names of request headers which distinguish otherwise identical requests, e.g. Accept or Authorization. The remaining headers are sent as given by the request which started the transfer.
+		void add_key_header(const std::string& name);
+
+		// Invoked for each easy handle before its transfer starts, e.g. to set timeouts or a retry policy
+		void set_setup(setup_type setup);
+
+		// Headers are given as complete "Name: value" lines. Only use this with safe methods such as GET and HEAD, as a single request is sent on behalf of all waiters.
+		void async_get(const std::string& url, handler_type handler);
+		void async_get(const std::string& url, const std::vector<std::string>& headers, handler_type handler);
+		void async_request(const std::string& method, const std::string& url, const std::vector<std::string>& headers, handler_type handler);
+
+		// Completes all waiters with operation_aborted
+		void cancel();
+
+		inline std::size_t get_transfers_started() const { return transfers_started_; }
+		inline std::size_t get_requests_coalesced() const { return requests_coalesced_; }
+
+	private:
+		struct flight;
+		typedef std::shared_ptr<flight> flight_ptr;
+		typedef std::map<std::string, flight_ptr> flight_map;
+
+		std::string make_key(const std::string& method, const std::string& url, const std::vector<std::string>& headers) const;
+		void start(const std::string& key, flight_ptr f, const std::string& method, const std::string& url, const std::vector<std::string>& headers);
+		static void handle_completion(std::string key, flight_ptr f, const asio::error_code& err, std::string body);
+		static void complete(flight_ptr f, const asio::error_code& err, long response_code, body_ptr body);
+
+		multi& multi_;
+		std::set<std::string> key_headers_;
+		setup_type setup_;
+		flight_map flights_;
+		std::size_t transfers_started_;
+		std::size_t requests_coalesced_;
+	};
+}
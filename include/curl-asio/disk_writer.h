@@ -0,0 +1,129 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	File sinks written by a pool of threads, off the thread running the io_service
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace curl
+{
+	class easy;
+	class file_sink;
+
+	// Writes response bodies to files from a small pool of threads, so that a slow disk never stalls the transfers sharing an io_service. Small writes are combined into large pwrite calls, and files are preallocated when the response announces its length.
+	// Transfers are paused with CURL_WRITEFUNC_PAUSE while the writers are behind by more than the queue limit, and resumed once half of the backlog has been written.
+	// Create it with std::make_shared and attach the sinks it opens with easy::set_file_sink. File sinks are not supported on Windows yet.
+	class CURLASIO_API disk_writer:
+		public std::enable_shared_from_this<disk_writer>,
+		public asio::noncopyable
+	{
+	public:
+		disk_writer(asio::io_service& io_service, std::size_t threads = 2);
+		~disk_writer();
+
+		// Size of the combined writes (default: 256KB)
+		void set_coalesce_size(std::size_t size);
+		inline std::size_t get_coalesce_size() const { return coalesce_size_; }
+
+		// Bytes which may wait for the writers before transfers are paused (default: 64MB)
+		void set_queue_limit(std::size_t bytes);
+
+		// Creates or truncates the file
+		std::shared_ptr<file_sink> open(const std::string& path);
+		std::shared_ptr<file_sink> open(const std::string& path, asio::error_code& ec);
+
+		std::size_t get_queued_bytes() const;
+		std::size_t get_writes() const;
+		std::size_t get_pauses() const;
+
+	private:
+		friend class file_sink;
+
+		struct job
+		{
+			std::shared_ptr<file_sink> sink;
+			std::string data;
+			std::size_t offset;
+			std::size_t preallocate;
+		};
+
+		bool submit(std::shared_ptr<file_sink> sink, std::string& data, std::size_t offset, bool force);
+		void preallocate(std::shared_ptr<file_sink> sink, std::size_t size);
+		void run();
+		void execute(job& j, asio::error_code& ec);
+
+		asio::io_service& io_service_;
+		std::size_t coalesce_size_;
+		std::size_t queue_limit_;
+		mutable std::mutex mutex_;
+		std::condition_variable wakeup_;
+		std::deque<job> jobs_;
+		std::vector<std::string> spare_buffers_;
+		std::set<std::shared_ptr<file_sink> > waiting_;
+		std::vector<std::thread> threads_;
+		std::size_t queued_bytes_;
+		std::size_t writes_;
+		std::size_t pauses_;
+		bool stopped_;
+	};
+
+	// File opened by a disk_writer. The file is closed once the sink is released and all of its data has been written.
+	class CURLASIO_API file_sink:
+		public std::enable_shared_from_this<file_sink>,
+		public asio::noncopyable
+	{
+	public:
+		typedef std::function<void(const asio::error_code& err)> handler_type;
+
+		~file_sink();
+
+		inline std::size_t get_size() const { return offset_ + staging_.size(); }
+
+		// First error reported by a writer thread; further data is rejected with write_error
+		asio::error_code get_error() const;
+
+	private:
+		friend class disk_writer;
+		friend class easy;
+
+		file_sink(std::shared_ptr<disk_writer> writer, int fd);
+
+		// Returns the number of bytes consumed, or CURL_WRITEFUNC_PAUSE if the writers are too far behind
+		std::size_t write(easy* easy_handle, const char* data, std::size_t size, std::size_t content_length);
+
+		// Hands the remaining data to the writers and invokes the handler on the io_service once all of it has been written
+		void async_flush(handler_type handler);
+
+		bool submit_staging(bool force);
+		void resume();
+
+		std::shared_ptr<disk_writer> writer_;
+		int fd_;
+		std::string staging_;
+		std::size_t offset_;
+		bool preallocated_;
+		easy* paused_;
+		std::size_t pending_;
+		asio::error_code error_;
+		handler_type flush_handler_;
+
+		// Keeps the io_service running while the sink waits for the writers to resume its transfer or to finish flushing
+		std::unique_ptr<asio::io_service::work> work_;
+	};
+}
@@ -0,0 +1,75 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Crash-safe record of the parts of a download which are on disk
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace curl
+{
+	// Sidecar file listing the byte ranges of a download which have reached its output file, together with the size and validators (ETag, Last-Modified) of the object, see segmented_download::set_journal. A save writes a temporary file, syncs it and renames it over the previous journal, so a crash leaves either the old or the new journal behind; a CRC32C over the contents rejects anything else. Journals are small text files, one line per range.
+	class CURLASIO_API download_journal:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::chrono::steady_clock clock_type;
+		typedef std::pair<std::uint64_t, std::uint64_t> range_type;
+
+		// Usually the path of the download with ".journal" appended
+		explicit download_journal(const std::string& path);
+		~download_journal();
+
+		inline const std::string& get_path() const { return path_; }
+
+		// Time between checkpoints during a download (default: 1s), counted from the end of the previous one. Each checkpoint flushes the output file before recording what it holds, both on a thread of its own so that the io_service does not wait for the disk.
+		void set_interval(clock_type::duration interval);
+		inline clock_type::duration get_interval() const { return interval_; }
+
+		// Reads the journal, or returns false and starts out empty if there is none or it is damaged
+		bool load();
+
+		void save();
+		void save(asio::error_code& ec);
+
+		// Deletes the journal, as done once a download is complete
+		void remove();
+
+		// Starts over for an object of the given size and validators, forgetting all ranges
+		void reset(std::uint64_t size, const std::string& etag, const std::string& last_modified);
+
+		// Whether the journal describes the same object. Validators have to be equal, including being absent on both sides.
+		bool matches(std::uint64_t size, const std::string& etag, const std::string& last_modified) const;
+
+		// Records [first, end) as written. Ranges are kept sorted, and overlapping or adjacent ones are merged.
+		void add_completed(std::uint64_t first, std::uint64_t end);
+
+		inline std::uint64_t get_size() const { return size_; }
+		inline const std::string& get_etag() const { return etag_; }
+		inline const std::string& get_last_modified() const { return last_modified_; }
+		inline const std::vector<range_type>& get_completed() const { return completed_; }
+		std::uint64_t get_completed_bytes() const;
+
+		// The ranges of the object not written yet
+		std::vector<range_type> get_missing() const;
+
+	private:
+		std::string path_;
+		clock_type::duration interval_;
+		std::uint64_t size_;
+		std::string etag_;
+		std::string last_modified_;
+		std::vector<range_type> completed_;
+	};
+}
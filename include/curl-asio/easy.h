@@ -11,12 +11,19 @@
 #include "config.h"
 #include <asio.hpp>
 #include <asio/detail/noncopyable.hpp>
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+#include "body_stream.h"
+#include "buffer_pool.h"
+#include "encoder.h"
 #include "error_code.h"
 #include "initialization.h"
+#include "upload_stream.h"
 
 #define STRINGIZE(text) STRINGIZE_A((text))
 #define STRINGIZE_A(arg) STRINGIZE_I arg
@@ -84,7 +91,7 @@
 	inline std::string FUNCTION_NAME() \
 	{ \
 		char *info = NULL; \
-		asio::error_code ec = asio::error_code(native::curl_easy_getinfo(handle_, OPTION_NAME, &info), asio::system_category()); \
+		asio::error_code ec = asio::error_code(native::curl_easy_getinfo(info_handle(), OPTION_NAME, &info), asio::system_category()); \
 		asio::detail::throw_error(ec, STRINGIZE(FUNCTION_NAME)); \
 		return info; \
 	}
@@ -93,7 +100,7 @@
 	inline double FUNCTION_NAME() \
 	{ \
 		double info; \
-		asio::error_code ec = asio::error_code(native::curl_easy_getinfo(handle_, OPTION_NAME, &info), asio::system_category()); \
+		asio::error_code ec = asio::error_code(native::curl_easy_getinfo(info_handle(), OPTION_NAME, &info), asio::system_category()); \
 		asio::detail::throw_error(ec, STRINGIZE(FUNCTION_NAME)); \
 		return info; \
 	}
@@ -102,7 +109,7 @@
 	inline long FUNCTION_NAME() \
 	{ \
 		long info; \
-		asio::error_code ec = asio::error_code(native::curl_easy_getinfo(handle_, OPTION_NAME, &info), asio::system_category()); \
+		asio::error_code ec = asio::error_code(native::curl_easy_getinfo(info_handle(), OPTION_NAME, &info), asio::system_category()); \
 		asio::detail::throw_error(ec, STRINGIZE(FUNCTION_NAME)); \
 		return info; \
 	}
@@ -112,7 +119,7 @@
 	{ \
 		struct native::curl_slist *info; \
 		std::vector<std::string> results; \
-		asio::error_code ec = asio::error_code(native::curl_easy_getinfo(handle_, OPTION_NAME, &info), asio::system_category()); \
+		asio::error_code ec = asio::error_code(native::curl_easy_getinfo(info_handle(), OPTION_NAME, &info), asio::system_category()); \
 		asio::detail::throw_error(ec, STRINGIZE(FUNCTION_NAME)); \
 		struct native::curl_slist *it = info; \
 		while (it) \
@@ -126,9 +133,20 @@
 
 namespace curl
 {
+	class byterange_sink;
+	class checksum;
+	class file_sink;
+	class file_source;
 	class form;
+	class hedged_request;
+	class hedging_policy;
 	class multi;
+	class pipeline;
+	class record_sink;
+	class relay;
+	class retry_policy;
 	class share;
+	class spill_buffer;
 	class string_list;
 
 	class CURLASIO_API easy:
@@ -136,6 +154,8 @@ namespace curl
 	{
 	public:
 		typedef std::function<void(const asio::error_code& err)> handler_type;
+		typedef std::function<void(const asio::error_code& err, std::string body)> fetch_handler_type;
+		typedef std::function<void(const asio::error_code& err, chunk_chain body)> fetch_chain_handler_type;
 
 		static easy* from_native(native::CURL* native_easy);
 
@@ -143,21 +163,130 @@ namespace curl
 		easy(multi& multi_handle);
 		~easy();
 
+		inline asio::io_service& get_io_service() { return io_service_; }
 		inline native::CURL* native_handle() { return handle_; }
 
+		// Creates a new easy handle with the same options, attached to the same multi handle (if any)
+		std::shared_ptr<easy> duplicate();
+
 		void perform();
 		void perform(asio::error_code& ec);
 		void async_perform(handler_type handler);
+
+		// Performs the request like async_perform and collects the response body in memory, replacing any sink. The buffer is allocated once with the size announced by Content-Length, and grows geometrically only for responses without one. The body is moved into the handler.
+		void async_fetch(fetch_handler_type handler);
+
+		// Like async_fetch, but collects the body in slabs of the multi handle's buffer pool (see multi::set_buffer_pool), which can be written to sockets without copying them into contiguous memory
+		void async_fetch_chain(fetch_chain_handler_type handler);
+
+		// Exposes the response of the transfers performed using async_perform as an AsyncReadStream, see body_stream.h. Each call returns the same stream, which is reset whenever a transfer starts. Replaces other sinks.
+		curl::body_stream& body_stream();
+
+		// Takes the request body of the transfers performed using async_perform from an AsyncWriteStream, see upload_stream.h. Select the method with set_post or set_upload first. Bodies of unknown size (-1) are sent with chunked transfer encoding. Replaces a source set with set_source or set_file_source.
+		curl::upload_stream& upload_stream(native::curl_off_t size = -1);
+		curl::upload_stream& upload_stream(native::curl_off_t size, asio::error_code& ec);
 		void cancel();
+
+		// Pauses the given directions of the transfer and lifts the user's pause of all others, see pause_holder. Passing pause_cont lifts it for both directions.
+		enum pause_flags { pause_recv = CURLPAUSE_RECV, pause_send = CURLPAUSE_SEND, pause_all = CURLPAUSE_ALL, pause_cont = CURLPAUSE_CONT };
+		void pause(int bitmask);
+		void pause(int bitmask, asio::error_code& ec);
+
+		// A direction of the transfer stays paused until every holder which paused it has released it, so that e.g. a write to an upload stream does not resume a download the bandwidth shaper holds back. Holds are taken by returning CURL_WRITEFUNC_PAUSE or CURL_READFUNC_PAUSE from libcurl's callbacks: by the shaper, by the sinks and sources of this library, and by the user for buffer sinks returning sink_pause and for pause.
+		enum pause_holder { pause_by_user = 1, pause_by_sink = 2, pause_by_source = 4, pause_by_shaper = 8 };
+
+		// Releases the holder's pause of the given directions and resumes those no other holder pauses anymore
+		void release_pause(int bitmask, pause_holder holder);
+		void release_pause(int bitmask, pause_holder holder, asio::error_code& ec);
+
 		void set_source(std::shared_ptr<std::istream> source);
 		void set_source(std::shared_ptr<std::istream> source, asio::error_code& ec);
+
+		// Sends an open file as the request body, see file_source.h. The file's size is announced with set_in_file_size_large and set_post_field_size_large, so select the method with set_post or set_upload. Unlike a source stream, the file can be replayed, which allows retrying the request. Replaces a source set with set_source or upload_stream.
+		void set_file_source(std::shared_ptr<file_source> source);
+		void set_file_source(std::shared_ptr<file_source> source, asio::error_code& ec);
+
+		// Compresses the request body while libcurl reads it and announces the coding with a Content-Encoding header, see encoder.h. Applies to bodies from set_source, set_file_source, set_post_buffers and upload_stream, which are sent with chunked transfer encoding as their compressed size is not known upfront; post fields are sent as they are. Bodies can only be sent again from their start, which suffices for retries and redirects. Fails with operation_not_supported for codings not enabled at build time.
+		void set_upload_encoding(encoder::coding coding, int level = -1);
+		void set_upload_encoding(encoder::coding coding, int level, asio::error_code& ec);
+
+		// Sends the body as it is again. The size of a body set before has to be announced again, e.g. by setting it again.
+		void clear_upload_encoding();
+		void clear_upload_encoding(asio::error_code& ec);
 		void set_sink(std::shared_ptr<std::ostream> sink);
 		void set_sink(std::shared_ptr<std::ostream> sink, asio::error_code& ec);
 
+		// Hands response data to the sink in place, without a stream buffer in between and without virtual dispatch. The sink is a callable with the signature std::size_t(asio::const_buffer) which returns the number of bytes it consumed. Returning less than the whole buffer aborts the transfer with write_error, and returning sink_pause pauses it until it is resumed with pause(pause_cont) or release_pause(pause_recv, pause_by_user). Replaces a sink set with set_sink.
+		static const std::size_t sink_pause = CURL_WRITEFUNC_PAUSE;
+
+		template <typename Sink>
+		void set_buffer_sink(Sink sink)
+		{
+			asio::error_code ec;
+			set_buffer_sink(std::move(sink), ec);
+			asio::detail::throw_error(ec, "set_buffer_sink");
+		}
+
+		template <typename Sink>
+		void set_buffer_sink(Sink sink, asio::error_code& ec)
+		{
+			std::shared_ptr<Sink> holder = std::make_shared<Sink>(std::move(sink));
+			set_buffer_sink(&easy::invoke_buffer_sink<Sink>, holder.get(), holder, ec);
+		}
+
+		// Appends the response to a buffer which moves to a memory-mapped temporary file once it grows large, see spill_buffer.h. The buffer is cleared whenever a transfer starts. Replaces other sinks.
+		void set_spill_sink(std::shared_ptr<spill_buffer> sink);
+		void set_spill_sink(std::shared_ptr<spill_buffer> sink, asio::error_code& ec);
+
+		// Hands the response to a disk_writer's threads instead of writing it on the thread running the io_service, see disk_writer.h. The completion handler runs once all data has been written. Only for async_perform. Replaces other sinks.
+		void set_file_sink(std::shared_ptr<file_sink> sink);
+		void set_file_sink(std::shared_ptr<file_sink> sink, asio::error_code& ec);
+
+		// Runs the stages of a pipeline over the response, see pipeline.h. The stages are flushed when the transfer succeeds. Replaces other sinks.
+		void set_pipeline(std::shared_ptr<curl::pipeline> pipeline);
+		void set_pipeline(std::shared_ptr<curl::pipeline> pipeline, asio::error_code& ec);
+
+		// Splits the response into NDJSON records or server-sent events, see record_sink.h. A final record lacking its line break is handed over when the transfer succeeds. Replaces other sinks.
+		void set_record_sink(std::shared_ptr<record_sink> sink);
+		void set_record_sink(std::shared_ptr<record_sink> sink, asio::error_code& ec);
+
+		// Takes apart a response to a request for several ranges, see byterange_sink.h. Turns on header capture, which the sink needs for the boundary and Content-Range. Bodies of responses other than 200 and 206 are dropped. Replaces other sinks.
+		void set_byterange_sink(std::shared_ptr<byterange_sink> sink);
+		void set_byterange_sink(std::shared_ptr<byterange_sink> sink, asio::error_code& ec);
+
+		// Keeps the header fields of the final response, including trailers, for get_response_header. Replaces a function set with set_header_function.
+		void set_header_capture(bool enabled);
+		void set_header_capture(bool enabled, asio::error_code& ec);
+
+		// Value of a captured header field, with repeated fields joined by commas. Names are case-insensitive.
+		std::string get_response_header(const std::string& name) const;
+
+		// Feeds the response body to the checksum as the sink accepts it, see checksum.h. Once the transfer succeeded, the digest is compared with the expected one given in hex, or else with one the response announces in its headers, which is why checksums without an expected digest enable header capture. A mismatch fails the transfer with errc::wrapper::checksum_mismatch; checksums with neither are only computed. The digest covers the body as delivered, so announced digests only match responses whose content encoding libcurl does not decode. Content-MD5 is not checked. Without a sink, the body is discarded.
+		void add_checksum(std::shared_ptr<checksum> sum, const std::string& expected = std::string());
+		void add_checksum(std::shared_ptr<checksum> sum, const std::string& expected, asio::error_code& ec);
+		void clear_checksums();
+
 		typedef std::function<bool(native::curl_off_t dltotal, native::curl_off_t dlnow, native::curl_off_t ultotal, native::curl_off_t ulnow)> progress_callback_t;
 		void unset_progress_callback();
 		void set_progress_callback(progress_callback_t progress_callback);
 
+		// Sends a duplicate of slow requests performed using async_perform, see hedging.h
+		void set_hedging_policy(std::shared_ptr<hedging_policy> policy);
+
+		// Retries transient failures of requests performed using async_perform, see retry.h
+		void set_retry_policy(std::shared_ptr<retry_policy> policy);
+		inline unsigned int get_attempts() const { return attempts_; }
+
+		// Bucket of the multi handle's rate limiter this request is charged to. Requests without a key are charged to their origin.
+		void set_rate_limit_key(const std::string& key);
+		inline const std::string& get_rate_limit_key() const { return rate_limit_key_; }
+
+		// Class and weight of this transfer within the multi handle's bandwidth shaper. Transfers without a class are grouped by origin.
+		void set_bandwidth_class(const std::string& class_key);
+		inline const std::string& get_bandwidth_class() const { return bandwidth_class_; }
+		void set_bandwidth_weight(unsigned int weight);
+		inline unsigned int get_bandwidth_weight() const { return bandwidth_weight_; }
+
 		// behavior options
 
 		IMPLEMENT_CURL_OPTION_BOOLEAN(set_verbose, native::CURLOPT_VERBOSE);
@@ -218,7 +347,11 @@ namespace curl
 
 		// network options
 
-		IMPLEMENT_CURL_OPTION_STRING(set_url, native::CURLOPT_URL);
+		void set_url(const char* url);
+		void set_url(const char* url, asio::error_code& ec);
+		void set_url(const std::string& url);
+		void set_url(const std::string& url, asio::error_code& ec);
+		inline const std::string& get_url() const { return url_; }
 		IMPLEMENT_CURL_OPTION(set_protocols, native::CURLOPT_PROTOCOLS, long);
 		IMPLEMENT_CURL_OPTION(set_redir_protocols, native::CURLOPT_REDIR_PROTOCOLS, long);
 		IMPLEMENT_CURL_OPTION_STRING(set_proxy, native::CURLOPT_PROXY);
@@ -278,6 +411,42 @@ namespace curl
 		IMPLEMENT_CURL_OPTION_BOOLEAN(set_post, native::CURLOPT_POST);
 		void set_post_fields(const std::string& post_fields);
 		void set_post_fields(const std::string& post_fields, asio::error_code& ec);
+		void set_post_fields(std::shared_ptr<const std::string> post_fields);
+		void set_post_fields(std::shared_ptr<const std::string> post_fields, asio::error_code& ec);
+		void set_post_fields(std::string&& post_fields);
+		void set_post_fields(std::string&& post_fields, asio::error_code& ec);
+
+		// Points libcurl at a body in memory which is not copied. Unless it is held by the owner, the memory must remain valid and unchanged until all transfers using it have finished.
+		void set_post_fields(asio::const_buffer post_fields, std::shared_ptr<const void> owner = std::shared_ptr<const void>());
+		void set_post_fields(asio::const_buffer post_fields, std::shared_ptr<const void> owner, asio::error_code& ec);
+
+		// Sends the buffers of a ConstBufferSequence as the body of a POST request without joining them, as the read callback copies from each buffer in turn. The same lifetime rules as for set_post_fields(asio::const_buffer) apply. Replaces a source set with set_source, set_file_source or upload_stream.
+		template <typename ConstBufferSequence>
+		void set_post_buffers(const ConstBufferSequence& buffers, std::shared_ptr<const void> owner = std::shared_ptr<const void>())
+		{
+			asio::error_code ec;
+			set_post_buffers(buffers, owner, ec);
+			asio::detail::throw_error(ec, "set_post_buffers");
+		}
+
+		template <typename ConstBufferSequence>
+		void set_post_buffers(const ConstBufferSequence& buffers, std::shared_ptr<const void> owner, asio::error_code& ec)
+		{
+			std::shared_ptr<std::vector<asio::const_buffer> > list = std::make_shared<std::vector<asio::const_buffer> >();
+
+			for (typename ConstBufferSequence::const_iterator it = buffers.begin(); it != buffers.end(); ++it)
+			{
+				asio::const_buffer buffer(*it);
+
+				if (asio::buffer_size(buffer) > 0)
+				{
+					list->push_back(buffer);
+				}
+			}
+
+			set_post_buffer_list(list, owner, ec);
+		}
+
 		IMPLEMENT_CURL_OPTION(set_post_fields, native::CURLOPT_POSTFIELDS, void*);
 		IMPLEMENT_CURL_OPTION(set_post_field_size, native::CURLOPT_POSTFIELDSIZE, long);
 		IMPLEMENT_CURL_OPTION(set_post_field_size_large, native::CURLOPT_POSTFIELDSIZE_LARGE, native::curl_off_t);
@@ -291,6 +460,7 @@ namespace curl
 		void add_header(const std::string& header, asio::error_code& ec);
 		void set_headers(std::shared_ptr<string_list> headers);
 		void set_headers(std::shared_ptr<string_list> headers, asio::error_code& ec);
+		inline std::shared_ptr<string_list> get_headers() const { return headers_; }
 		void add_http200_alias(const std::string& http200_alias);
 		void add_http200_alias(const std::string& http200_alias, asio::error_code& ec);
 		void set_http200_aliases(std::shared_ptr<string_list> http200_aliases);
@@ -415,6 +585,17 @@ namespace curl
 		void set_resolves(std::shared_ptr<string_list> resolved_hosts, asio::error_code& ec);
 		IMPLEMENT_CURL_OPTION_STRING(set_dns_servers, native::CURLOPT_DNS_SERVERS);
 		IMPLEMENT_CURL_OPTION(set_accept_timeout_ms, native::CURLOPT_ACCEPTTIMEOUT_MS, long);
+#if LIBCURL_VERSION_NUM >= 0x073100
+		void add_connect_to(const std::string& connect_to);
+		void add_connect_to(const std::string& connect_to, asio::error_code& ec);
+		void set_connect_to(std::shared_ptr<string_list> connect_to);
+		void set_connect_to(std::shared_ptr<string_list> connect_to, asio::error_code& ec);
+		inline bool has_connect_to() const { return !!connect_to_; }
+
+		// Directs the transfer to the given address of the URL's host, as picked by the multi handle's load balancer. An empty address restores the connect-to list.
+		void set_endpoint(const std::string& address);
+		void set_endpoint(const std::string& address, asio::error_code& ec);
+#endif
 
 		// SSL and security options
 
@@ -532,10 +713,51 @@ namespace curl
 		void handle_completion(const asio::error_code& err);
 
 	private:
+		friend class hedged_request;
+		friend class relay;
+
+		easy(easy& prototype, native::CURL* native_easy);
 		void init();
+		void start_async_perform(handler_type handler, std::shared_ptr<hedged_request> hedge);
+		void complete(const asio::error_code& err);
+		bool is_retryable_response();
+		void hold_pause(int bitmask, pause_holder holder);
+		int paused_directions() const;
+		bool schedule_retry(const asio::error_code& err);
 		native::curl_socket_t open_tcp_socket(native::curl_sockaddr* address);
 
+		// Transfer information is read from the hedge if it delivered the response
+		inline native::CURL* info_handle() const { return hedge_winner_ ? hedge_winner_->handle_ : handle_; }
+
+		typedef std::size_t (*buffer_sink_function_t)(void* context, const asio::const_buffer& data);
+		void set_buffer_sink(buffer_sink_function_t function, void* context, std::shared_ptr<void> owner, asio::error_code& ec);
+
+		template <typename Sink>
+		static std::size_t invoke_buffer_sink(void* context, const asio::const_buffer& data)
+		{
+			return (*static_cast<Sink*>(context))(data);
+		}
+
+		void set_post_buffer_list(std::shared_ptr<const std::vector<asio::const_buffer> > buffers, std::shared_ptr<const void> owner, asio::error_code& ec);
+		std::size_t read_post_buffers(char* data, std::size_t size);
+		std::size_t read_source(char* data, std::size_t size);
+		std::size_t read_encoded(char* data, std::size_t size);
+		void reset_encoder();
+		void apply_upload_encoding(asio::error_code& ec);
+		void clear_sinks();
+		std::size_t deliver_to_sink(char* ptr, std::size_t size);
+		std::size_t deliver_byteranges(char* ptr, std::size_t size);
+		void reset_checksums();
+		bool verify_checksums();
+		void finish_sinks(asio::error_code& err);
+		static void handle_file_flush(handler_type handler, asio::error_code err, const asio::error_code& flush_err);
+		std::size_t announced_content_length();
+		static void handle_fetch(std::shared_ptr<std::string> body, fetch_handler_type handler, const asio::error_code& err);
+		void append_fetched(const char* data, std::size_t size);
+		static void handle_fetch_chain(std::shared_ptr<chunk_chain> body, fetch_chain_handler_type handler, const asio::error_code& err);
+
 		static size_t write_function(char* ptr, size_t size, size_t nmemb, void* userdata);
+		static size_t header_function(void* ptr, size_t size, size_t nmemb, void* userdata);
 		static size_t read_function(void* ptr, size_t size, size_t nmemb, void* userdata);
 		static int seek_function(void* instream, native::curl_off_t offset, int origin);
 #if LIBCURL_VERSION_NUM < 0x072000
@@ -552,18 +774,66 @@ namespace curl
 		multi* multi_;
 		bool multi_registered_;
 		handler_type handler_;
+		std::string url_;
 		std::shared_ptr<std::istream> source_;
+		std::shared_ptr<file_source> file_source_;
+		native::curl_off_t source_offset_;
+		std::shared_ptr<const std::vector<asio::const_buffer> > post_buffers_;
+		native::curl_off_t post_buffers_size_;
+		std::size_t post_buffers_index_;
+		native::curl_off_t post_buffers_base_;
+		std::shared_ptr<encoder> encoder_;
+		std::vector<char> encoder_input_;
+		std::size_t encoder_input_begin_;
+		std::size_t encoder_input_end_;
+		bool encoder_input_eof_;
+		std::shared_ptr<string_list> encoded_headers_;
 		std::shared_ptr<std::ostream> sink_;
-		std::string post_fields_;
+		buffer_sink_function_t buffer_sink_function_;
+		void* buffer_sink_context_;
+		std::shared_ptr<void> buffer_sink_owner_;
+		bool buffer_sink_by_library_;
+		std::shared_ptr<std::string> fetch_body_;
+		std::shared_ptr<chunk_chain> fetch_chain_;
+		std::shared_ptr<spill_buffer> spill_sink_;
+		std::shared_ptr<file_sink> file_sink_;
+		std::shared_ptr<curl::pipeline> pipeline_;
+		std::shared_ptr<record_sink> record_sink_;
+		std::shared_ptr<byterange_sink> byterange_sink_;
+		std::vector<std::pair<std::shared_ptr<checksum>, std::string> > checksums_;
+		bool header_capture_;
+		std::vector<std::pair<std::string, std::string> > response_headers_;
+		std::shared_ptr<curl::body_stream> body_stream_;
+		bool body_streaming_;
+		std::shared_ptr<curl::upload_stream> upload_stream_;
+		bool upload_streaming_;
+		std::shared_ptr<const void> post_fields_;
 		std::shared_ptr<form> form_;
 		std::shared_ptr<string_list> headers_;
 		std::shared_ptr<string_list> http200_aliases_;
 		std::shared_ptr<string_list> mail_rcpts_;
 		std::shared_ptr<string_list> quotes_;
 		std::shared_ptr<string_list> resolved_hosts_;
+		std::shared_ptr<string_list> connect_to_;
+		std::shared_ptr<string_list> endpoint_;
 		std::shared_ptr<share> share_;
 		std::shared_ptr<string_list> telnet_options_;
 		progress_callback_t progress_callback_;
+		std::shared_ptr<hedging_policy> hedging_policy_;
+		std::shared_ptr<hedged_request> hedge_;
+		std::shared_ptr<easy> hedge_winner_;
+		std::shared_ptr<retry_policy> retry_policy_;
+		unsigned int attempts_;
+		bool retry_acquired_;
+		std::chrono::steady_clock::duration retry_delay_;
+		bool response_started_;
+		bool response_discarded_;
+		bool response_delivered_;
+		std::string rate_limit_key_;
+		std::string bandwidth_class_;
+		unsigned int bandwidth_weight_;
+		int recv_pause_holders_;
+		int send_pause_holders_;
 	};
 }
 
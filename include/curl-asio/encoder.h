@@ -0,0 +1,60 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Incremental compression of request bodies for Content-Encoding
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <cstdint>
+
+namespace curl
+{
+	// Compresses a request body piece by piece while libcurl reads it, see easy::set_upload_encoding. gzip and deflate are available when building with ENABLE_ZLIB (the default) and zlib is found, zstd with ENABLE_ZSTD. The memory of an encoder is bounded by the state of its compression stream, which is about 256KB for zlib and grows with the level for zstd, from a few MB at level 3 to about 90MB at level 19.
+	class CURLASIO_API encoder:
+		public asio::noncopyable
+	{
+	public:
+		enum coding { gzip, deflate, zstd };
+		enum flush_mode { no_flush, sync_flush, finish };
+
+		// Level -1 selects the default of the coding. Throws operation_not_supported for codings not enabled at build time, and std::bad_alloc if the compression stream cannot be set up.
+		encoder(coding c, int level = -1);
+		~encoder();
+
+		static bool is_supported(coding c);
+		inline coding get_coding() const { return coding_; }
+		inline int get_level() const { return level_; }
+
+		// Token of the coding for the Content-Encoding header
+		const char* name() const;
+
+		// Compresses as much input as fits into the output, advancing data and decreasing size by the input consumed, and returns the number of bytes written. sync_flush emits everything fed so far, finish ends the stream once all input has been consumed. Both take as many calls as it takes to complete them.
+		std::size_t encode(const char*& data, std::size_t& size, char* output, std::size_t output_size, flush_mode mode, asio::error_code& ec);
+
+		// Whether input has been consumed which has not been emitted by a flush yet
+		inline bool has_pending() const { return pending_; }
+		inline bool is_finished() const { return finished_; }
+		inline std::uint64_t get_bytes_in() const { return bytes_in_; }
+		inline std::uint64_t get_bytes_out() const { return bytes_out_; }
+
+		// Starts a new stream, as needed when the body is sent again
+		void reset();
+
+	private:
+		struct stream;
+
+		coding coding_;
+		int level_;
+		stream* stream_;
+		bool pending_;
+		bool finished_;
+		std::uint64_t bytes_in_;
+		std::uint64_t bytes_out_;
+	};
+}
@@ -144,10 +144,23 @@ namespace curl
 			};
 		}
 
+		// Errors raised by curl-asio itself rather than by libcurl
+		namespace wrapper
+		{
+			enum wrapper_error_codes
+			{
+				success = 0,
+				circuit_open,
+				checksum_mismatch,
+				resource_changed
+			};
+		}
+
 		const asio::error_category& get_easy_category();
 		const asio::error_category& get_multi_category();
 		const asio::error_category& get_share_category();
 		const asio::error_category& get_form_category();
+		const asio::error_category& get_wrapper_category();
 	}
 }
 
@@ -187,6 +200,14 @@ namespace curl
 				return asio::error_code(static_cast<int>(e), get_form_category());
 			}
 		}
+
+		namespace wrapper
+		{
+			inline asio::error_code make_error_code(wrapper_error_codes e)
+			{
+				return asio::error_code(static_cast<int>(e), get_wrapper_category());
+			}
+		}
 	}
 
 	namespace native
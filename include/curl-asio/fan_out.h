@@ -0,0 +1,67 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Sends one request body to several URLs and completes once a quorum of them succeeded
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "easy.h"
+
+namespace curl
+{
+	class multi;
+
+	class CURLASIO_API fan_out:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::function<void(const asio::error_code& err)> handler_type;
+
+		fan_out(multi& multi_handle);
+		~fan_out();
+
+		// Creates an easy handle for the given URL. The returned handle is owned by this object and may be configured further (method, headers, timeouts) before calling async_perform.
+		easy& add(const std::string& url);
+		easy& at(std::size_t index);
+		inline std::size_t size() const { return handles_.size(); }
+
+		// The body is shared by reference among all requests; it is never copied.
+		void set_body(std::shared_ptr<const std::string> body);
+		void set_body(std::shared_ptr<const std::string> body, asio::error_code& ec);
+
+		// Number of successful responses required for completion. Zero (the default) requires all requests to succeed.
+		void set_quorum(std::size_t quorum);
+		inline std::size_t get_quorum() const { return quorum_ ? quorum_ : handles_.size(); }
+
+		// The handler fires once the quorum has been reached, or with the last failure once it can no longer be reached. Requests which are still running at that point are cancelled.
+		void async_perform(handler_type handler);
+		void cancel();
+
+		// Results of the last operation. Requests which were cancelled after completion report operation_aborted.
+		std::size_t succeeded() const;
+		asio::error_code result(std::size_t index) const;
+
+	private:
+		struct operation;
+		typedef std::shared_ptr<operation> operation_ptr;
+
+		static void handle_response(operation_ptr op, std::size_t index, const asio::error_code& err);
+		static void complete(operation_ptr op, const asio::error_code& err);
+
+		multi& multi_;
+		std::vector<std::shared_ptr<easy> > handles_;
+		std::shared_ptr<const std::string> body_;
+		std::size_t quorum_;
+		operation_ptr operation_;
+	};
+}
@@ -0,0 +1,48 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Upload source reading a file with pread or from a memory mapping
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <cstddef>
+#include <string>
+#include "native.h"
+
+namespace curl
+{
+	// Serves libcurl's read callback straight from a file, without a stream buffer in between. Attach it with easy::set_file_source, which also announces the file's size. Every transfer keeps its own position, so libcurl can rewind precisely for redirects and authentication, and retried or hedged requests resend the file from the start.
+	// File sources are not supported on Windows yet.
+	class CURLASIO_API file_source:
+		public asio::noncopyable
+	{
+	public:
+		// read_pread asks the kernel to read ahead of the transfer; read_mapped copies from a mapping of the whole file, and falls back to pread if the file cannot be mapped
+		enum mode_t { read_pread, read_mapped };
+
+		file_source();
+		~file_source();
+
+		void open(const std::string& path, mode_t mode = read_pread);
+		void open(const std::string& path, mode_t mode, asio::error_code& ec);
+		void close();
+
+		inline bool is_open() const { return (fd_ != -1); }
+		inline bool is_mapped() const { return (mapping_ != 0); }
+		inline native::curl_off_t get_size() const { return size_; }
+
+		// Copies up to size bytes from the given offset, returning 0 at the end of the file
+		std::size_t read_at(native::curl_off_t offset, char* data, std::size_t size, asio::error_code& ec);
+
+	private:
+		int fd_;
+		native::curl_off_t size_;
+		char* mapping_;
+	};
+}
@@ -0,0 +1,103 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Hedged requests: a duplicate of a slow request is sent after a delay derived from the origin's observed latency
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <asio/steady_timer.hpp>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "origin.h"
+
+namespace curl
+{
+	class easy;
+
+	// Shared by all requests which should be hedged. Only attach it to idempotent requests; the duplicate is a copy of the original easy handle made with curl_easy_duphandle.
+	class CURLASIO_API hedging_policy:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::chrono::steady_clock clock_type;
+
+		hedging_policy();
+
+		// The hedge is sent once a request has been running longer than this percentile of the origin's recent latencies (default: 0.95)
+		void set_percentile(double percentile);
+
+		// Bounds for the computed delay. Until enough samples are available for an origin, max_delay is used. (default: 10ms and 1s)
+		void set_delay_bounds(clock_type::duration min_delay, clock_type::duration max_delay);
+
+		// Caps hedges to the given percentage of requests (default: 5)
+		void set_budget(double percent);
+
+		// Sends the hedge to a different address of the origin than the one the original request connected to, if the host resolves to more than one address
+		void set_prefer_other_address(bool enabled);
+		inline bool get_prefer_other_address() const { return prefer_other_address_; }
+
+		clock_type::duration hedge_delay(const std::string& origin);
+		void record_latency(const std::string& origin, clock_type::duration latency);
+		void record_request();
+		bool acquire_hedge();
+
+		inline std::size_t get_hedges_sent() const { return hedges_sent_; }
+
+	private:
+		typedef std::deque<clock_type::duration> sample_list;
+		typedef std::map<std::string, sample_list> sample_map;
+
+		std::mutex mutex_;
+		sample_map samples_;
+		double percentile_;
+		clock_type::duration min_delay_;
+		clock_type::duration max_delay_;
+		double budget_ratio_;
+		double budget_tokens_;
+		bool prefer_other_address_;
+		std::size_t hedges_sent_;
+	};
+
+	// Internal state of a single hedged async_perform call, owned by the original easy handle
+	class hedged_request:
+		public std::enable_shared_from_this<hedged_request>,
+		public asio::noncopyable
+	{
+	public:
+		hedged_request(easy& primary, std::shared_ptr<hedging_policy> policy);
+		~hedged_request();
+
+		void start();
+		bool commit(easy& attempt);
+		void handle_completion(easy& attempt, const asio::error_code& err);
+
+	private:
+		void handle_timer(const asio::error_code& err);
+		void handle_resolve(const asio::error_code& err, asio::ip::tcp::resolver::iterator it, std::string primary_ip);
+		void launch(const std::string& connect_to);
+		void cancel_loser();
+		void finish(const asio::error_code& err, easy* winner);
+
+		easy& primary_;
+		std::shared_ptr<hedging_policy> policy_;
+		origin origin_;
+		asio::steady_timer timer_;
+		asio::ip::tcp::resolver resolver_;
+		std::shared_ptr<easy> hedge_;
+		easy* winner_;
+		bool primary_running_;
+		bool hedge_running_;
+		bool finished_;
+		hedging_policy::clock_type::time_point started_;
+	};
+}
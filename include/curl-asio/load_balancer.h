@@ -0,0 +1,85 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Client-side load balancing across the addresses of an origin using power-of-two-choices
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace curl
+{
+	// Attached to a multi handle with multi::set_load_balancer. Each request to an origin with known endpoints is pinned to one of them with CURLOPT_CONNECT_TO: two endpoints are drawn at random, and the one with the lower product of in-flight requests and latency wins. Requests with explicit connect-to entries are left alone.
+	class CURLASIO_API load_balancer:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::chrono::steady_clock clock_type;
+		typedef std::function<void(const asio::error_code& err)> resolve_handler_type;
+
+		struct endpoint_stats
+		{
+			std::string address;
+			std::size_t in_flight;
+			std::size_t requests;
+			clock_type::duration latency;
+		};
+
+		load_balancer();
+
+		// Replaces the endpoints of the URL's origin. Endpoints which remain in the set keep their statistics.
+		void set_endpoints(const std::string& url, const std::vector<std::string>& addresses);
+
+		// Resolves the URL's host and uses all of its addresses as endpoints. The balancer has to outlive the operation.
+		void async_resolve(asio::io_service& io_service, const std::string& url, resolve_handler_type handler);
+
+		// Weight of a new latency sample in the moving average (default: 0.2)
+		void set_smoothing(double alpha);
+
+		// Latency recorded for failed requests, unless the request took even longer (default: 1s)
+		void set_failure_penalty(clock_type::duration penalty);
+
+		std::vector<endpoint_stats> get_stats(const std::string& url);
+
+		// Picks an endpoint of the origin and counts the request against it. Returns an empty string if the origin has no endpoints.
+		std::string acquire(const std::string& origin);
+		void record_result(const std::string& origin, const std::string& address, clock_type::duration latency, bool success);
+		void release(const std::string& origin, const std::string& address);
+
+	private:
+		struct endpoint
+		{
+			endpoint();
+
+			std::string address;
+			std::size_t in_flight;
+			std::size_t requests;
+			double latency;
+		};
+
+		typedef std::vector<endpoint> endpoint_list;
+		typedef std::map<std::string, endpoint_list> origin_map;
+
+		void handle_resolve(std::shared_ptr<asio::ip::tcp::resolver> resolver, std::string url, resolve_handler_type handler, const asio::error_code& err, asio::ip::tcp::resolver::iterator it);
+		endpoint* find(const std::string& origin, const std::string& address);
+		double cost(const endpoint& e) const;
+
+		std::mutex mutex_;
+		origin_map origins_;
+		double smoothing_;
+		double failure_penalty_;
+		std::mt19937 random_;
+	};
+}
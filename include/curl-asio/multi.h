@@ -13,16 +13,23 @@
 #include <functional>
 #include <asio/detail/noncopyable.hpp>
 #include <asio/steady_timer.hpp>
+#include <chrono>
 #include <memory>
 #include <map>
 #include <set>
+#include <string>
 #include "initialization.h"
 #include "native.h"
 #include "socket_info.h"
 
 namespace curl
 {
+	class bandwidth_shaper;
+	class buffer_pool;
+	class circuit_breaker;
 	class easy;
+	class load_balancer;
+	class rate_limiter;
 
 	class CURLASIO_API multi:
 		public asio::noncopyable
@@ -37,12 +44,36 @@ namespace curl
 		void add(easy* easy_handle);
 		void remove(easy* easy_handle);
 
+		// Adds the easy handle once the given point in time has been reached. All deferred handles share a single timer.
+		void add_deferred(easy* easy_handle, std::chrono::steady_clock::time_point when);
+
+		// Requests to origins whose circuit is open complete with errc::wrapper::circuit_open instead of being added, see circuit_breaker.h
+		void set_circuit_breaker(std::shared_ptr<circuit_breaker> breaker);
+
+		// Requests are added to libcurl once their rate limit bucket grants a token; until then they wait in the deferred queue, see rate_limiter.h
+		void set_rate_limiter(std::shared_ptr<rate_limiter> limiter);
+
+		// Caps the aggregate bandwidth of all transfers, see bandwidth_shaper.h
+		void set_bandwidth_shaper(std::shared_ptr<bandwidth_shaper> shaper);
+		inline const std::shared_ptr<bandwidth_shaper>& get_bandwidth_shaper() const { return bandwidth_shaper_; }
+
+		// Pins requests to endpoints of their origin, see load_balancer.h. Requires libcurl 7.49.0 or newer; older versions ignore the balancer.
+		void set_load_balancer(std::shared_ptr<load_balancer> balancer);
+
+		// Pool for the bodies of easy::async_fetch_chain, see buffer_pool.h. A pool of 16KB slabs is created on first use unless one was set.
+		void set_buffer_pool(std::shared_ptr<buffer_pool> pool);
+		std::shared_ptr<buffer_pool> get_buffer_pool();
+
 		void socket_register(std::shared_ptr<socket_info> si);
 		void socket_cleanup(native::curl_socket_t s);
 
 	private:
 		typedef std::shared_ptr<socket_info> socket_info_ptr;
 
+		void start(easy* easy_handle);
+		void record_result(easy* easy_handle, const asio::error_code& err);
+		void release_ticket(easy* easy_handle);
+
 		void add_handle(native::CURL* native_easy);
 		void remove_handle(native::CURL* native_easy);
 
@@ -66,6 +97,8 @@ namespace curl
 		void start_write_op(socket_info_ptr si);
 		void handle_socket_write(const asio::error_code& err, socket_info_ptr si);
 		void handle_timeout(const asio::error_code& err);
+		void schedule_deferred();
+		void handle_deferred(const asio::error_code& err);
 
 		typedef asio::ip::tcp::socket socket_type;
 		typedef std::map<socket_type::native_handle_type, socket_info_ptr> socket_map_type;
@@ -76,12 +109,35 @@ namespace curl
 		static int timer(native::CURLM* native_multi, long timeout_ms, void* userp);
 
 		typedef std::set<easy*> easy_set_type;
+		typedef std::multimap<std::chrono::steady_clock::time_point, easy*> deferred_map_type;
+		typedef std::map<easy*, deferred_map_type::iterator> deferred_index_type;
+
+		// Per-origin state a running transfer holds in the circuit breaker and the load balancer
+		struct ticket
+		{
+			std::string origin;
+			bool circuit_admitted;
+			bool circuit_probe;
+			std::string endpoint;
+		};
+
+		typedef std::map<easy*, ticket> ticket_map;
 
 		asio::io_service& io_service_;
 		initialization::ptr initref_;
 		native::CURLM* handle_;
 		easy_set_type easy_handles_;
 		asio::steady_timer timeout_;
+		deferred_map_type deferred_;
+		deferred_index_type deferred_index_;
+		asio::steady_timer deferred_timer_;
+		std::shared_ptr<circuit_breaker> circuit_breaker_;
+		ticket_map tickets_;
+		std::shared_ptr<rate_limiter> rate_limiter_;
+		easy_set_type rate_reserved_;
+		std::shared_ptr<bandwidth_shaper> bandwidth_shaper_;
+		std::shared_ptr<load_balancer> load_balancer_;
+		std::shared_ptr<buffer_pool> buffer_pool_;
 		int still_running_;
 	};
 }
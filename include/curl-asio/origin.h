@@ -0,0 +1,33 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Scheme, host and port of a URL, used to key per-origin state
+*/
+
+#pragma once
+
+#include "config.h"
+#include <string>
+
+namespace curl
+{
+	struct CURLASIO_API origin
+	{
+		origin();
+		explicit origin(const std::string& url);
+
+		// Returns "scheme://host:port", or an empty string if the URL could not be parsed
+		std::string str() const;
+
+		// Returns the host as used in CURLOPT_RESOLVE and CURLOPT_CONNECT_TO entries, with brackets for IPv6 addresses
+		std::string host_entry() const;
+
+		inline bool empty() const { return host.empty(); }
+
+		std::string scheme;
+		std::string host;
+		unsigned short port;
+	};
+}
@@ -0,0 +1,93 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Chain of stages processing the response of a transfer on the write path
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace curl
+{
+	class easy;
+
+	// Runs several consumers over one download from within libcurl's write callback, see easy::set_pipeline. Stages see each chunk of the response in order:
+	// - Taps read the chunk in place. All taps of one pipeline see the same buffer, so fanning out to several of them costs no copies.
+	// - Transforms (decoders, parsers) write their output to a buffer owned by the stage, which is what the stages after them see. Producing no output skips the rest of the chain for that chunk.
+	// - Branches are nested pipelines seeing the same buffer as the stage in front of them, which lets a transform affect some consumers only.
+	// Once a transfer succeeded, every stage is called one last time with an empty buffer, which is how transforms flush the output they held back and taps finalize (e.g. compute a digest). Output a transform flushes passes the stages behind it before they see the empty buffer. Stages never see an empty buffer before the end of the response.
+	// Returning false from a stage aborts the transfer with write_error. A stage which cannot keep up calls hold with its index; the chunk at hand still passes all stages, but the transfer pauses with CURL_WRITEFUNC_PAUSE before the next one until all held stages are released.
+	class CURLASIO_API pipeline:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::function<bool(asio::const_buffer data)> tap_type;
+		typedef std::function<bool(asio::const_buffer data, std::string& output)> transform_type;
+
+		struct stage_stats
+		{
+			std::string name;
+			std::uint64_t calls;
+			std::uint64_t bytes;
+			std::chrono::steady_clock::duration time;
+			std::size_t holds;
+		};
+
+		pipeline();
+		~pipeline();
+
+		// Each returns the index of the new stage
+		std::size_t add_tap(const std::string& name, tap_type tap);
+		std::size_t add_transform(const std::string& name, transform_type transform);
+		pipeline& add_branch(const std::string& name);
+
+		void hold(std::size_t stage);
+		void release(std::size_t stage);
+		inline bool is_held() const { return (root_->holds_ > 0); }
+
+		// Counters of all stages including those in branches, in chain order. The time of a transform or branch covers only its own work, not that of the stages behind it.
+		std::vector<stage_stats> get_stats() const;
+		void reset_stats();
+		inline std::size_t get_pauses() const { return pauses_; }
+
+	private:
+		friend class easy;
+
+		struct stage
+		{
+			enum kind_t { tap, transform, branch };
+
+			kind_t kind;
+			tap_type tap_function;
+			transform_type transform_function;
+			std::shared_ptr<pipeline> branch_pipeline;
+			std::string output;
+			bool held;
+			stage_stats stats;
+		};
+
+		stage& add_stage(stage::kind_t kind, const std::string& name);
+		void reset();
+		std::size_t deliver(easy* easy_handle, const char* data, std::size_t size);
+		bool run(asio::const_buffer data, std::size_t first = 0);
+		bool finish(std::size_t first = 0);
+		void collect_stats(std::vector<stage_stats>& stats) const;
+
+		pipeline* root_;
+		std::vector<stage> stages_;
+		std::size_t holds_;
+		easy* paused_;
+		std::size_t pauses_;
+	};
+}
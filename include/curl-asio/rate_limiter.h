@@ -0,0 +1,61 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Token-bucket request rate limits per origin or per user-supplied key
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio/detail/noncopyable.hpp>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace curl
+{
+	// Attached to a multi handle with multi::set_rate_limiter. Requests are keyed by easy::set_rate_limit_key, or by their origin if no key was set. A request which finds its bucket empty reserves the next token and is added to libcurl once the token becomes available.
+	class CURLASIO_API rate_limiter:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::chrono::steady_clock clock_type;
+
+		rate_limiter();
+
+		// Requests per second and burst size of keys without an explicit limit. A rate of zero (the default) disables the limit.
+		void set_default_limit(double rate, double burst);
+		void set_limit(const std::string& key, double rate, double burst);
+
+		// Takes a token from the key's bucket and returns the time until it is available
+		clock_type::duration reserve(const std::string& key);
+
+		// Returns a token taken by reserve for a request which never reached the network, e.g. because it was cancelled while waiting
+		void refund(const std::string& key);
+
+		inline std::size_t get_throttled() const { return throttled_; }
+
+	private:
+		struct bucket
+		{
+			bucket();
+
+			double rate;
+			double burst;
+			double tokens;
+			bool explicit_limit;
+			clock_type::time_point updated_at;
+		};
+
+		typedef std::map<std::string, bucket> bucket_map;
+
+		std::mutex mutex_;
+		bucket_map buckets_;
+		double default_rate_;
+		double default_burst_;
+		std::size_t throttled_;
+	};
+}
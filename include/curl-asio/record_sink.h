@@ -0,0 +1,83 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Splits streamed responses into NDJSON records or server-sent events
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace curl
+{
+	// Splits a response into records as it arrives, see easy::set_record_sink. Records which lie within one piece of the response are handed to the handler as views into libcurl's receive buffer; only those spanning two pieces, and events with several data lines, are assembled in a buffer of the sink. Views are valid during the call of the handler only. Returning false from the handler aborts the transfer with write_error, as does a record exceeding max_record_size.
+	// - ndjson: each non-empty line is a record, without its line break (LF or CRLF).
+	// - sse: events as specified for EventSource. Lines end with LF or CRLF; a lone CR is not taken for a line break.
+	class CURLASIO_API record_sink:
+		public asio::noncopyable
+	{
+	public:
+		enum format { ndjson, sse };
+
+		struct record
+		{
+			// NDJSON: the line. SSE: the data of the event, with the values of its data lines joined by LF.
+			asio::const_buffer data;
+
+			// SSE only: the type of the event, which is empty for the default type "message", and the last event ID at the time of the event
+			asio::const_buffer event;
+			asio::const_buffer id;
+		};
+
+		typedef std::function<bool(const record& r)> handler_type;
+
+		record_sink(format fmt, handler_type handler, std::size_t max_record_size = 1048576);
+		~record_sink();
+
+		// Feeds the next piece of the stream. Returns false if the handler asked to stop or a record is too large.
+		bool write(const char* data, std::size_t size);
+
+		// Ends the stream, which hands over a final NDJSON record lacking its line break and drops an incomplete event
+		bool finish();
+
+		// Drops partial records, as happens whenever a transfer starts. The last event ID and retry delay are kept, as EventSource does when it reconnects, whereas the ID of an incomplete event is dropped with it.
+		void reset();
+
+		// The ID to send in the Last-Event-ID header when reconnecting, which an id field only sets once the blank line ending its event arrived, and the reconnection delay requested by the server in milliseconds (-1 if none)
+		inline const std::string& get_last_event_id() const { return last_event_id_; }
+		inline long get_retry() const { return retry_; }
+
+		inline std::uint64_t get_records() const { return records_; }
+		inline std::uint64_t get_copied_records() const { return copied_records_; }
+
+	private:
+		bool end_line(const char* begin, const char* end);
+		bool handle_line(const char* line, std::size_t size, bool in_place);
+		bool handle_field(const char* line, std::size_t size, bool in_place);
+		bool dispatch(const asio::const_buffer& data, bool in_place);
+
+		format format_;
+		handler_type handler_;
+		std::size_t max_record_size_;
+		bool started_;
+		std::string carry_;
+		bool has_data_;
+		bool data_in_place_;
+		const char* data_view_;
+		std::size_t data_view_size_;
+		std::string data_;
+		std::string event_type_;
+		std::string last_event_id_;
+		std::string pending_event_id_;
+		long retry_;
+		std::uint64_t records_;
+		std::uint64_t copied_records_;
+	};
+}
@@ -0,0 +1,106 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Relays the body of a transfer to or from an asio stream with backpressure
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include "native.h"
+
+namespace curl
+{
+	class easy;
+	class upload_stream;
+
+	// Connects the body of a transfer to an asio stream such as a tcp::socket, as needed by a gateway forwarding upstream responses to its clients or client uploads to an upstream server. At most max_buffers buffers of buffer_size bytes are held per relay. Once they are all in flight, the side producing data waits: downloads are paused with CURL_WRITEFUNC_PAUSE until a socket write completes, and uploads stop reading from the socket until libcurl has taken a buffer.
+	// The handler runs once the transfer has finished and no operation on the stream is pending anymore. It receives the error of the stream if that failed first, in which case the transfer is cancelled, or else the result of the transfer. The relay and the stream must outlive the operation.
+	class CURLASIO_API relay:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::function<void(const asio::error_code& err)> handler_type;
+		typedef std::function<void(const asio::error_code& err, std::size_t bytes_transferred)> io_handler_type;
+
+		relay(easy& easy_handle, std::size_t buffer_size = 65536, std::size_t max_buffers = 4);
+		~relay();
+
+		// Performs the transfer and writes the response body to the stream. Replaces the sinks of the easy handle.
+		template <typename AsyncWriteStream>
+		void async_download(AsyncWriteStream& stream, handler_type handler)
+		{
+			start_download(std::bind(&relay::write_to<AsyncWriteStream>, std::ref(stream), std::placeholders::_1, std::placeholders::_2), handler);
+		}
+
+		// Performs the transfer and sends what is read from the stream as the request body. Bodies of a known size end after size bytes, and nothing beyond them is read from the stream; others end once the stream reports eof. Select the method with set_post or set_upload first; bodies of unknown size (-1) are sent with chunked transfer encoding.
+		template <typename AsyncReadStream>
+		void async_upload(AsyncReadStream& stream, native::curl_off_t size, handler_type handler)
+		{
+			start_upload(std::bind(&relay::read_from<AsyncReadStream>, std::ref(stream), std::placeholders::_1, std::placeholders::_2), size, handler);
+		}
+
+		inline native::curl_off_t get_bytes_relayed() const { return bytes_relayed_; }
+		inline std::size_t get_pauses() const { return pauses_; }
+
+	private:
+		typedef std::function<void(asio::const_buffer buffer, io_handler_type handler)> stream_writer_type;
+		typedef std::function<void(asio::mutable_buffer buffer, io_handler_type handler)> stream_reader_type;
+
+		template <typename AsyncWriteStream>
+		static void write_to(AsyncWriteStream& stream, asio::const_buffer buffer, io_handler_type handler)
+		{
+			asio::async_write(stream, asio::const_buffers_1(buffer), handler);
+		}
+
+		template <typename AsyncReadStream>
+		static void read_from(AsyncReadStream& stream, asio::mutable_buffer buffer, io_handler_type handler)
+		{
+			stream.async_read_some(asio::mutable_buffers_1(buffer), handler);
+		}
+
+		void start(handler_type handler);
+		void start_download(stream_writer_type writer, handler_type handler);
+		std::size_t deliver(asio::const_buffer data);
+		void write_next();
+		void handle_write(const asio::error_code& err, std::size_t size);
+		void start_upload(stream_reader_type reader, native::curl_off_t size, handler_type handler);
+		void read_next();
+		void handle_read(const asio::error_code& err, std::size_t size);
+		void send_next();
+		void handle_send(const asio::error_code& err, std::size_t size);
+		void handle_transfer(const asio::error_code& err);
+		void fail(const asio::error_code& err);
+		void recycle();
+		void check_completion();
+
+		easy& easy_;
+		upload_stream* upload_;
+		std::size_t buffer_size_;
+		std::size_t max_buffers_;
+		stream_writer_type writer_;
+		stream_reader_type reader_;
+		handler_type handler_;
+		std::deque<std::string> queue_;
+		std::vector<std::string> spare_;
+		std::string reading_;
+		bool stream_busy_;
+		bool curl_busy_;
+		bool paused_;
+		bool eof_;
+		bool transfer_done_;
+		native::curl_off_t upload_size_;
+		asio::error_code stream_error_;
+		asio::error_code transfer_error_;
+		native::curl_off_t bytes_relayed_;
+		std::size_t pauses_;
+	};
+}
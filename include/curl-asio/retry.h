@@ -0,0 +1,76 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Retries of transient failures with decorrelated jitter and a per-origin retry budget
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio/detail/noncopyable.hpp>
+#include <asio/error_code.hpp>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include "error_code.h"
+
+namespace curl
+{
+	// Shared by all requests which should be retried. A failed attempt is only retried if none of its response data reached the sink, and if the request body is held in memory (post fields or forms) rather than read from a source stream.
+	class CURLASIO_API retry_policy:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::chrono::steady_clock clock_type;
+
+		retry_policy();
+
+		// Total number of attempts per request, including the first one (default: 3)
+		void set_max_attempts(unsigned int max_attempts);
+		inline unsigned int get_max_attempts() const { return max_attempts_; }
+
+		// Delays are drawn from [base, 3 * previous delay] and capped (default: 100ms and 10s)
+		void set_backoff(clock_type::duration base, clock_type::duration cap);
+
+		// Each retry costs one token of the origin's bucket, and each successful request refills it by the given ratio (default: 0.1 and 10 tokens)
+		void set_retry_budget(double refill_ratio, double max_tokens);
+
+		// Transient errors default to could_not_connect, operation_timedout, got_nothing, send_error and recv_error; status codes to 502, 503 and 504
+		void add_retryable_error(errc::easy::easy_error_codes code);
+		void add_retryable_status(long response_code);
+		void clear_retryable_errors();
+		void clear_retryable_statuses();
+
+		bool is_retryable(const asio::error_code& err, long response_code) const;
+		bool is_retryable_status(long response_code) const;
+
+		clock_type::duration next_delay(clock_type::duration previous_delay);
+		bool acquire_retry(const std::string& origin);
+
+		// Returns the token of a retry which was acquired but not sent after all
+		void release_retry(const std::string& origin);
+		void record_success(const std::string& origin);
+
+		inline std::size_t get_retries_sent() const { return retries_sent_; }
+
+	private:
+		typedef std::map<std::string, double> bucket_map;
+
+		mutable std::mutex mutex_;
+		std::set<int> retryable_errors_;
+		std::set<long> retryable_statuses_;
+		unsigned int max_attempts_;
+		clock_type::duration base_delay_;
+		clock_type::duration max_delay_;
+		double refill_ratio_;
+		double max_tokens_;
+		bucket_map buckets_;
+		std::mt19937 random_;
+		std::size_t retries_sent_;
+	};
+}
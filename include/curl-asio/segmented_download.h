@@ -0,0 +1,109 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Downloads an object in ranges over several connections into a memory-mapped file
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "easy.h"
+
+namespace curl
+{
+	class download_journal;
+	class multi;
+
+	// Splits an object into ranges which are fetched concurrently, each written straight into a preallocated and memory-mapped output file at its offset. The size comes from a HEAD request unless set beforehand; servers not advertising Accept-Ranges get a single plain request. A connection which runs out of work takes over the second half of the segment with the most bytes left, so slow connections and mirrors end up with less of the object. Each connection keeps its easy handle, and with it its connection, for all the segments it fetches. Not available on Windows yet, where the download fails with operation_not_supported.
+	class CURLASIO_API segmented_download:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::function<void(const asio::error_code& err)> handler_type;
+
+		struct segment_info
+		{
+			std::uint64_t begin;
+			std::uint64_t position;
+			std::uint64_t end;
+			bool active;
+		};
+
+		segmented_download(multi& multi_handle);
+		~segmented_download();
+
+		// Options set on the prototype, such as headers, timeouts or TLS settings, apply to every request. Its URL, range and sink are set per request.
+		inline easy& get_prototype() { return *prototype_; }
+
+		// URLs of the object; more than one spreads the connections over mirrors. A failed segment is resumed from the next mirror.
+		void add_url(const std::string& url);
+
+		// Number of concurrent connections (default: 4)
+		void set_connections(std::size_t connections);
+
+		// Segments are neither created nor split below this size (default: 1MB)
+		void set_min_segment_size(std::uint64_t size);
+
+		// Requests per segment before the download fails (default: 3)
+		void set_max_attempts(std::size_t attempts);
+
+		// Size of the object, which skips the HEAD request and presumes the servers accept ranges
+		void set_size(std::uint64_t size);
+
+		// Resumes from and records progress in the journal, see download_journal.h. A journal describing the same object, by size, ETag and Last-Modified, limits the download to the ranges it lacks; otherwise it starts over. Range requests carry If-Range with the strong ETag or Last-Modified, and a server answering with the whole object fails the download with errc::wrapper::resource_changed and discards the journal. The journal is deleted once the download is complete, and saved when it fails or is cancelled; the handler runs once it is on disk. Sizes given with set_size come without validators, so their journals are trusted by size alone.
+		void set_journal(std::shared_ptr<download_journal> journal);
+
+		// Creates the file if needed and sizes it to the object. Existing contents are kept for resuming.
+		void async_download(const std::string& path, handler_type handler);
+		void cancel();
+
+		std::uint64_t get_size() const;
+		std::uint64_t get_bytes_received() const;
+		std::uint64_t get_bytes_resumed() const;
+		std::size_t get_splits() const;
+		std::vector<segment_info> get_segments() const;
+
+	private:
+		struct operation;
+		typedef std::shared_ptr<operation> operation_ptr;
+		struct checkpoint_worker;
+
+		static void handle_head(operation_ptr op, const asio::error_code& err);
+		static void start(operation_ptr op);
+		static void schedule(operation_ptr op);
+		static std::size_t next_segment(operation* op);
+		static void start_transfer(operation_ptr op, std::size_t connection, std::size_t segment);
+		static std::size_t write_segment(operation* op, std::size_t connection, const asio::const_buffer& data);
+		static void handle_transfer(operation_ptr op, std::size_t connection, const asio::error_code& err);
+		static void handle_checkpoint(operation_ptr op, const asio::error_code& err);
+		static void checkpoint(operation_ptr op);
+		static void save_checkpoint(asio::io_service& io_service, int file, std::shared_ptr<download_journal> journal, std::function<void()>& done);
+		static void handle_checkpoint_saved(operation_ptr op, std::shared_ptr<asio::io_service::work> work);
+		static void complete(operation_ptr op, const asio::error_code& err);
+		static void finish(operation_ptr op);
+
+		multi& multi_;
+		std::shared_ptr<easy> prototype_;
+		std::vector<std::string> urls_;
+		std::vector<std::shared_ptr<easy> > handles_;
+		std::size_t connections_;
+		std::uint64_t min_segment_size_;
+		std::size_t max_attempts_;
+		std::uint64_t size_;
+		bool size_set_;
+		std::shared_ptr<download_journal> journal_;
+		operation_ptr operation_;
+
+		// Thread saving the checkpoints of journaled downloads. Operations share it, so that one which completes after this object is gone can still save its journal.
+		std::shared_ptr<checkpoint_worker> checkpoint_worker_;
+	};
+}
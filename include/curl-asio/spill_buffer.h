@@ -0,0 +1,63 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Response body kept in memory up to a threshold and in a memory-mapped temporary file beyond it
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <cstddef>
+#include <string>
+
+namespace curl
+{
+	// Sink for responses of unknown size, attached with easy::set_spill_sink. Small bodies stay in memory. Once a body outgrows the threshold, or announces a larger Content-Length, it moves to an unlinked temporary file which is extended ahead of the writes and mapped into memory, so the data is exposed as one contiguous view either way.
+	// The file is only ever written through the mapping, and disappears when the buffer is cleared or destroyed. Platforms without mmap keep the whole body in memory.
+	class CURLASIO_API spill_buffer:
+		public asio::noncopyable
+	{
+	public:
+		explicit spill_buffer(std::size_t threshold = 1024 * 1024);
+		~spill_buffer();
+
+		// Directory of the temporary file (default: TMPDIR, or /tmp)
+		void set_temp_directory(const std::string& path);
+		inline std::size_t get_threshold() const { return threshold_; }
+
+		// Prepares for a body of the given size, spilling right away if it exceeds the threshold
+		void reserve(std::size_t size);
+		void reserve(std::size_t size, asio::error_code& ec);
+
+		void append(const char* data, std::size_t size);
+		void append(const char* data, std::size_t size, asio::error_code& ec);
+
+		// Releases the body, and the temporary file along with it
+		void clear();
+
+		inline bool is_spilled() const { return (mapping_ != 0); }
+		inline std::size_t size() const { return size_; }
+		inline asio::const_buffer data() const { return asio::const_buffer(is_spilled() ? mapping_ : memory_.data(), size_); }
+
+		// Error which made the sink abort the transfer with write_error
+		inline const asio::error_code& get_error() const { return error_; }
+
+	private:
+		void spill(std::size_t capacity, asio::error_code& ec);
+		void extend(std::size_t capacity, asio::error_code& ec);
+		void unmap();
+
+		std::size_t threshold_;
+		std::string temp_directory_;
+		std::string memory_;
+		std::size_t size_;
+		int file_;
+		char* mapping_;
+		std::size_t mapping_size_;
+		asio::error_code error_;
+	};
+}
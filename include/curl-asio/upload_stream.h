@@ -0,0 +1,74 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Request body of a transfer exposed as an asio AsyncWriteStream
+*/
+
+#pragma once
+
+#include "config.h"
+#include <asio.hpp>
+#include <asio/detail/noncopyable.hpp>
+#include <functional>
+
+namespace curl
+{
+	class easy;
+
+	// Returned by easy::upload_stream. Writes are satisfied from within libcurl's read callback, which copies straight from the written buffer; while no write is pending, the transfer is paused with CURL_READFUNC_PAUSE and resumed by the next write. Call close once the body is complete.
+	// Writes complete with asio::error::broken_pipe once the transfer has finished, or with the transfer's error if it failed. As with any stream, only one write may be pending at a time. The body cannot be replayed, so requests with an upload stream are never retried.
+	class CURLASIO_API upload_stream:
+		public asio::noncopyable
+	{
+	public:
+		typedef std::function<void(const asio::error_code& err, std::size_t bytes_transferred)> write_handler_type;
+
+		upload_stream(asio::io_service& io_service);
+		~upload_stream();
+
+		inline asio::io_service& get_io_service() { return io_service_; }
+
+		template <typename ConstBufferSequence, typename WriteHandler>
+		void async_write_some(const ConstBufferSequence& buffers, WriteHandler handler)
+		{
+			asio::const_buffer buffer;
+
+			for (typename ConstBufferSequence::const_iterator it = buffers.begin(); it != buffers.end(); ++it)
+			{
+				if (asio::buffer_size(*it) > 0)
+				{
+					buffer = *it;
+					break;
+				}
+			}
+
+			start_write(buffer, write_handler_type(handler));
+		}
+
+		// Ends the body after the data written so far
+		void close();
+
+		inline std::size_t get_bytes_sent() const { return bytes_sent_; }
+
+	private:
+		friend class easy;
+
+		void start_write(asio::const_buffer buffer, write_handler_type handler);
+		void reset();
+		std::size_t read(easy* easy_handle, char* data, std::size_t size);
+		void finish(const asio::error_code& err);
+		void complete_write(const asio::error_code& err, std::size_t size);
+		void resume();
+
+		asio::io_service& io_service_;
+		asio::const_buffer write_buffer_;
+		write_handler_type write_handler_;
+		std::size_t bytes_sent_;
+		easy* paused_;
+		bool closed_;
+		bool finished_;
+		asio::error_code error_;
+	};
+}
@@ -0,0 +1,357 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Aggregate bandwidth caps across the transfers of a multi handle
+*/
+
+#include <curl-asio/bandwidth_shaper.h>
+#include <curl-asio/easy.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace curl;
+
+static const double unlimited = std::numeric_limits<double>::infinity();
+
+// Time span over which the achieved rates are averaged
+static const double rate_window_seconds = 1.0;
+
+static double budget_for(double bytes_per_second, double seconds)
+{
+	return (bytes_per_second > 0.0) ? bytes_per_second * seconds : unlimited;
+}
+
+bandwidth_shaper::lane::lane():
+	credit(0.0),
+	bytes(0.0),
+	paused(false),
+	demand(false)
+{
+}
+
+bandwidth_shaper::traffic_class::traffic_class():
+	transfers(0)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		limits[i] = 0.0;
+		rates[i] = 0.0;
+		bytes[i] = 0.0;
+		weights[i] = 0.0;
+		budgets[i] = 0.0;
+	}
+}
+
+bandwidth_shaper::bandwidth_shaper(asio::io_service& io_service):
+	timer_(io_service),
+	interval_(std::chrono::milliseconds(10)),
+	ticking_(false)
+{
+	limits_[recv] = limits_[send] = 0.0;
+	rates_[recv] = rates_[send] = 0.0;
+}
+
+bandwidth_shaper::~bandwidth_shaper()
+{
+}
+
+void bandwidth_shaper::set_rate(direction_t direction, double bytes_per_second)
+{
+	limits_[direction] = std::max(bytes_per_second, 0.0);
+}
+
+void bandwidth_shaper::set_class_rate(const std::string& class_key, direction_t direction, double bytes_per_second)
+{
+	classes_[class_key].limits[direction] = std::max(bytes_per_second, 0.0);
+}
+
+void bandwidth_shaper::set_interval(clock_type::duration interval)
+{
+	interval_ = interval;
+}
+
+double bandwidth_shaper::get_rate(direction_t direction) const
+{
+	return rates_[direction] * idle_decay();
+}
+
+double bandwidth_shaper::get_class_rate(const std::string& class_key, direction_t direction) const
+{
+	class_map::const_iterator it = classes_.find(class_key);
+	return (it != classes_.end()) ? it->second.rates[direction] * idle_decay() : 0.0;
+}
+
+double bandwidth_shaper::idle_decay() const
+{
+	if (ticking_)
+	{
+		return 1.0;
+	}
+
+	// The timer stops while there are no transfers, so the averages are decayed on the fly instead
+	double idle = std::chrono::duration<double>(clock_type::now() - last_tick_).count();
+	return std::exp(-idle / rate_window_seconds);
+}
+
+void bandwidth_shaper::add(easy* easy_handle, const std::string& class_key, unsigned int weight)
+{
+	transfer& t = transfers_[easy_handle];
+	t.class_key = class_key;
+	t.weight = std::max(weight, 1u);
+	++classes_[class_key].transfers;
+
+	if (!ticking_)
+	{
+		ticking_ = true;
+		last_tick_ = clock_type::now();
+		schedule();
+	}
+}
+
+void bandwidth_shaper::remove(easy* easy_handle)
+{
+	transfer_map::iterator it = transfers_.find(easy_handle);
+
+	if (it != transfers_.end())
+	{
+		traffic_class& c = classes_[it->second.class_key];
+		c.bytes[recv] += it->second.lanes[recv].bytes;
+		c.bytes[send] += it->second.lanes[send].bytes;
+		--c.transfers;
+		transfers_.erase(it);
+	}
+}
+
+bool bandwidth_shaper::acquire(easy* easy_handle, direction_t direction)
+{
+	transfer_map::iterator it = transfers_.find(easy_handle);
+
+	if (it == transfers_.end())
+	{
+		return true;
+	}
+
+	lane& l = it->second.lanes[direction];
+	l.demand = true;
+
+	if (l.credit < 0.0)
+	{
+		l.paused = true;
+		return false;
+	}
+
+	return true;
+}
+
+void bandwidth_shaper::charge(easy* easy_handle, direction_t direction, std::size_t bytes)
+{
+	transfer_map::iterator it = transfers_.find(easy_handle);
+
+	if (it != transfers_.end())
+	{
+		// The credit may go negative, in which case the transfer is paused at its next callback until the debt has been paid off
+		lane& l = it->second.lanes[direction];
+		l.credit -= static_cast<double>(bytes);
+		l.bytes += static_cast<double>(bytes);
+	}
+}
+
+void bandwidth_shaper::schedule()
+{
+	timer_.expires_from_now(interval_);
+	timer_.async_wait(std::bind(&bandwidth_shaper::handle_tick, shared_from_this(), std::placeholders::_1));
+}
+
+void bandwidth_shaper::handle_tick(const asio::error_code& err)
+{
+	if (err)
+	{
+		ticking_ = false;
+		return;
+	}
+
+	clock_type::time_point now = clock_type::now();
+	double seconds = std::chrono::duration<double>(now - last_tick_).count();
+	last_tick_ = now;
+
+	if (seconds > 0.0)
+	{
+		refill(recv, seconds);
+		refill(send, seconds);
+	}
+
+	// Resuming a transfer may invoke its callbacks right away, which is why this happens after all credits have been updated
+	std::vector<easy*> resumable;
+
+	for (transfer_map::iterator it = transfers_.begin(); it != transfers_.end(); ++it)
+	{
+		const transfer& t = it->second;
+
+		if ((t.lanes[recv].paused && t.lanes[recv].credit >= 0.0) || (t.lanes[send].paused && t.lanes[send].credit >= 0.0))
+		{
+			resumable.push_back(it->first);
+		}
+	}
+
+	for (std::vector<easy*>::iterator it = resumable.begin(); it != resumable.end(); ++it)
+	{
+		transfer_map::iterator t = transfers_.find(*it);
+
+		if (t != transfers_.end())
+		{
+			resume(*it, t->second);
+		}
+	}
+
+	if (transfers_.empty())
+	{
+		ticking_ = false;
+	}
+	else
+	{
+		schedule();
+	}
+}
+
+void bandwidth_shaper::refill(direction_t direction, double seconds)
+{
+	double alpha = std::min(seconds / rate_window_seconds, 1.0);
+	double total_bytes = 0.0;
+
+	for (class_map::iterator it = classes_.begin(); it != classes_.end(); ++it)
+	{
+		it->second.weights[direction] = 0.0;
+		it->second.budgets[direction] = 0.0;
+	}
+
+	// Only transfers which asked for credit since the last tick take part in the distribution
+	for (transfer_map::iterator it = transfers_.begin(); it != transfers_.end(); ++it)
+	{
+		lane& l = it->second.lanes[direction];
+		traffic_class& c = classes_[it->second.class_key];
+		c.bytes[direction] += l.bytes;
+		l.bytes = 0.0;
+
+		if (l.paused || l.demand)
+		{
+			c.weights[direction] += it->second.weight;
+		}
+	}
+
+	// Split the total budget among the classes by weight. Classes hitting their own limit get exactly that, and the rest is split again among the others.
+	std::vector<traffic_class*> active;
+
+	for (class_map::iterator it = classes_.begin(); it != classes_.end(); ++it)
+	{
+		if (it->second.weights[direction] > 0.0)
+		{
+			active.push_back(&it->second);
+		}
+	}
+
+	double remaining = budget_for(limits_[direction], seconds);
+
+	while (!active.empty())
+	{
+		double total_weight = 0.0;
+
+		for (std::vector<traffic_class*>::iterator it = active.begin(); it != active.end(); ++it)
+		{
+			total_weight += (*it)->weights[direction];
+		}
+
+		bool capped = false;
+
+		for (std::vector<traffic_class*>::iterator it = active.begin(); it != active.end();)
+		{
+			double share = remaining * (*it)->weights[direction] / total_weight;
+			double cap = budget_for((*it)->limits[direction], seconds);
+
+			if (cap < share)
+			{
+				(*it)->budgets[direction] = cap;
+				remaining -= cap;
+				it = active.erase(it);
+				capped = true;
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		if (!capped)
+		{
+			for (std::vector<traffic_class*>::iterator it = active.begin(); it != active.end(); ++it)
+			{
+				(*it)->budgets[direction] = remaining * (*it)->weights[direction] / total_weight;
+			}
+
+			break;
+		}
+	}
+
+	for (transfer_map::iterator it = transfers_.begin(); it != transfers_.end(); ++it)
+	{
+		lane& l = it->second.lanes[direction];
+
+		if (l.paused || l.demand)
+		{
+			const traffic_class& c = classes_[it->second.class_key];
+			double allotment = c.budgets[direction] * it->second.weight / c.weights[direction];
+
+			// Unused credit is capped to two ticks worth, which bounds the burst after an idle period
+			l.credit = std::min(l.credit + allotment, 2.0 * allotment);
+		}
+		else
+		{
+			// Idle transfers keep their debt, but do not hoard credit
+			l.credit = std::min(l.credit, 0.0);
+		}
+
+		l.demand = false;
+	}
+
+	for (class_map::iterator it = classes_.begin(); it != classes_.end();)
+	{
+		traffic_class& c = it->second;
+		c.rates[direction] += alpha * (c.bytes[direction] / seconds - c.rates[direction]);
+		total_bytes += c.bytes[direction];
+		c.bytes[direction] = 0.0;
+
+		if (c.transfers == 0 && c.limits[recv] == 0.0 && c.limits[send] == 0.0 && c.rates[recv] < 1.0 && c.rates[send] < 1.0)
+		{
+			classes_.erase(it++);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	rates_[direction] += alpha * (total_bytes / seconds - rates_[direction]);
+}
+
+void bandwidth_shaper::resume(easy* easy_handle, transfer& t)
+{
+	int released = 0;
+
+	for (int direction = recv; direction <= send; ++direction)
+	{
+		lane& l = t.lanes[direction];
+
+		if (l.paused && l.credit >= 0.0)
+		{
+			l.paused = false;
+			released |= (direction == recv) ? easy::pause_recv : easy::pause_send;
+		}
+	}
+
+	// A direction other holders pause stays paused. Errors are ignored; the transfer fails on its own if libcurl cannot resume it.
+	asio::error_code ec;
+	easy_handle->release_pause(released, easy::pause_by_shaper, ec);
+}
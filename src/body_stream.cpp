@@ -0,0 +1,122 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Response body of a transfer exposed as an asio AsyncReadStream
+*/
+
+#include <curl-asio/body_stream.h>
+#include <curl-asio/easy.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace curl;
+
+body_stream::body_stream(asio::io_service& io_service):
+	io_service_(io_service),
+	buffered_offset_(0),
+	peak_buffered_(0),
+	paused_(0),
+	finished_(false)
+{
+}
+
+body_stream::~body_stream()
+{
+}
+
+void body_stream::start_read(asio::mutable_buffer buffer, read_handler_type handler)
+{
+	std::size_t size = asio::buffer_size(buffer);
+
+	if (size == 0)
+	{
+		io_service_.post(std::bind(handler, asio::error_code(), 0));
+		return;
+	}
+
+	if (buffered_offset_ < buffered_.size())
+	{
+		std::size_t n = std::min(size, buffered_.size() - buffered_offset_);
+		std::memcpy(asio::buffer_cast<char*>(buffer), buffered_.data() + buffered_offset_, n);
+		buffered_offset_ += n;
+
+		if (buffered_offset_ == buffered_.size())
+		{
+			buffered_.clear();
+			buffered_offset_ = 0;
+		}
+
+		io_service_.post(std::bind(handler, asio::error_code(), n));
+		return;
+	}
+
+	if (finished_)
+	{
+		io_service_.post(std::bind(handler, error_ ? error_ : asio::error_code(asio::error::eof), 0));
+		return;
+	}
+
+	read_buffer_ = buffer;
+	read_handler_ = handler;
+
+	if (paused_)
+	{
+		// libcurl might deliver the data it held back from within curl_easy_pause, which completes the read right away
+		easy* easy_handle = paused_;
+		paused_ = 0;
+
+		asio::error_code ec;
+		easy_handle->release_pause(easy::pause_recv, easy::pause_by_sink, ec);
+	}
+}
+
+void body_stream::reset()
+{
+	read_handler_ = read_handler_type();
+	buffered_.clear();
+	buffered_offset_ = 0;
+	peak_buffered_ = 0;
+	paused_ = 0;
+	finished_ = false;
+	error_ = asio::error_code();
+}
+
+std::size_t body_stream::deliver(easy* easy_handle, const char* data, std::size_t size)
+{
+	if (!read_handler_)
+	{
+		paused_ = easy_handle;
+		return easy::sink_pause;
+	}
+
+	// The write callback must take all of the data or none of it, so whatever does not fit into the read buffer is kept for the next read
+	std::size_t n = std::min(size, asio::buffer_size(read_buffer_));
+	std::memcpy(asio::buffer_cast<char*>(read_buffer_), data, n);
+	buffered_.append(data + n, size - n);
+	peak_buffered_ = std::max(peak_buffered_, buffered_.size());
+
+	complete_read(asio::error_code(), n);
+	return size;
+}
+
+void body_stream::finish(const asio::error_code& err)
+{
+	finished_ = true;
+	error_ = err;
+	paused_ = 0;
+
+	if (read_handler_)
+	{
+		complete_read(err ? err : asio::error_code(asio::error::eof), 0);
+	}
+}
+
+void body_stream::complete_read(const asio::error_code& err, std::size_t size)
+{
+	read_handler_type handler;
+	handler.swap(read_handler_);
+	read_buffer_ = asio::mutable_buffer();
+	io_service_.post(std::bind(handler, err, size));
+}
@@ -0,0 +1,298 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Pool of fixed-size slabs and bodies made of chains of slabs
+*/
+
+#include <curl-asio/buffer_pool.h>
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+using namespace curl;
+
+// Arenas span at least one huge page, so that a huge page is never shared between arenas
+static const std::size_t arena_size = 2 * 1024 * 1024;
+
+struct buffer_pool::slab
+{
+	buffer_pool* pool;
+	char* data;
+	std::atomic<std::size_t> refs;
+	slab* next_free;
+};
+
+static char* map_arena(std::size_t size, bool huge_pages, bool& mapped)
+{
+#if !defined(_WIN32)
+	if (huge_pages)
+	{
+		void* memory = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+		memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+		// No huge pages have been reserved by the administrator, so ask for transparent huge pages instead
+		if (memory == MAP_FAILED)
+		{
+			memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+#if defined(MADV_HUGEPAGE)
+			if (memory != MAP_FAILED)
+			{
+				madvise(memory, size, MADV_HUGEPAGE);
+			}
+#endif
+		}
+
+		if (memory != MAP_FAILED)
+		{
+			mapped = true;
+			return static_cast<char*>(memory);
+		}
+	}
+#endif
+
+	mapped = false;
+	return static_cast<char*>(::operator new(size));
+}
+
+static void unmap_arena(char* memory, std::size_t size, bool mapped)
+{
+#if !defined(_WIN32)
+	if (mapped)
+	{
+		munmap(memory, size);
+		return;
+	}
+#endif
+
+	::operator delete(memory);
+}
+
+buffer_pool::buffer_pool(std::size_t slab_size, bool huge_pages):
+	slab_size_(std::max<std::size_t>(slab_size, 1)),
+	huge_pages_(huge_pages),
+	free_list_(0),
+	slabs_allocated_(0),
+	slabs_in_use_(0)
+{
+}
+
+buffer_pool::~buffer_pool()
+{
+	for (std::vector<arena>::iterator it = arenas_.begin(); it != arenas_.end(); ++it)
+	{
+		unmap_arena(it->memory, it->size, it->mapped);
+		delete[] it->slabs;
+	}
+}
+
+slab_ref buffer_pool::acquire()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (!free_list_)
+	{
+		grow();
+	}
+
+	slab* s = free_list_;
+	free_list_ = s->next_free;
+	s->next_free = 0;
+	s->refs = 0;
+	++slabs_in_use_;
+
+	return slab_ref(s);
+}
+
+std::size_t buffer_pool::get_slabs_allocated() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return slabs_allocated_;
+}
+
+std::size_t buffer_pool::get_slabs_in_use() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return slabs_in_use_;
+}
+
+void buffer_pool::grow()
+{
+	std::size_t size = std::max(arena_size, slab_size_);
+	std::size_t count = size / slab_size_;
+	size = count * slab_size_;
+
+	if (huge_pages_)
+	{
+		size = (size + arena_size - 1) / arena_size * arena_size;
+	}
+
+	arena a;
+	a.size = size;
+	a.memory = map_arena(size, huge_pages_, a.mapped);
+	a.slabs = new slab[count];
+
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		slab& s = a.slabs[i];
+		s.pool = this;
+		s.data = a.memory + i * slab_size_;
+		s.refs = 0;
+		s.next_free = (i + 1 < count) ? &a.slabs[i + 1] : free_list_;
+	}
+
+	free_list_ = &a.slabs[0];
+	slabs_allocated_ += count;
+	arenas_.push_back(a);
+}
+
+void buffer_pool::release(slab* s)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	s->next_free = free_list_;
+	free_list_ = s;
+	--slabs_in_use_;
+}
+
+slab_ref::slab_ref():
+	slab_(0)
+{
+}
+
+slab_ref::slab_ref(buffer_pool::slab* s):
+	slab_(s)
+{
+	++slab_->refs;
+}
+
+slab_ref::slab_ref(const slab_ref& other):
+	slab_(other.slab_)
+{
+	if (slab_)
+	{
+		++slab_->refs;
+	}
+}
+
+slab_ref::slab_ref(slab_ref&& other):
+	slab_(other.slab_)
+{
+	other.slab_ = 0;
+}
+
+slab_ref::~slab_ref()
+{
+	if (slab_ && --slab_->refs == 0)
+	{
+		slab_->pool->release(slab_);
+	}
+}
+
+slab_ref& slab_ref::operator=(slab_ref other)
+{
+	std::swap(slab_, other.slab_);
+	return *this;
+}
+
+char* slab_ref::data() const
+{
+	return slab_->data;
+}
+
+std::size_t slab_ref::capacity() const
+{
+	return slab_->pool->slab_size_;
+}
+
+bool slab_ref::unique() const
+{
+	return (slab_ && slab_->refs == 1);
+}
+
+chunk_chain::chunk_chain():
+	size_(0)
+{
+}
+
+chunk_chain::chunk_chain(std::shared_ptr<buffer_pool> pool):
+	pool_(pool),
+	size_(0)
+{
+}
+
+void chunk_chain::append(const char* data, std::size_t size)
+{
+	while (size > 0)
+	{
+		// Copies of the chain share the last slab, and might append to it themselves
+		if (segments_.empty() || segments_.back().end == segments_.back().slab.capacity() || !segments_.back().slab.unique())
+		{
+			if (!pool_)
+			{
+				pool_ = std::make_shared<buffer_pool>();
+			}
+
+			segment s;
+			s.slab = pool_->acquire();
+			s.begin = 0;
+			s.end = 0;
+			segments_.push_back(std::move(s));
+		}
+
+		segment& tail = segments_.back();
+		std::size_t n = std::min(size, tail.slab.capacity() - tail.end);
+		std::memcpy(tail.slab.data() + tail.end, data, n);
+		tail.end += n;
+		size_ += n;
+		data += n;
+		size -= n;
+	}
+}
+
+void chunk_chain::consume(std::size_t size)
+{
+	segment_list::iterator it = segments_.begin();
+
+	while (it != segments_.end() && size >= it->end - it->begin)
+	{
+		size -= it->end - it->begin;
+		size_ -= it->end - it->begin;
+		++it;
+	}
+
+	segments_.erase(segments_.begin(), it);
+
+	if (!segments_.empty())
+	{
+		segments_.front().begin += size;
+		size_ -= size;
+	}
+}
+
+void chunk_chain::clear()
+{
+	segments_.clear();
+	size_ = 0;
+}
+
+std::string chunk_chain::str() const
+{
+	std::string result;
+	result.reserve(size_);
+
+	for (segment_list::const_iterator it = segments_.begin(); it != segments_.end(); ++it)
+	{
+		result.append(it->slab.data() + it->begin, it->end - it->begin);
+	}
+
+	return result;
+}
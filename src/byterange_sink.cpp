@@ -0,0 +1,467 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Incremental parser for multipart/byteranges responses
+*/
+
+#include <curl-asio/byterange_sink.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace curl;
+
+const std::uint64_t byterange_sink::unknown_length;
+
+// Delimiter and header lines longer than this are taken for a malformed body
+static const std::size_t max_line = 8192;
+
+static std::string trim(const std::string& str)
+{
+	std::size_t begin = str.find_first_not_of(" \t\r\n");
+
+	if (begin == std::string::npos)
+	{
+		return std::string();
+	}
+
+	return str.substr(begin, str.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+static std::string to_lower(std::string str)
+{
+	std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+	return str;
+}
+
+static bool parse_number(const std::string& str, std::uint64_t& value)
+{
+	if (str.empty() || str.size() > 19 || str.find_first_not_of("0123456789") != std::string::npos)
+	{
+		return false;
+	}
+
+	value = 0;
+
+	for (std::size_t i = 0; i < str.size(); ++i)
+	{
+		value = value * 10 + (str[i] - '0');
+	}
+
+	return true;
+}
+
+// Parses "bytes first-last/length", where length may be "*"
+static bool parse_content_range(const std::string& value, byterange_sink::part& p)
+{
+	std::string range = to_lower(trim(value));
+
+	if (range.compare(0, 6, "bytes ") != 0)
+	{
+		return false;
+	}
+
+	std::size_t dash = range.find('-', 6);
+	std::size_t slash = range.find('/', 6);
+
+	if (dash == std::string::npos || slash == std::string::npos || slash < dash)
+	{
+		return false;
+	}
+
+	if (!parse_number(trim(range.substr(6, dash - 6)), p.first) || !parse_number(range.substr(dash + 1, slash - dash - 1), p.last) || p.last < p.first)
+	{
+		return false;
+	}
+
+	std::string length = range.substr(slash + 1);
+
+	if (length == "*")
+	{
+		p.length = byterange_sink::unknown_length;
+		return true;
+	}
+
+	return parse_number(length, p.length) && p.length > p.last;
+}
+
+// Returns the boundary parameter of a media type, unquoted
+static std::string boundary_of(const std::string& content_type)
+{
+	std::size_t pos = content_type.find(';');
+
+	while (pos != std::string::npos)
+	{
+		std::size_t next = content_type.find(';', pos + 1);
+		std::string parameter = content_type.substr(pos + 1, next == std::string::npos ? std::string::npos : next - pos - 1);
+		std::size_t equals = parameter.find('=');
+
+		if (equals != std::string::npos && to_lower(trim(parameter.substr(0, equals))) == "boundary")
+		{
+			std::string value = trim(parameter.substr(equals + 1));
+
+			if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"')
+			{
+				value = value.substr(1, value.size() - 2);
+			}
+
+			return value;
+		}
+
+		pos = next;
+	}
+
+	return std::string();
+}
+
+byterange_sink::byterange_sink():
+	target_bytes_(0),
+	state_(idle),
+	has_range_(false),
+	offset_(0),
+	remaining_(0),
+	parts_(0),
+	bytes_(0),
+	filled_(0)
+{
+}
+
+byterange_sink::byterange_sink(handler_type handler):
+	handler_(handler),
+	target_bytes_(0),
+	state_(idle),
+	has_range_(false),
+	offset_(0),
+	remaining_(0),
+	parts_(0),
+	bytes_(0),
+	filled_(0)
+{
+}
+
+byterange_sink::~byterange_sink()
+{
+}
+
+void byterange_sink::add_target(std::uint64_t offset, asio::mutable_buffer buffer)
+{
+	target t;
+	t.offset = offset;
+	t.buffer = buffer;
+
+	std::vector<target>::iterator it = targets_.begin();
+
+	while (it != targets_.end() && it->offset < offset)
+	{
+		++it;
+	}
+
+	targets_.insert(it, t);
+	target_bytes_ += asio::buffer_size(buffer);
+}
+
+void byterange_sink::clear_targets()
+{
+	targets_.clear();
+	target_bytes_ = 0;
+}
+
+std::string byterange_sink::get_range() const
+{
+	std::string range;
+	std::uint64_t first = 0;
+	std::uint64_t end = 0;
+
+	for (std::size_t i = 0; i < targets_.size(); ++i)
+	{
+		std::size_t size = asio::buffer_size(targets_[i].buffer);
+
+		if (size == 0)
+		{
+			continue;
+		}
+
+		if (end != 0 && targets_[i].offset == end)
+		{
+			end += size;
+			continue;
+		}
+
+		if (end != 0)
+		{
+			range += (range.empty() ? "" : ",") + std::to_string(first) + "-" + std::to_string(end - 1);
+		}
+
+		first = targets_[i].offset;
+		end = first + size;
+	}
+
+	if (end != 0)
+	{
+		range += (range.empty() ? "" : ",") + std::to_string(first) + "-" + std::to_string(end - 1);
+	}
+
+	return range;
+}
+
+void byterange_sink::reset()
+{
+	state_ = idle;
+	delimiter_.clear();
+	line_.clear();
+	has_range_ = false;
+	offset_ = 0;
+	remaining_ = 0;
+	parts_ = 0;
+	bytes_ = 0;
+	filled_ = 0;
+}
+
+bool byterange_sink::start(const std::string& content_type, const std::string& content_range)
+{
+	reset();
+
+	std::string type = to_lower(trim(content_type.substr(0, content_type.find(';'))));
+
+	if (type == "multipart/byteranges")
+	{
+		std::string boundary = boundary_of(content_type);
+
+		if (boundary.empty())
+		{
+			return false;
+		}
+
+		delimiter_ = "--" + boundary;
+		state_ = preamble;
+		return true;
+	}
+
+	part_.content_type = content_type;
+
+	if (content_range.empty())
+	{
+		part_.first = 0;
+		part_.last = unknown_length;
+		part_.length = unknown_length;
+	}
+	else if (!parse_content_range(content_range, part_))
+	{
+		return false;
+	}
+
+	state_ = single;
+	offset_ = part_.first;
+	remaining_ = (part_.last == unknown_length) ? unknown_length : part_.last - part_.first + 1;
+	parts_ = 1;
+	return true;
+}
+
+bool byterange_sink::write(const char* data, std::size_t size)
+{
+	while (size > 0)
+	{
+		switch (state_)
+		{
+		case idle:
+			return false;
+
+		case epilogue:
+			return true;
+
+		case single:
+		case body:
+			{
+				std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(size, remaining_));
+
+				if (n == 0 || !deliver(data, n))
+				{
+					return false;
+				}
+
+				data += n;
+				size -= n;
+
+				if (remaining_ != unknown_length)
+				{
+					remaining_ -= n;
+				}
+
+				// The line break ending a part's body is read as an empty line before the delimiter
+				if (state_ == body && remaining_ == 0)
+				{
+					state_ = preamble;
+				}
+			}
+			break;
+
+		case preamble:
+		case headers:
+			{
+				const char* lf = static_cast<const char*>(std::memchr(data, '\n', size));
+				std::size_t n = lf ? lf - data : size;
+
+				if (line_.size() + n > max_line)
+				{
+					return false;
+				}
+
+				if (!lf)
+				{
+					line_.append(data, n);
+					return true;
+				}
+
+				bool ok;
+
+				if (line_.empty())
+				{
+					ok = handle_line(data, n);
+				}
+				else
+				{
+					line_.append(data, n);
+					ok = handle_line(line_.data(), line_.size());
+					line_.clear();
+				}
+
+				if (!ok)
+				{
+					return false;
+				}
+
+				data += n + 1;
+				size -= n + 1;
+			}
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool byterange_sink::finish()
+{
+	switch (state_)
+	{
+	case epilogue:
+		return true;
+
+	case single:
+		return remaining_ == 0 || remaining_ == unknown_length;
+
+	default:
+		return false;
+	}
+}
+
+bool byterange_sink::handle_line(const char* line, std::size_t size)
+{
+	if (size > 0 && line[size - 1] == '\r')
+	{
+		--size;
+	}
+
+	if (state_ == preamble)
+	{
+		// Anything before a delimiter is preamble or the line break after a part, and a delimiter may be followed by whitespace
+		if (size >= delimiter_.size() && std::memcmp(line, delimiter_.data(), delimiter_.size()) == 0)
+		{
+			if (size >= delimiter_.size() + 2 && line[delimiter_.size()] == '-' && line[delimiter_.size() + 1] == '-')
+			{
+				state_ = epilogue;
+			}
+			else
+			{
+				state_ = headers;
+				part_ = part();
+				has_range_ = false;
+			}
+		}
+
+		return true;
+	}
+
+	if (size == 0)
+	{
+		// Every part has to say which range it holds
+		if (!has_range_)
+		{
+			return false;
+		}
+
+		state_ = body;
+		offset_ = part_.first;
+		remaining_ = part_.last - part_.first + 1;
+		++parts_;
+		return true;
+	}
+
+	const char* colon = static_cast<const char*>(std::memchr(line, ':', size));
+
+	if (!colon)
+	{
+		return true;
+	}
+
+	std::string name = to_lower(trim(std::string(line, colon)));
+	std::string value = trim(std::string(colon + 1, line + size));
+
+	if (name == "content-range")
+	{
+		has_range_ = parse_content_range(value, part_);
+		return has_range_;
+	}
+
+	if (name == "content-type")
+	{
+		part_.content_type = value;
+	}
+
+	return true;
+}
+
+bool byterange_sink::deliver(const char* data, std::size_t size)
+{
+	bytes_ += size;
+
+	if (!targets_.empty())
+	{
+		std::uint64_t end = offset_ + size;
+
+		// Targets are sorted and do not overlap, which sorts their ends as well
+		std::size_t low = 0;
+		std::size_t high = targets_.size();
+
+		while (low < high)
+		{
+			std::size_t middle = (low + high) / 2;
+
+			if (targets_[middle].offset + asio::buffer_size(targets_[middle].buffer) <= offset_)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		for (std::size_t i = low; i < targets_.size() && targets_[i].offset < end; ++i)
+		{
+			std::uint64_t begin = std::max(targets_[i].offset, offset_);
+			std::uint64_t stop = std::min(targets_[i].offset + asio::buffer_size(targets_[i].buffer), end);
+
+			if (begin < stop)
+			{
+				std::memcpy(asio::buffer_cast<char*>(targets_[i].buffer) + (begin - targets_[i].offset), data + (begin - offset_), static_cast<std::size_t>(stop - begin));
+				filled_ += stop - begin;
+			}
+		}
+	}
+
+	bool ok = !handler_ || handler_(part_, offset_, asio::const_buffer(data, size));
+	offset_ += size;
+	return ok;
+}
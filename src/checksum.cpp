@@ -0,0 +1,950 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Incremental checksums verifying response bodies as they are received
+*/
+
+#include <curl-asio/checksum.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CURLASIO_CHECKSUM_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <nmmintrin.h>
+#define CURLASIO_TARGET(features)
+#if _MSC_VER >= 1900
+#define CURLASIO_CHECKSUM_SHA_NI
+#endif
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define CURLASIO_TARGET(features) __attribute__((target(features)))
+#define CURLASIO_CHECKSUM_SHA_NI
+#endif
+#endif
+
+using namespace curl;
+
+// Reflected CRC32C (Castagnoli) polynomial
+static const std::uint32_t crc32c_polynomial = 0x82f63b78;
+
+// The accelerated CRC32C processes three streams of these sizes at once and combines their results
+static const std::size_t crc32c_long_stream = 4096;
+static const std::size_t crc32c_short_stream = 256;
+
+static const std::uint32_t sha256_initial_state[8] =
+{
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const std::uint32_t sha256_round_constants[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const std::uint64_t xxh64_prime1 = 11400714785074694791ULL;
+static const std::uint64_t xxh64_prime2 = 14029467366897019727ULL;
+static const std::uint64_t xxh64_prime3 = 1609587929392839161ULL;
+static const std::uint64_t xxh64_prime4 = 9650029242287828579ULL;
+static const std::uint64_t xxh64_prime5 = 2870177450012600261ULL;
+
+static inline std::uint32_t load_le32(const unsigned char* p)
+{
+	return static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) | (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+static inline std::uint64_t load_le64(const unsigned char* p)
+{
+	return static_cast<std::uint64_t>(load_le32(p)) | (static_cast<std::uint64_t>(load_le32(p + 4)) << 32);
+}
+
+static inline std::uint32_t load_be32(const unsigned char* p)
+{
+	return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16) | (static_cast<std::uint32_t>(p[2]) << 8) | static_cast<std::uint32_t>(p[3]);
+}
+
+static inline void store_be(std::string& out, std::uint64_t value, std::size_t bytes)
+{
+	while (bytes > 0)
+	{
+		--bytes;
+		out.push_back(static_cast<char>((value >> (bytes * 8)) & 0xff));
+	}
+}
+
+static inline std::uint32_t rotr32(std::uint32_t value, unsigned int bits)
+{
+	return (value >> bits) | (value << (32 - bits));
+}
+
+static inline std::uint64_t rotl64(std::uint64_t value, unsigned int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// Multiplies a 32x32 matrix over GF(2) with a vector, as used to advance a CRC over a run of zero bytes
+static std::uint32_t gf2_matrix_times(const std::uint32_t* matrix, std::uint32_t vector)
+{
+	std::uint32_t sum = 0;
+
+	for (; vector; vector >>= 1, ++matrix)
+	{
+		if (vector & 1)
+		{
+			sum ^= *matrix;
+		}
+	}
+
+	return sum;
+}
+
+static void gf2_matrix_square(std::uint32_t* square, const std::uint32_t* matrix)
+{
+	for (int n = 0; n < 32; ++n)
+	{
+		square[n] = gf2_matrix_times(matrix, matrix[n]);
+	}
+}
+
+struct crc32c_tables
+{
+	std::uint32_t slices[8][256];
+	std::uint32_t long_shift[4][256];
+	std::uint32_t short_shift[4][256];
+
+	crc32c_tables()
+	{
+		for (std::uint32_t n = 0; n < 256; ++n)
+		{
+			std::uint32_t crc = n;
+
+			for (int k = 0; k < 8; ++k)
+			{
+				crc = (crc & 1) ? (crc >> 1) ^ crc32c_polynomial : crc >> 1;
+			}
+
+			slices[0][n] = crc;
+		}
+
+		for (std::uint32_t n = 0; n < 256; ++n)
+		{
+			for (int k = 1; k < 8; ++k)
+			{
+				slices[k][n] = (slices[k - 1][n] >> 8) ^ slices[0][slices[k - 1][n] & 0xff];
+			}
+		}
+
+		build_shift(long_shift, crc32c_long_stream);
+		build_shift(short_shift, crc32c_short_stream);
+	}
+
+	// Builds tables applying the operator which appends the given number of zero bytes to a CRC
+	static void build_shift(std::uint32_t shift[4][256], std::size_t length)
+	{
+		std::uint32_t even[32];
+		std::uint32_t odd[32];
+
+		// Operator for a single zero bit
+		odd[0] = crc32c_polynomial;
+
+		for (int n = 1; n < 32; ++n)
+		{
+			odd[n] = 1u << (n - 1);
+		}
+
+		// Square it up to one zero byte, then apply the squares selected by the bits of length
+		gf2_matrix_square(even, odd);
+		gf2_matrix_square(odd, even);
+		gf2_matrix_square(even, odd);
+
+		std::uint32_t op[32];
+		bool have_op = false;
+		std::uint32_t* square = even;
+		std::uint32_t* next = odd;
+
+		for (; length; length >>= 1)
+		{
+			if (length & 1)
+			{
+				if (!have_op)
+				{
+					std::memcpy(op, square, sizeof(op));
+					have_op = true;
+				}
+				else
+				{
+					std::uint32_t combined[32];
+
+					for (int n = 0; n < 32; ++n)
+					{
+						combined[n] = gf2_matrix_times(square, op[n]);
+					}
+
+					std::memcpy(op, combined, sizeof(op));
+				}
+			}
+
+			gf2_matrix_square(next, square);
+			std::swap(square, next);
+		}
+
+		for (std::uint32_t n = 0; n < 256; ++n)
+		{
+			shift[0][n] = gf2_matrix_times(op, n);
+			shift[1][n] = gf2_matrix_times(op, n << 8);
+			shift[2][n] = gf2_matrix_times(op, n << 16);
+			shift[3][n] = gf2_matrix_times(op, n << 24);
+		}
+	}
+};
+
+static const crc32c_tables crc32c_table;
+
+static std::uint32_t crc32c_software(std::uint32_t crc, const unsigned char* data, std::size_t size)
+{
+	const std::uint32_t (*t)[256] = crc32c_table.slices;
+
+	for (; size >= 8; data += 8, size -= 8)
+	{
+		std::uint32_t low = load_le32(data) ^ crc;
+		std::uint32_t high = load_le32(data + 4);
+
+		crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+			t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+	}
+
+	for (; size > 0; ++data, --size)
+	{
+		crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+	}
+
+	return crc;
+}
+
+static void sha256_software(std::uint32_t state[8], const unsigned char* data, std::size_t blocks)
+{
+	for (; blocks > 0; --blocks, data += 64)
+	{
+		std::uint32_t w[64];
+
+		for (int i = 0; i < 16; ++i)
+		{
+			w[i] = load_be32(data + i * 4);
+		}
+
+		for (int i = 16; i < 64; ++i)
+		{
+			std::uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			std::uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for (int i = 0; i < 64; ++i)
+		{
+			std::uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_round_constants[i] + w[i];
+			std::uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+#if defined(CURLASIO_CHECKSUM_X86)
+struct cpu_features
+{
+	bool sse42;
+	bool sha;
+
+	cpu_features():
+		sse42(false),
+		sha(false)
+	{
+		unsigned int regs[4] = { 0, 0, 0, 0 };
+		unsigned int max_leaf;
+
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		max_leaf = static_cast<unsigned int>(info[0]);
+		__cpuid(info, 1);
+		regs[2] = static_cast<unsigned int>(info[2]);
+#else
+		max_leaf = __get_cpuid_max(0, 0);
+		__cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+
+		sse42 = (regs[2] & (1u << 20)) != 0;
+
+		// The SHA-256 kernel shuffles with SSSE3 and blends with SSE4.1
+		bool ssse3_sse41 = (regs[2] & (1u << 9)) && (regs[2] & (1u << 19));
+
+		if (max_leaf >= 7 && ssse3_sse41)
+		{
+#if defined(_MSC_VER)
+			__cpuidex(info, 7, 0);
+			regs[1] = static_cast<unsigned int>(info[1]);
+#else
+			__cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+			sha = (regs[1] & (1u << 29)) != 0;
+		}
+	}
+};
+
+static const cpu_features cpu;
+
+static inline std::uint32_t crc32c_shift(const std::uint32_t shift[4][256], std::uint32_t crc)
+{
+	return shift[0][crc & 0xff] ^ shift[1][(crc >> 8) & 0xff] ^ shift[2][(crc >> 16) & 0xff] ^ shift[3][crc >> 24];
+}
+
+CURLASIO_TARGET("sse4.2")
+static std::uint32_t crc32c_sse42(std::uint32_t crc, const unsigned char* data, std::size_t size)
+{
+	std::uint64_t crc0 = crc;
+
+	for (; size > 0 && (reinterpret_cast<std::uintptr_t>(data) & 7); ++data, --size)
+	{
+		crc0 = _mm_crc32_u8(static_cast<std::uint32_t>(crc0), *data);
+	}
+
+	// A single crc32 instruction has a latency of three cycles, but a throughput of one, so three independent streams keep the unit busy. Their CRCs are merged by shifting the earlier ones over the length of the later ones.
+	const std::size_t streams[2] = { crc32c_long_stream, crc32c_short_stream };
+	const std::uint32_t (*shifts[2])[256] = { crc32c_table.long_shift, crc32c_table.short_shift };
+
+	for (int s = 0; s < 2; ++s)
+	{
+		const std::size_t stream = streams[s];
+
+		while (size >= stream * 3)
+		{
+			std::uint64_t crc1 = 0;
+			std::uint64_t crc2 = 0;
+			const unsigned char* end = data + stream;
+
+			for (; data < end; data += 8)
+			{
+				std::uint64_t word0, word1, word2;
+				std::memcpy(&word0, data, 8);
+				std::memcpy(&word1, data + stream, 8);
+				std::memcpy(&word2, data + stream * 2, 8);
+				crc0 = _mm_crc32_u64(crc0, word0);
+				crc1 = _mm_crc32_u64(crc1, word1);
+				crc2 = _mm_crc32_u64(crc2, word2);
+			}
+
+			crc0 = crc32c_shift(shifts[s], static_cast<std::uint32_t>(crc0)) ^ crc1;
+			crc0 = crc32c_shift(shifts[s], static_cast<std::uint32_t>(crc0)) ^ crc2;
+			data += stream * 2;
+			size -= stream * 3;
+		}
+	}
+
+	for (; size >= 8; data += 8, size -= 8)
+	{
+		std::uint64_t word;
+		std::memcpy(&word, data, 8);
+		crc0 = _mm_crc32_u64(crc0, word);
+	}
+
+	for (; size > 0; ++data, --size)
+	{
+		crc0 = _mm_crc32_u8(static_cast<std::uint32_t>(crc0), *data);
+	}
+
+	return static_cast<std::uint32_t>(crc0);
+}
+
+#if defined(CURLASIO_CHECKSUM_SHA_NI)
+CURLASIO_TARGET("sha,sse4.1,ssse3")
+static void sha256_sha_ni(std::uint32_t state[8], const unsigned char* data, std::size_t blocks)
+{
+	const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	// The rnds2 instruction keeps the working variables as ABEF and CDGH
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xb1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1b);
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+	for (; blocks > 0; --blocks, data += 64)
+	{
+		__m128i abef = state0;
+		__m128i cdgh = state1;
+		__m128i w[4];
+
+		for (int i = 0; i < 16; ++i)
+		{
+			__m128i& current = w[i & 3];
+
+			if (i < 4)
+			{
+				current = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16)), byte_swap);
+			}
+			else
+			{
+				const __m128i& previous = w[(i - 1) & 3];
+				current = _mm_sha256msg1_epu32(current, w[(i - 3) & 3]);
+				current = _mm_add_epi32(current, _mm_alignr_epi8(previous, w[(i - 2) & 3], 4));
+				current = _mm_sha256msg2_epu32(current, previous);
+			}
+
+			__m128i message = _mm_add_epi32(current, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&sha256_round_constants[i * 4])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0e));
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), _mm_blend_epi16(tmp, state1, 0xf0));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), _mm_alignr_epi8(state1, tmp, 8));
+}
+#endif
+#endif
+
+static bool acceleration_enabled = true;
+
+static std::uint32_t update_crc32c(std::uint32_t crc, const unsigned char* data, std::size_t size)
+{
+#if defined(CURLASIO_CHECKSUM_X86)
+	if (acceleration_enabled && cpu.sse42)
+	{
+		return crc32c_sse42(crc, data, size);
+	}
+#endif
+
+	return crc32c_software(crc, data, size);
+}
+
+static void update_sha256_blocks(std::uint32_t state[8], const unsigned char* data, std::size_t blocks)
+{
+#if defined(CURLASIO_CHECKSUM_SHA_NI)
+	if (acceleration_enabled && cpu.sha)
+	{
+		sha256_sha_ni(state, data, blocks);
+		return;
+	}
+#endif
+
+	sha256_software(state, data, blocks);
+}
+
+static inline std::uint64_t xxh64_round(std::uint64_t accumulator, std::uint64_t input)
+{
+	accumulator += input * xxh64_prime2;
+	accumulator = rotl64(accumulator, 31);
+	return accumulator * xxh64_prime1;
+}
+
+static inline std::uint64_t xxh64_merge_round(std::uint64_t hash, std::uint64_t accumulator)
+{
+	hash ^= xxh64_round(0, accumulator);
+	return hash * xxh64_prime1 + xxh64_prime4;
+}
+
+static const unsigned char* xxh64_stripes(std::uint64_t state[4], const unsigned char* data, std::size_t size)
+{
+	std::uint64_t v1 = state[0], v2 = state[1], v3 = state[2], v4 = state[3];
+
+	for (; size >= 32; data += 32, size -= 32)
+	{
+		v1 = xxh64_round(v1, load_le64(data));
+		v2 = xxh64_round(v2, load_le64(data + 8));
+		v3 = xxh64_round(v3, load_le64(data + 16));
+		v4 = xxh64_round(v4, load_le64(data + 24));
+	}
+
+	state[0] = v1;
+	state[1] = v2;
+	state[2] = v3;
+	state[3] = v4;
+	return data;
+}
+
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	else if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	else if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+static int base64_value(char c)
+{
+	if (c >= 'A' && c <= 'Z')
+	{
+		return c - 'A';
+	}
+	else if (c >= 'a' && c <= 'z')
+	{
+		return c - 'a' + 26;
+	}
+	else if (c >= '0' && c <= '9')
+	{
+		return c - '0' + 52;
+	}
+	else if (c == '+' || c == '-')
+	{
+		return 62;
+	}
+	else if (c == '/' || c == '_')
+	{
+		return 63;
+	}
+
+	return -1;
+}
+
+// Accepts the standard and the URL-safe alphabet, with or without padding
+static std::string decode_base64(const std::string& text)
+{
+	std::string out;
+	std::uint32_t bits = 0;
+	int count = 0;
+
+	for (std::size_t i = 0; i < text.size() && text[i] != '='; ++i)
+	{
+		int value = base64_value(text[i]);
+
+		if (value < 0)
+		{
+			return std::string();
+		}
+
+		bits = (bits << 6) | static_cast<std::uint32_t>(value);
+		count += 6;
+
+		if (count >= 8)
+		{
+			count -= 8;
+			out.push_back(static_cast<char>((bits >> count) & 0xff));
+		}
+	}
+
+	return out;
+}
+
+static std::string trim(const std::string& str)
+{
+	std::size_t begin = str.find_first_not_of(" \t\r\n");
+
+	if (begin == std::string::npos)
+	{
+		return std::string();
+	}
+
+	return str.substr(begin, str.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+static std::string to_lower(std::string str)
+{
+	std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+	return str;
+}
+
+static bool names_algorithm(checksum::algorithm algo, const std::string& token)
+{
+	switch (algo)
+	{
+	case checksum::crc32c:
+		return (token == "crc32c");
+
+	case checksum::sha256:
+		return (token == "sha-256" || token == "sha256");
+
+	case checksum::xxh64:
+		return (token == "xxh64" || token == "xxhash64");
+	}
+
+	return false;
+}
+
+// Servers send digests in hex or base64; the lengths of both encodings differ for every digest size
+static std::string decode_digest(checksum::algorithm algo, std::string value)
+{
+	value = trim(value);
+
+	// Byte sequences of structured fields (RFC 8941) are enclosed in colons
+	if (value.size() >= 2 && value[0] == ':' && value[value.size() - 1] == ':')
+	{
+		value = value.substr(1, value.size() - 2);
+	}
+
+	std::string digest = checksum::parse_hex_digest(algo, value);
+
+	if (digest.empty())
+	{
+		digest = decode_base64(value);
+	}
+
+	return (digest.size() == checksum::digest_size(algo)) ? digest : std::string();
+}
+
+checksum::checksum(algorithm algo):
+	algorithm_(algo)
+{
+	reset();
+}
+
+checksum::~checksum()
+{
+}
+
+void checksum::reset()
+{
+	length_ = 0;
+	crc_ = 0xffffffff;
+	std::memcpy(sha_state_, sha256_initial_state, sizeof(sha_state_));
+	xxh_state_[0] = xxh64_prime1 + xxh64_prime2;
+	xxh_state_[1] = xxh64_prime2;
+	xxh_state_[2] = 0;
+	xxh_state_[3] = 0 - xxh64_prime1;
+	block_size_ = 0;
+}
+
+void checksum::update(const void* data, std::size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+	switch (algorithm_)
+	{
+	case crc32c:
+		crc_ = update_crc32c(crc_, bytes, size);
+		break;
+
+	case sha256:
+		update_sha256(bytes, size);
+		break;
+
+	case xxh64:
+		update_xxh64(bytes, size);
+		break;
+	}
+
+	length_ += size;
+}
+
+void checksum::update_sha256(const unsigned char* data, std::size_t size)
+{
+	if (block_size_ > 0)
+	{
+		std::size_t n = std::min(size, sizeof(block_) - block_size_);
+		std::memcpy(block_ + block_size_, data, n);
+		block_size_ += n;
+		data += n;
+		size -= n;
+
+		if (block_size_ < sizeof(block_))
+		{
+			return;
+		}
+
+		update_sha256_blocks(sha_state_, block_, 1);
+		block_size_ = 0;
+	}
+
+	// Whole blocks are hashed in place
+	update_sha256_blocks(sha_state_, data, size / 64);
+	data += size & ~static_cast<std::size_t>(63);
+	size &= 63;
+
+	std::memcpy(block_, data, size);
+	block_size_ = size;
+}
+
+void checksum::update_xxh64(const unsigned char* data, std::size_t size)
+{
+	if (block_size_ > 0)
+	{
+		std::size_t n = std::min(size, 32 - block_size_);
+		std::memcpy(block_ + block_size_, data, n);
+		block_size_ += n;
+		data += n;
+		size -= n;
+
+		if (block_size_ < 32)
+		{
+			return;
+		}
+
+		xxh64_stripes(xxh_state_, block_, 32);
+		block_size_ = 0;
+	}
+
+	const unsigned char* rest = xxh64_stripes(xxh_state_, data, size);
+	size -= rest - data;
+
+	std::memcpy(block_, rest, size);
+	block_size_ = size;
+}
+
+std::string checksum::digest() const
+{
+	std::string out;
+
+	switch (algorithm_)
+	{
+	case crc32c:
+		store_be(out, crc_ ^ 0xffffffff, 4);
+		break;
+
+	case sha256:
+		{
+			// Padding is applied to a copy, which leaves this checksum open for more data
+			std::uint32_t state[8];
+			unsigned char tail[128];
+			std::size_t tail_size = (block_size_ < 56) ? 64 : 128;
+
+			std::memcpy(state, sha_state_, sizeof(state));
+			std::memset(tail, 0, sizeof(tail));
+			std::memcpy(tail, block_, block_size_);
+			tail[block_size_] = 0x80;
+
+			std::uint64_t bits = length_ * 8;
+
+			for (int i = 0; i < 8; ++i)
+			{
+				tail[tail_size - 1 - i] = static_cast<unsigned char>(bits >> (i * 8));
+			}
+
+			update_sha256_blocks(state, tail, tail_size / 64);
+
+			for (int i = 0; i < 8; ++i)
+			{
+				store_be(out, state[i], 4);
+			}
+		}
+		break;
+
+	case xxh64:
+		{
+			std::uint64_t hash;
+
+			if (length_ >= 32)
+			{
+				hash = rotl64(xxh_state_[0], 1) + rotl64(xxh_state_[1], 7) + rotl64(xxh_state_[2], 12) + rotl64(xxh_state_[3], 18);
+
+				for (int i = 0; i < 4; ++i)
+				{
+					hash = xxh64_merge_round(hash, xxh_state_[i]);
+				}
+			}
+			else
+			{
+				hash = xxh64_prime5;
+			}
+
+			hash += length_;
+
+			const unsigned char* p = block_;
+			const unsigned char* end = block_ + block_size_;
+
+			for (; p + 8 <= end; p += 8)
+			{
+				hash ^= xxh64_round(0, load_le64(p));
+				hash = rotl64(hash, 27) * xxh64_prime1 + xxh64_prime4;
+			}
+
+			if (p + 4 <= end)
+			{
+				hash ^= static_cast<std::uint64_t>(load_le32(p)) * xxh64_prime1;
+				hash = rotl64(hash, 23) * xxh64_prime2 + xxh64_prime3;
+				p += 4;
+			}
+
+			for (; p < end; ++p)
+			{
+				hash ^= *p * xxh64_prime5;
+				hash = rotl64(hash, 11) * xxh64_prime1;
+			}
+
+			hash ^= hash >> 33;
+			hash *= xxh64_prime2;
+			hash ^= hash >> 29;
+			hash *= xxh64_prime3;
+			hash ^= hash >> 32;
+
+			store_be(out, hash, 8);
+		}
+		break;
+	}
+
+	return out;
+}
+
+std::string checksum::hex_digest() const
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string raw = digest();
+	std::string out;
+	out.reserve(raw.size() * 2);
+
+	for (std::size_t i = 0; i < raw.size(); ++i)
+	{
+		unsigned char c = static_cast<unsigned char>(raw[i]);
+		out.push_back(digits[c >> 4]);
+		out.push_back(digits[c & 0x0f]);
+	}
+
+	return out;
+}
+
+std::size_t checksum::digest_size(algorithm algo)
+{
+	switch (algo)
+	{
+	case crc32c:
+		return 4;
+
+	case sha256:
+		return 32;
+
+	case xxh64:
+		return 8;
+	}
+
+	return 0;
+}
+
+bool checksum::is_accelerated(algorithm algo)
+{
+#if defined(CURLASIO_CHECKSUM_X86)
+	if (!acceleration_enabled)
+	{
+		return false;
+	}
+
+	switch (algo)
+	{
+	case crc32c:
+		return cpu.sse42;
+
+	case sha256:
+#if defined(CURLASIO_CHECKSUM_SHA_NI)
+		return cpu.sha;
+#else
+		return false;
+#endif
+
+	case xxh64:
+		return false;
+	}
+#endif
+
+	return false;
+}
+
+void checksum::set_acceleration(bool enabled)
+{
+	acceleration_enabled = enabled;
+}
+
+std::string checksum::announced_digest(algorithm algo, const std::string& name, const std::string& value)
+{
+	std::string field = to_lower(trim(name));
+
+	if (field == "digest" || field == "content-digest" || field == "repr-digest" || field == "x-goog-hash" || field == "x-checksum")
+	{
+		// Lists of algorithm=value pairs, where values of structured fields might carry parameters
+		std::size_t begin = 0;
+
+		while (begin <= value.size())
+		{
+			std::size_t end = value.find(',', begin);
+
+			if (end == std::string::npos)
+			{
+				end = value.size();
+			}
+
+			std::string item = value.substr(begin, end - begin);
+			std::size_t equals = item.find('=');
+
+			if (equals != std::string::npos && names_algorithm(algo, to_lower(trim(item.substr(0, equals)))))
+			{
+				std::string digest = item.substr(equals + 1);
+				digest = digest.substr(0, digest.find(';'));
+				return decode_digest(algo, digest);
+			}
+
+			begin = end + 1;
+		}
+	}
+	else if (field.compare(0, 11, "x-checksum-") == 0 && names_algorithm(algo, field.substr(11)))
+	{
+		return decode_digest(algo, value);
+	}
+	else if (field.compare(0, 15, "x-amz-checksum-") == 0 && names_algorithm(algo, field.substr(15)))
+	{
+		return decode_digest(algo, value);
+	}
+
+	return std::string();
+}
+
+std::string checksum::parse_hex_digest(algorithm algo, const std::string& hex)
+{
+	if (hex.size() != digest_size(algo) * 2)
+	{
+		return std::string();
+	}
+
+	std::string out;
+
+	for (std::size_t i = 0; i < hex.size(); i += 2)
+	{
+		int high = hex_value(hex[i]);
+		int low = hex_value(hex[i + 1]);
+
+		if (high < 0 || low < 0)
+		{
+			return std::string();
+		}
+
+		out.push_back(static_cast<char>((high << 4) | low));
+	}
+
+	return out;
+}
@@ -0,0 +1,183 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Per-origin circuit breaker which fails requests to unhealthy origins without touching the network
+*/
+
+#include <curl-asio/circuit_breaker.h>
+#include <curl-asio/error_code.h>
+#include <asio/error.hpp>
+#include <algorithm>
+
+using namespace curl;
+
+circuit_breaker::circuit::circuit():
+	state(closed),
+	failures(0),
+	probes_in_flight(0),
+	probes_succeeded(0)
+{
+}
+
+circuit_breaker::circuit_breaker():
+	failure_threshold_(5),
+	open_duration_(std::chrono::seconds(5)),
+	probe_count_(1),
+	rejected_(0)
+{
+}
+
+void circuit_breaker::set_failure_threshold(unsigned int failures)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	failure_threshold_ = std::max(failures, 1u);
+}
+
+void circuit_breaker::set_open_duration(clock_type::duration duration)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	open_duration_ = duration;
+}
+
+void circuit_breaker::set_probe_count(unsigned int probes)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	probe_count_ = std::max(probes, 1u);
+}
+
+circuit_breaker::state_t circuit_breaker::get_state(const std::string& origin)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	circuit_map::iterator it = circuits_.find(origin);
+
+	if (it == circuits_.end())
+	{
+		return closed;
+	}
+
+	update(it->second);
+	return it->second.state;
+}
+
+bool circuit_breaker::admit(const std::string& origin, bool& probe)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	probe = false;
+	circuit_map::iterator it = circuits_.find(origin);
+
+	if (it == circuits_.end())
+	{
+		return true;
+	}
+
+	circuit& c = it->second;
+	update(c);
+
+	switch (c.state)
+	{
+	case closed:
+		return true;
+
+	case half_open:
+		if (c.probes_in_flight + c.probes_succeeded < probe_count_)
+		{
+			++c.probes_in_flight;
+			probe = true;
+			return true;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	++rejected_;
+	return false;
+}
+
+void circuit_breaker::record_result(const std::string& origin, bool probe, bool success)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	circuit& c = circuits_[origin];
+
+	if (probe)
+	{
+		c.probes_in_flight = (c.probes_in_flight > 0) ? c.probes_in_flight - 1 : 0;
+
+		if (c.state != half_open)
+		{
+			return;
+		}
+
+		if (!success)
+		{
+			trip(c);
+		}
+		else if (++c.probes_succeeded >= probe_count_)
+		{
+			c.state = closed;
+			c.failures = 0;
+		}
+	}
+	else if (c.state == closed)
+	{
+		// Results of requests which were admitted before the circuit opened do not affect the other states
+		if (!success)
+		{
+			if (++c.failures >= failure_threshold_)
+			{
+				trip(c);
+			}
+		}
+		else
+		{
+			c.failures = 0;
+		}
+	}
+}
+
+void circuit_breaker::release_probe(const std::string& origin)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	circuit_map::iterator it = circuits_.find(origin);
+
+	if (it != circuits_.end() && it->second.probes_in_flight > 0)
+	{
+		--it->second.probes_in_flight;
+	}
+}
+
+bool circuit_breaker::is_failure(const asio::error_code& err, long response_code)
+{
+	if (err)
+	{
+		// Errors raised by callbacks or local I/O say nothing about the origin's health. Transfer results are reported in the system category, see multi::process_messages.
+		return !(err == asio::error::operation_aborted
+			|| err.category() != asio::system_category()
+			|| err.value() == errc::easy::write_error
+			|| err.value() == errc::easy::read_error
+			|| err.value() == errc::easy::aborted_by_callback
+			|| err.value() == errc::easy::filesize_exceeded);
+	}
+
+	return (response_code >= 500);
+}
+
+void circuit_breaker::trip(circuit& c)
+{
+	c.state = open;
+	c.opened_at = clock_type::now();
+	c.probes_succeeded = 0;
+	c.failures = 0;
+}
+
+void circuit_breaker::update(circuit& c)
+{
+	if (c.state == open && clock_type::now() - c.opened_at >= open_duration_)
+	{
+		c.state = half_open;
+		c.probes_succeeded = 0;
+	}
+}
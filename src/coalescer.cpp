@@ -0,0 +1,188 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Single-flight coalescing of identical in-flight requests
+*/
+
+#include <curl-asio/coalescer.h>
+#include <curl-asio/easy.h>
+#include <curl-asio/multi.h>
+#include <algorithm>
+#include <cctype>
+
+using namespace curl;
+
+// A transfer and the requests waiting for it. The completion handler only holds the flight, which is detached from its coalescer when the coalescer cancels it.
+struct coalescer::flight
+{
+	coalescer* owner;
+	asio::io_service* io_service;
+	std::shared_ptr<easy> handle;
+	std::vector<handler_type> waiters;
+};
+
+static std::string to_lower(std::string str)
+{
+	std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+	return str;
+}
+
+coalescer::coalescer(multi& multi_handle):
+	multi_(multi_handle),
+	transfers_started_(0),
+	requests_coalesced_(0)
+{
+}
+
+coalescer::~coalescer()
+{
+	cancel();
+}
+
+void coalescer::add_key_header(const std::string& name)
+{
+	key_headers_.insert(to_lower(name));
+}
+
+void coalescer::set_setup(setup_type setup)
+{
+	setup_ = setup;
+}
+
+void coalescer::async_get(const std::string& url, handler_type handler)
+{
+	async_request("GET", url, std::vector<std::string>(), handler);
+}
+
+void coalescer::async_get(const std::string& url, const std::vector<std::string>& headers, handler_type handler)
+{
+	async_request("GET", url, headers, handler);
+}
+
+void coalescer::async_request(const std::string& method, const std::string& url, const std::vector<std::string>& headers, handler_type handler)
+{
+	std::string key = make_key(method, url, headers);
+	flight_map::iterator it = flights_.find(key);
+
+	if (it != flights_.end())
+	{
+		it->second->waiters.push_back(handler);
+		++requests_coalesced_;
+		return;
+	}
+
+	flight_ptr f(new flight);
+	f->owner = this;
+	f->io_service = &multi_.get_io_service();
+	f->waiters.push_back(handler);
+	flights_.insert(flight_map::value_type(key, f));
+
+	start(key, f, method, url, headers);
+}
+
+void coalescer::cancel()
+{
+	flight_map flights;
+	flights.swap(flights_);
+
+	for (flight_map::iterator it = flights.begin(); it != flights.end(); ++it)
+	{
+		flight_ptr f = it->second;
+		f->owner = 0;
+		complete(f, asio::error_code(asio::error::operation_aborted), 0, body_ptr());
+
+		// The flight keeps the easy handle alive until its completion handler ran
+		f->handle->cancel();
+	}
+}
+
+std::string coalescer::make_key(const std::string& method, const std::string& url, const std::vector<std::string>& headers) const
+{
+	std::vector<std::string> key_headers;
+
+	for (std::vector<std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it)
+	{
+		std::string::size_type colon = it->find(':');
+		std::string name = to_lower(it->substr(0, colon));
+
+		if (key_headers_.count(name) != 0)
+		{
+			std::string::size_type value_begin = (colon == std::string::npos) ? it->size() : it->find_first_not_of(" \t", colon + 1);
+			key_headers.push_back(name + ":" + (value_begin == std::string::npos ? std::string() : it->substr(value_begin)));
+		}
+	}
+
+	// Header order does not matter for the key
+	std::sort(key_headers.begin(), key_headers.end());
+
+	std::string key = method + " " + url;
+
+	for (std::vector<std::string>::const_iterator it = key_headers.begin(); it != key_headers.end(); ++it)
+	{
+		key += '\n';
+		key += *it;
+	}
+
+	return key;
+}
+
+void coalescer::start(const std::string& key, flight_ptr f, const std::string& method, const std::string& url, const std::vector<std::string>& headers)
+{
+	f->handle.reset(new easy(multi_));
+
+	easy& handle = *f->handle;
+	handle.set_url(url);
+
+	if (method == "HEAD")
+	{
+		handle.set_no_body(true);
+	}
+	else if (method != "GET")
+	{
+		handle.set_custom_request(method.c_str());
+	}
+
+	for (std::vector<std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it)
+	{
+		handle.add_header(*it);
+	}
+
+	if (setup_)
+	{
+		setup_(handle);
+	}
+
+	++transfers_started_;
+	handle.async_fetch(std::bind(&coalescer::handle_completion, key, f, std::placeholders::_1, std::placeholders::_2));
+}
+
+void coalescer::handle_completion(std::string key, flight_ptr f, const asio::error_code& err, std::string body)
+{
+	// The easy handle invokes this function through a copy of the handler, so it may be released here
+	std::shared_ptr<easy> handle;
+	handle.swap(f->handle);
+
+	if (!f->owner)
+	{
+		return;
+	}
+
+	f->owner->flights_.erase(key);
+	f->owner = 0;
+
+	long response_code = handle->get_reponse_code();
+	complete(f, err, response_code, std::make_shared<const std::string>(std::move(body)));
+}
+
+void coalescer::complete(flight_ptr f, const asio::error_code& err, long response_code, body_ptr body)
+{
+	for (std::vector<handler_type>::iterator it = f->waiters.begin(); it != f->waiters.end(); ++it)
+	{
+		// Every waiter receives a reference to the same body
+		f->io_service->post(std::bind(*it, err, response_code, body));
+	}
+
+	f->waiters.clear();
+}
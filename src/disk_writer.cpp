@@ -0,0 +1,388 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	File sinks written by a pool of threads, off the thread running the io_service
+*/
+
+#include <curl-asio/disk_writer.h>
+#include <curl-asio/easy.h>
+#include <algorithm>
+#include <cerrno>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace curl;
+
+// Written buffers are kept for reuse by the next combined writes, up to this number
+static const std::size_t max_spare_buffers = 16;
+
+// Drops the sink reference it was bound with on the thread running the io_service
+static void release_sink(std::shared_ptr<file_sink>)
+{
+}
+
+disk_writer::disk_writer(asio::io_service& io_service, std::size_t threads):
+	io_service_(io_service),
+	coalesce_size_(256 * 1024),
+	queue_limit_(64 * 1024 * 1024),
+	queued_bytes_(0),
+	writes_(0),
+	pauses_(0),
+	stopped_(false)
+{
+	for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i)
+	{
+		threads_.push_back(std::thread(std::bind(&disk_writer::run, this)));
+	}
+}
+
+disk_writer::~disk_writer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopped_ = true;
+	}
+
+	wakeup_.notify_all();
+
+	for (std::vector<std::thread>::iterator it = threads_.begin(); it != threads_.end(); ++it)
+	{
+		it->join();
+	}
+}
+
+void disk_writer::set_coalesce_size(std::size_t size)
+{
+	coalesce_size_ = std::max<std::size_t>(size, 1);
+}
+
+void disk_writer::set_queue_limit(std::size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	queue_limit_ = bytes;
+}
+
+std::shared_ptr<file_sink> disk_writer::open(const std::string& path)
+{
+	asio::error_code ec;
+	std::shared_ptr<file_sink> sink = open(path, ec);
+	asio::detail::throw_error(ec, "open");
+	return sink;
+}
+
+std::shared_ptr<file_sink> disk_writer::open(const std::string& path, asio::error_code& ec)
+{
+#if !defined(_WIN32)
+	int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (fd == -1)
+	{
+		ec = asio::error_code(errno, asio::system_category());
+		return std::shared_ptr<file_sink>();
+	}
+
+	ec = asio::error_code();
+	return std::shared_ptr<file_sink>(new file_sink(shared_from_this(), fd));
+#else
+	ec = asio::error::operation_not_supported;
+	return std::shared_ptr<file_sink>();
+#endif
+}
+
+std::size_t disk_writer::get_queued_bytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return queued_bytes_;
+}
+
+std::size_t disk_writer::get_writes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return writes_;
+}
+
+std::size_t disk_writer::get_pauses() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return pauses_;
+}
+
+bool disk_writer::submit(std::shared_ptr<file_sink> sink, std::string& data, std::size_t offset, bool force)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (!force && queued_bytes_ >= queue_limit_)
+	{
+		waiting_.insert(sink);
+		++pauses_;
+
+		if (!sink->work_)
+		{
+			sink->work_.reset(new asio::io_service::work(io_service_));
+		}
+
+		return false;
+	}
+
+	job j;
+	j.sink = sink;
+	j.data.swap(data);
+	j.offset = offset;
+	j.preallocate = 0;
+
+	if (!spare_buffers_.empty())
+	{
+		data.swap(spare_buffers_.back());
+		spare_buffers_.pop_back();
+	}
+
+	queued_bytes_ += j.data.size();
+	++sink->pending_;
+	jobs_.push_back(std::move(j));
+	wakeup_.notify_one();
+
+	return true;
+}
+
+void disk_writer::preallocate(std::shared_ptr<file_sink> sink, std::size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	job j;
+	j.sink = sink;
+	j.offset = 0;
+	j.preallocate = size;
+
+	++sink->pending_;
+	jobs_.push_back(std::move(j));
+	wakeup_.notify_one();
+}
+
+void disk_writer::run()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	for (;;)
+	{
+		while (jobs_.empty() && !stopped_)
+		{
+			wakeup_.wait(lock);
+		}
+
+		if (jobs_.empty())
+		{
+			return;
+		}
+
+		job j = std::move(jobs_.front());
+		jobs_.pop_front();
+		lock.unlock();
+
+		asio::error_code ec;
+		execute(j, ec);
+
+		lock.lock();
+		file_sink& sink = *j.sink;
+		queued_bytes_ -= j.data.size();
+
+		if (!j.preallocate)
+		{
+			++writes_;
+		}
+
+		if (ec && !sink.error_)
+		{
+			sink.error_ = ec;
+		}
+
+		if (--sink.pending_ == 0 && sink.flush_handler_)
+		{
+			io_service_.post(std::bind(std::move(sink.flush_handler_), sink.error_));
+			sink.flush_handler_ = file_sink::handler_type();
+			sink.work_.reset();
+		}
+
+		if (!waiting_.empty() && queued_bytes_ <= queue_limit_ / 2)
+		{
+			// The references move into the posted handlers, as none may remain on this thread
+			std::vector<std::shared_ptr<file_sink> > resumed(waiting_.begin(), waiting_.end());
+			waiting_.clear();
+
+			for (std::vector<std::shared_ptr<file_sink> >::iterator it = resumed.begin(); it != resumed.end(); ++it)
+			{
+				(*it)->work_.reset();
+				io_service_.post(std::bind(&file_sink::resume, std::move(*it)));
+			}
+		}
+
+		if (!j.data.empty() && spare_buffers_.size() < max_spare_buffers)
+		{
+			j.data.clear();
+			spare_buffers_.push_back(std::string());
+			spare_buffers_.back().swap(j.data);
+		}
+
+		// The last reference to a sink must not be dropped here, since the sink might hold the last reference to this writer. Moving the job's reference into the handler leaves this thread without one, whenever the io_service gets to run it.
+		io_service_.post(std::bind(&release_sink, std::move(j.sink)));
+	}
+}
+
+void disk_writer::execute(job& j, asio::error_code& ec)
+{
+#if !defined(_WIN32)
+	if (j.preallocate)
+	{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+		// The announced length might be that of the encoded body, so the file size is left alone. Failures surface with the writes, if at all.
+		::fallocate(j.sink->fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(j.preallocate));
+#endif
+		return;
+	}
+
+	const char* data = j.data.data();
+	std::size_t left = j.data.size();
+	off_t offset = static_cast<off_t>(j.offset);
+
+	while (left > 0)
+	{
+		ssize_t written = ::pwrite(j.sink->fd_, data, left, offset);
+
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			ec = asio::error_code(errno, asio::system_category());
+			return;
+		}
+
+		data += written;
+		left -= static_cast<std::size_t>(written);
+		offset += written;
+	}
+#else
+	ec = asio::error::operation_not_supported;
+#endif
+}
+
+file_sink::file_sink(std::shared_ptr<disk_writer> writer, int fd):
+	writer_(writer),
+	fd_(fd),
+	offset_(0),
+	preallocated_(false),
+	paused_(0),
+	pending_(0)
+{
+}
+
+file_sink::~file_sink()
+{
+#if !defined(_WIN32)
+	if (fd_ != -1)
+	{
+		::close(fd_);
+	}
+#endif
+}
+
+asio::error_code file_sink::get_error() const
+{
+	std::lock_guard<std::mutex> lock(writer_->mutex_);
+	return error_;
+}
+
+std::size_t file_sink::write(easy* easy_handle, const char* data, std::size_t size, std::size_t content_length)
+{
+	if (get_error())
+	{
+		return 0;
+	}
+
+	if (!preallocated_)
+	{
+		preallocated_ = true;
+
+		if (content_length > 0)
+		{
+			writer_->preallocate(shared_from_this(), content_length);
+		}
+	}
+
+	if (!staging_.empty() && staging_.size() + size > writer_->get_coalesce_size())
+	{
+		if (!submit_staging(false))
+		{
+			// libcurl hands the same data to the write function again once the transfer is resumed
+			paused_ = easy_handle;
+			return easy::sink_pause;
+		}
+	}
+
+	if (staging_.capacity() < writer_->get_coalesce_size())
+	{
+		staging_.reserve(writer_->get_coalesce_size());
+	}
+
+	staging_.append(data, size);
+	return size;
+}
+
+void file_sink::async_flush(handler_type handler)
+{
+	paused_ = 0;
+
+	if (!staging_.empty())
+	{
+		submit_staging(true);
+	}
+
+	std::lock_guard<std::mutex> lock(writer_->mutex_);
+	writer_->waiting_.erase(shared_from_this());
+
+	if (pending_ == 0)
+	{
+		writer_->io_service_.post(std::bind(handler, error_));
+		work_.reset();
+	}
+	else
+	{
+		flush_handler_ = handler;
+
+		if (!work_)
+		{
+			work_.reset(new asio::io_service::work(writer_->io_service_));
+		}
+	}
+}
+
+bool file_sink::submit_staging(bool force)
+{
+	std::size_t size = staging_.size();
+
+	if (!writer_->submit(shared_from_this(), staging_, offset_, force))
+	{
+		return false;
+	}
+
+	offset_ += size;
+	return true;
+}
+
+void file_sink::resume()
+{
+	if (paused_)
+	{
+		easy* easy_handle = paused_;
+		paused_ = 0;
+
+		asio::error_code ec;
+		easy_handle->release_pause(easy::pause_recv, easy::pause_by_sink, ec);
+	}
+}
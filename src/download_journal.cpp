@@ -0,0 +1,338 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Crash-safe record of the parts of a download which are on disk
+*/
+
+#include <curl-asio/checksum.h>
+#include <curl-asio/download_journal.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace curl;
+
+static const char journal_magic[] = "curl-asio download journal 1";
+
+static std::string journal_checksum(const std::string& contents)
+{
+	checksum sum(checksum::crc32c);
+	sum.update(contents.data(), contents.size());
+	return sum.hex_digest();
+}
+
+// Parses a decimal number making up the whole string
+static bool parse_number(const std::string& str, std::uint64_t& value)
+{
+	if (str.empty() || str.size() > 19 || str.find_first_not_of("0123456789") != std::string::npos)
+	{
+		return false;
+	}
+
+	value = std::strtoull(str.c_str(), 0, 10);
+	return true;
+}
+
+download_journal::download_journal(const std::string& path):
+	path_(path),
+	interval_(std::chrono::seconds(1)),
+	size_(0)
+{
+}
+
+download_journal::~download_journal()
+{
+}
+
+void download_journal::set_interval(clock_type::duration interval)
+{
+	interval_ = interval;
+}
+
+bool download_journal::load()
+{
+	reset(0, std::string(), std::string());
+
+	std::ifstream file(path_.c_str(), std::ios::binary);
+	std::ostringstream stream;
+	stream << file.rdbuf();
+	std::string contents = stream.str();
+
+	// The last line holds the checksum of everything before it
+	std::size_t last_line = contents.rfind('\n', contents.size() >= 2 ? contents.size() - 2 : 0);
+
+	if (!file || contents.empty() || contents[contents.size() - 1] != '\n' || last_line == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string body = contents.substr(0, last_line + 1);
+
+	if (contents.compare(last_line + 1, std::string::npos, "crc32c " + journal_checksum(body) + "\n") != 0)
+	{
+		return false;
+	}
+
+	std::istringstream lines(body);
+	std::string line;
+	std::uint64_t size = 0;
+	std::string etag;
+	std::string last_modified;
+	std::vector<range_type> completed;
+
+	if (!std::getline(lines, line) || line != journal_magic)
+	{
+		return false;
+	}
+
+	while (std::getline(lines, line))
+	{
+		std::size_t space = line.find(' ');
+		std::string key = line.substr(0, space);
+		std::string value = (space == std::string::npos) ? std::string() : line.substr(space + 1);
+
+		if (key == "size")
+		{
+			if (!parse_number(value, size))
+			{
+				return false;
+			}
+		}
+		else if (key == "etag")
+		{
+			etag = value;
+		}
+		else if (key == "last-modified")
+		{
+			last_modified = value;
+		}
+		else if (key == "range")
+		{
+			std::size_t separator = value.find(' ');
+			range_type range;
+
+			if (separator == std::string::npos || !parse_number(value.substr(0, separator), range.first) || !parse_number(value.substr(separator + 1), range.second) || range.first >= range.second || range.second > size)
+			{
+				return false;
+			}
+
+			completed.push_back(range);
+		}
+	}
+
+	reset(size, etag, last_modified);
+
+	for (std::size_t i = 0; i < completed.size(); ++i)
+	{
+		add_completed(completed[i].first, completed[i].second);
+	}
+
+	return true;
+}
+
+void download_journal::save()
+{
+	asio::error_code ec;
+	save(ec);
+	asio::detail::throw_error(ec, "save");
+}
+
+void download_journal::save(asio::error_code& ec)
+{
+	ec = asio::error_code();
+
+	std::ostringstream stream;
+	stream << journal_magic << "\n";
+	stream << "size " << size_ << "\n";
+
+	if (!etag_.empty())
+	{
+		stream << "etag " << etag_ << "\n";
+	}
+
+	if (!last_modified_.empty())
+	{
+		stream << "last-modified " << last_modified_ << "\n";
+	}
+
+	for (std::size_t i = 0; i < completed_.size(); ++i)
+	{
+		stream << "range " << completed_[i].first << " " << completed_[i].second << "\n";
+	}
+
+	std::string contents = stream.str();
+	contents += "crc32c " + journal_checksum(contents) + "\n";
+
+	std::string temp_path = path_ + ".tmp";
+
+#if !defined(_WIN32)
+	int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (fd == -1)
+	{
+		ec = asio::error_code(errno, asio::system_category());
+		return;
+	}
+
+	std::size_t written = 0;
+
+	while (written < contents.size())
+	{
+		ssize_t result = ::write(fd, contents.data() + written, contents.size() - written);
+
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (result < 0)
+		{
+			ec = asio::error_code(errno, asio::system_category());
+			::close(fd);
+			return;
+		}
+
+		written += static_cast<std::size_t>(result);
+	}
+
+	// The contents have to be on disk before the rename makes them the journal
+	if (::fsync(fd) != 0)
+	{
+		ec = asio::error_code(errno, asio::system_category());
+	}
+
+	::close(fd);
+
+	if (!ec && ::rename(temp_path.c_str(), path_.c_str()) != 0)
+	{
+		ec = asio::error_code(errno, asio::system_category());
+	}
+
+	if (ec)
+	{
+		return;
+	}
+
+	// Syncing the directory makes the rename itself durable
+	std::size_t slash = path_.rfind('/');
+	std::string directory = (slash == std::string::npos) ? std::string(".") : (slash == 0 ? std::string("/") : path_.substr(0, slash));
+	int directory_fd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (directory_fd != -1)
+	{
+		::fsync(directory_fd);
+		::close(directory_fd);
+	}
+#else
+	// Renaming over an existing file fails here, which leaves a moment without a journal; a crash then merely costs the progress made
+	{
+		std::ofstream file(temp_path.c_str(), std::ios::binary | std::ios::trunc);
+		file.write(contents.data(), contents.size());
+		file.flush();
+
+		if (!file)
+		{
+			ec = asio::error::no_space;
+			return;
+		}
+	}
+
+	std::remove(path_.c_str());
+
+	if (std::rename(temp_path.c_str(), path_.c_str()) != 0)
+	{
+		ec = asio::error_code(errno, asio::system_category());
+	}
+#endif
+}
+
+void download_journal::remove()
+{
+	std::remove(path_.c_str());
+}
+
+void download_journal::reset(std::uint64_t size, const std::string& etag, const std::string& last_modified)
+{
+	size_ = size;
+	etag_ = etag;
+	last_modified_ = last_modified;
+	completed_.clear();
+}
+
+bool download_journal::matches(std::uint64_t size, const std::string& etag, const std::string& last_modified) const
+{
+	return size_ == size && etag_ == etag && last_modified_ == last_modified;
+}
+
+void download_journal::add_completed(std::uint64_t first, std::uint64_t end)
+{
+	if (first >= end)
+	{
+		return;
+	}
+
+	// Every range ending before first stays as it is, and every range from there on which touches [first, end) is merged into it
+	std::vector<range_type>::iterator it = completed_.begin();
+
+	while (it != completed_.end() && it->second < first)
+	{
+		++it;
+	}
+
+	std::vector<range_type>::iterator last = it;
+
+	while (last != completed_.end() && last->first <= end)
+	{
+		first = std::min(first, last->first);
+		end = std::max(end, last->second);
+		++last;
+	}
+
+	it = completed_.erase(it, last);
+	completed_.insert(it, range_type(first, end));
+}
+
+std::uint64_t download_journal::get_completed_bytes() const
+{
+	std::uint64_t bytes = 0;
+
+	for (std::size_t i = 0; i < completed_.size(); ++i)
+	{
+		bytes += completed_[i].second - completed_[i].first;
+	}
+
+	return bytes;
+}
+
+std::vector<download_journal::range_type> download_journal::get_missing() const
+{
+	std::vector<range_type> missing;
+	std::uint64_t position = 0;
+
+	for (std::size_t i = 0; i < completed_.size(); ++i)
+	{
+		if (completed_[i].first > position)
+		{
+			missing.push_back(range_type(position, completed_[i].first));
+		}
+
+		position = std::max(position, completed_[i].second);
+	}
+
+	if (position < size_)
+	{
+		missing.push_back(range_type(position, size_));
+	}
+
+	return missing;
+}
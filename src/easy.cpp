@@ -6,15 +6,63 @@
 	C++ wrapper for libcurl's easy interface
 */
 
+#include <curl-asio/bandwidth_shaper.h>
+#include <curl-asio/byterange_sink.h>
+#include <curl-asio/checksum.h>
+#include <curl-asio/disk_writer.h>
 #include <curl-asio/easy.h>
+#include <curl-asio/encoder.h>
 #include <curl-asio/error_code.h>
+#include <curl-asio/file_source.h>
 #include <curl-asio/form.h>
+#include <curl-asio/hedging.h>
 #include <curl-asio/multi.h>
+#include <curl-asio/origin.h>
+#include <curl-asio/pipeline.h>
+#include <curl-asio/record_sink.h>
+#include <curl-asio/retry.h>
 #include <curl-asio/share.h>
+#include <curl-asio/spill_buffer.h>
 #include <curl-asio/string_list.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 
 using namespace curl;
 
+// Request bodies are read in pieces of this size for the encoder
+static const std::size_t encoder_input_size = 65536;
+
+static std::string trim(const std::string& str)
+{
+	std::size_t begin = str.find_first_not_of(" \t\r\n");
+
+	if (begin == std::string::npos)
+	{
+		return std::string();
+	}
+
+	return str.substr(begin, str.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+static bool equals_ignore_case(const std::string& a, const std::string& b)
+{
+	if (a.size() != b.size())
+	{
+		return false;
+	}
+
+	for (std::size_t i = 0; i < a.size(); ++i)
+	{
+		if (::tolower(static_cast<unsigned char>(a[i])) != ::tolower(static_cast<unsigned char>(b[i])))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 easy* easy::from_native(native::CURL* native_easy)
 {
 	easy* easy_handle;
@@ -25,7 +73,28 @@ easy* easy::from_native(native::CURL* native_easy)
 easy::easy(asio::io_service& io_service):
 	io_service_(io_service),
 	multi_(0),
-	multi_registered_(false)
+	multi_registered_(false),
+	source_offset_(0),
+	post_buffers_size_(0),
+	post_buffers_index_(0),
+	post_buffers_base_(0),
+	encoder_input_begin_(0),
+	encoder_input_end_(0),
+	encoder_input_eof_(false),
+	buffer_sink_function_(0),
+	buffer_sink_context_(0),
+	buffer_sink_by_library_(false),
+	header_capture_(false),
+	body_streaming_(false),
+	upload_streaming_(false),
+	attempts_(0),
+	retry_acquired_(false),
+	response_started_(false),
+	response_discarded_(false),
+	response_delivered_(false),
+	bandwidth_weight_(1),
+	recv_pause_holders_(0),
+	send_pause_holders_(0)
 {
 	init();
 }
@@ -33,11 +102,121 @@ easy::easy(asio::io_service& io_service):
 easy::easy(multi& multi_handle):
 	io_service_(multi_handle.get_io_service()),
 	multi_(&multi_handle),
-	multi_registered_(false)
+	multi_registered_(false),
+	source_offset_(0),
+	post_buffers_size_(0),
+	post_buffers_index_(0),
+	post_buffers_base_(0),
+	encoder_input_begin_(0),
+	encoder_input_end_(0),
+	encoder_input_eof_(false),
+	buffer_sink_function_(0),
+	buffer_sink_context_(0),
+	buffer_sink_by_library_(false),
+	header_capture_(false),
+	body_streaming_(false),
+	upload_streaming_(false),
+	attempts_(0),
+	retry_acquired_(false),
+	response_started_(false),
+	response_discarded_(false),
+	response_delivered_(false),
+	bandwidth_weight_(1),
+	recv_pause_holders_(0),
+	send_pause_holders_(0)
 {
 	init();
 }
 
+easy::easy(easy& prototype, native::CURL* native_easy):
+	io_service_(prototype.io_service_),
+	initref_(prototype.initref_),
+	handle_(native_easy),
+	multi_(prototype.multi_),
+	multi_registered_(false),
+	url_(prototype.url_),
+	source_(prototype.source_),
+	file_source_(prototype.file_source_),
+	source_offset_(0),
+	post_buffers_(prototype.post_buffers_),
+	post_buffers_size_(prototype.post_buffers_size_),
+	post_buffers_index_(0),
+	post_buffers_base_(0),
+	encoder_(prototype.encoder_ ? std::make_shared<encoder>(prototype.encoder_->get_coding(), prototype.encoder_->get_level()) : std::shared_ptr<encoder>()),
+	encoder_input_begin_(0),
+	encoder_input_end_(0),
+	encoder_input_eof_(false),
+	encoded_headers_(prototype.encoded_headers_),
+	sink_(prototype.sink_),
+	buffer_sink_function_(prototype.buffer_sink_function_),
+	buffer_sink_context_(prototype.buffer_sink_context_),
+	buffer_sink_owner_(prototype.buffer_sink_owner_),
+	buffer_sink_by_library_(prototype.buffer_sink_by_library_),
+	fetch_body_(prototype.fetch_body_),
+	fetch_chain_(prototype.fetch_chain_),
+	spill_sink_(prototype.spill_sink_),
+	file_sink_(prototype.file_sink_),
+	pipeline_(prototype.pipeline_),
+	record_sink_(prototype.record_sink_),
+	byterange_sink_(prototype.byterange_sink_),
+	checksums_(prototype.checksums_),
+	header_capture_(prototype.header_capture_),
+	body_stream_(prototype.body_stream_),
+	body_streaming_(prototype.body_streaming_),
+	upload_stream_(prototype.upload_stream_),
+	upload_streaming_(prototype.upload_streaming_),
+	post_fields_(prototype.post_fields_),
+	form_(prototype.form_),
+	headers_(prototype.headers_),
+	http200_aliases_(prototype.http200_aliases_),
+	mail_rcpts_(prototype.mail_rcpts_),
+	quotes_(prototype.quotes_),
+	resolved_hosts_(prototype.resolved_hosts_),
+	connect_to_(prototype.connect_to_),
+	endpoint_(prototype.endpoint_),
+	share_(prototype.share_),
+	telnet_options_(prototype.telnet_options_),
+	progress_callback_(prototype.progress_callback_),
+	attempts_(0),
+	retry_acquired_(false),
+	response_started_(false),
+	response_discarded_(false),
+	response_delivered_(false),
+	rate_limit_key_(prototype.rate_limit_key_),
+	bandwidth_class_(prototype.bandwidth_class_),
+	bandwidth_weight_(prototype.bandwidth_weight_),
+	recv_pause_holders_(0),
+	send_pause_holders_(0)
+{
+	// curl_easy_duphandle copies the callback data pointers verbatim, hence they have to be pointed at this object. String lists, forms and post fields are not copied by libcurl, which is why the references to them are shared with the prototype.
+	set_private(this);
+
+	if (sink_ || buffer_sink_function_ || fetch_body_ || fetch_chain_ || spill_sink_ || file_sink_ || pipeline_ || record_sink_ || byterange_sink_ || body_streaming_ || !checksums_.empty())
+	{
+		set_write_data(this);
+	}
+
+	if (header_capture_)
+	{
+		set_header_data(this);
+	}
+
+	if (source_ || file_source_ || post_buffers_ || upload_streaming_)
+	{
+		set_read_data(this);
+		set_seek_data(this);
+	}
+
+	if (progress_callback_)
+	{
+#if LIBCURL_VERSION_NUM < 0x072000
+		set_progress_data(this);
+#else
+		set_xferinfo_data(this);
+#endif
+	}
+}
+
 easy::~easy()
 {
 	cancel();
@@ -49,6 +228,18 @@ easy::~easy()
 	}
 }
 
+std::shared_ptr<easy> easy::duplicate()
+{
+	native::CURL* native_easy = native::curl_easy_duphandle(handle_);
+
+	if (!native_easy)
+	{
+		throw std::bad_alloc();
+	}
+
+	return std::shared_ptr<easy>(new easy(*this, native_easy));
+}
+
 void easy::perform()
 {
 	asio::error_code ec;
@@ -63,15 +254,56 @@ void easy::perform(asio::error_code& ec)
 		throw std::runtime_error("attempt to perform synchronous operation while being attached to a multi object");
 	}
 
+	source_offset_ = 0;
+	hedge_winner_.reset();
+	recv_pause_holders_ = 0;
+	send_pause_holders_ = 0;
+	response_headers_.clear();
+	reset_checksums();
+
+	if (record_sink_)
+	{
+		record_sink_->reset();
+	}
+
+	if (byterange_sink_)
+	{
+		byterange_sink_->reset();
+	}
+
+	if (spill_sink_)
+	{
+		spill_sink_->clear();
+	}
+
+	apply_upload_encoding(ec);
+
+	if (ec)
+	{
+		return;
+	}
+
 	ec = asio::error_code(native::curl_easy_perform(handle_), asio::system_category());
 
 	if (sink_)
 	{
 		sink_->flush();
 	}
+
+	if (!ec && !verify_checksums())
+	{
+		ec = errc::wrapper::make_error_code(errc::wrapper::checksum_mismatch);
+	}
+
+	finish_sinks(ec);
 }
 
 void easy::async_perform(handler_type handler)
+{
+	start_async_perform(handler, std::shared_ptr<hedged_request>());
+}
+
+void easy::start_async_perform(handler_type handler, std::shared_ptr<hedged_request> hedge)
 {
 	if (!multi_)
 	{
@@ -91,189 +323,767 @@ void easy::async_perform(handler_type handler)
 
 	handler_ = handler;
 	multi_registered_ = true;
+	hedge_ = hedge;
+	hedge_winner_.reset();
+	attempts_ = 1;
+	retry_acquired_ = false;
+	retry_delay_ = std::chrono::steady_clock::duration::zero();
+	recv_pause_holders_ = 0;
+	send_pause_holders_ = 0;
+	response_started_ = false;
+	response_discarded_ = false;
+	response_delivered_ = false;
+	response_headers_.clear();
+	reset_checksums();
+
+	if (body_streaming_)
+	{
+		body_stream_->reset();
+	}
+
+	if (pipeline_)
+	{
+		pipeline_->reset();
+	}
+
+	if (record_sink_)
+	{
+		record_sink_->reset();
+	}
+
+	if (byterange_sink_)
+	{
+		byterange_sink_->reset();
+	}
+
+	if (spill_sink_)
+	{
+		spill_sink_->clear();
+	}
+
+	if (upload_streaming_)
+	{
+		upload_stream_->reset();
+	}
+
+	source_offset_ = 0;
+
+	asio::error_code ec;
+	apply_upload_encoding(ec);
+
+	if (ec)
+	{
+		multi_registered_ = false;
+		io_service_.post(std::bind(handler_, ec));
+		return;
+	}
+
+	// Both attempts of a hedged request read the body, which only works for bodies that can be replayed: file sources, post buffers and post fields, but not streams
+	if (!hedge_ && hedging_policy_ && !source_ && !upload_streaming_)
+	{
+		hedge_ = std::make_shared<hedged_request>(*this, hedging_policy_);
+		hedge_->start();
+	}
 
 	// Registering the easy handle with the multi handle might invoke a set of callbacks right away which cause the completion event to fire from within this function.
 	multi_->add(this);
 }
 
-void easy::cancel()
+void easy::async_fetch(fetch_handler_type handler)
 {
-	if (multi_registered_)
-	{
-		handle_completion(asio::error_code(asio::error::operation_aborted));
-		multi_->remove(this);
-	}
+	clear_sinks();
+	fetch_body_ = std::make_shared<std::string>();
+	set_write_function(&easy::write_function);
+	set_write_data(this);
+
+	async_perform(std::bind(&easy::handle_fetch, fetch_body_, handler, std::placeholders::_1));
 }
 
-void easy::set_source(std::shared_ptr<std::istream> source)
+void easy::async_fetch_chain(fetch_chain_handler_type handler)
 {
-	asio::error_code ec;
-	set_source(source, ec);
-	asio::detail::throw_error(ec, "set_source");
+	if (!multi_)
+	{
+		throw std::runtime_error("attempt to perform async. operation without assigning a multi object");
+	}
+
+	clear_sinks();
+	fetch_chain_ = std::make_shared<chunk_chain>(multi_->get_buffer_pool());
+	set_write_function(&easy::write_function);
+	set_write_data(this);
+
+	async_perform(std::bind(&easy::handle_fetch_chain, fetch_chain_, handler, std::placeholders::_1));
 }
 
-void easy::set_source(std::shared_ptr<std::istream> source, asio::error_code& ec)
+curl::body_stream& easy::body_stream()
 {
-	source_ = source;
-	set_read_function(&easy::read_function, ec);
-	if (!ec) set_read_data(this, ec);
-	if (!ec) set_seek_function(&easy::seek_function, ec);
-	if (!ec) set_seek_data(this, ec);
+	if (!body_streaming_)
+	{
+		clear_sinks();
+		body_streaming_ = true;
+
+		if (!body_stream_)
+		{
+			body_stream_ = std::make_shared<curl::body_stream>(io_service_);
+		}
+
+		set_write_function(&easy::write_function);
+		set_write_data(this);
+	}
+
+	return *body_stream_;
 }
 
-void easy::set_sink(std::shared_ptr<std::ostream> sink)
+curl::upload_stream& easy::upload_stream(native::curl_off_t size)
 {
 	asio::error_code ec;
-	set_sink(sink, ec);
-	asio::detail::throw_error(ec, "set_sink");
+	curl::upload_stream& stream = upload_stream(size, ec);
+	asio::detail::throw_error(ec, "upload_stream");
+	return stream;
 }
 
-void easy::set_sink(std::shared_ptr<std::ostream> sink, asio::error_code& ec)
+curl::upload_stream& easy::upload_stream(native::curl_off_t size, asio::error_code& ec)
 {
-	sink_ = sink;
-	set_write_function(&easy::write_function);
-	if (!ec) set_write_data(this);
-}
+	source_.reset();
+	file_source_.reset();
+	post_buffers_.reset();
+	upload_streaming_ = true;
 
-void easy::unset_progress_callback()
-{
-	set_no_progress(true);
-#if LIBCURL_VERSION_NUM < 0x072000
-	set_progress_function(0);
-	set_progress_data(0);
-#else
-	set_xferinfo_function(0);
-	set_xferinfo_data(0);
-#endif
+	if (!upload_stream_)
+	{
+		upload_stream_ = std::make_shared<curl::upload_stream>(io_service_);
+	}
+
+	// Without a size, libcurl falls back to chunked transfer encoding for both POST and PUT
+	set_read_function(&easy::read_function, ec);
+	if (!ec) set_read_data(this, ec);
+	if (!ec) set_seek_function(0, ec);
+	if (!ec) set_post_field_size_large(size, ec);
+	if (!ec) set_in_file_size_large(size, ec);
+
+	return *upload_stream_;
 }
 
-void easy::set_progress_callback(progress_callback_t progress_callback)
+void easy::cancel()
 {
-	progress_callback_ = progress_callback;
-	set_no_progress(false);
-#if LIBCURL_VERSION_NUM < 0x072000
-	set_progress_function(&easy::progress_function);
-	set_progress_data(this);
-#else
-	set_xferinfo_function(&easy::xferinfo_function);
-	set_xferinfo_data(this);
-#endif
+	if (multi_registered_)
+	{
+		handle_completion(asio::error_code(asio::error::operation_aborted));
+		multi_->remove(this);
+	}
 }
 
-void easy::set_post_fields(const std::string& post_fields)
+void easy::pause(int bitmask)
 {
 	asio::error_code ec;
-	set_post_fields(post_fields, ec);
-	asio::detail::throw_error(ec, "set_post_fields");
+	pause(bitmask, ec);
+	asio::detail::throw_error(ec, "pause");
 }
 
-void easy::set_post_fields(const std::string& post_fields, asio::error_code& ec)
+void easy::pause(int bitmask, asio::error_code& ec)
 {
-	post_fields_ = post_fields;
-	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_POSTFIELDS, post_fields_.c_str()), asio::system_category());
+	if (bitmask & pause_recv)
+	{
+		recv_pause_holders_ |= pause_by_user;
+	}
+	else
+	{
+		recv_pause_holders_ &= ~pause_by_user;
+	}
 
-	if (!ec)
-		set_post_field_size_large(static_cast<native::curl_off_t>(post_fields_.length()), ec);
+	if (bitmask & pause_send)
+	{
+		send_pause_holders_ |= pause_by_user;
+	}
+	else
+	{
+		send_pause_holders_ &= ~pause_by_user;
+	}
+
+	ec = asio::error_code(native::curl_easy_pause(handle_, paused_directions()), asio::system_category());
 }
 
-void easy::set_http_post(std::shared_ptr<form> form)
+void easy::release_pause(int bitmask, pause_holder holder)
 {
 	asio::error_code ec;
-	set_http_post(form, ec);
-	asio::detail::throw_error(ec, "set_http_post");
+	release_pause(bitmask, holder, ec);
+	asio::detail::throw_error(ec, "release_pause");
 }
 
-void easy::set_http_post(std::shared_ptr<form> form, asio::error_code& ec)
+void easy::release_pause(int bitmask, pause_holder holder, asio::error_code& ec)
 {
-	form_ = form;
+	int paused = paused_directions();
 
-	if (form_)
+	if (bitmask & pause_recv)
 	{
-		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPPOST, form_->native_handle()), asio::system_category());
+		recv_pause_holders_ &= ~holder;
 	}
-	else
+
+	if (bitmask & pause_send)
 	{
-		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPPOST, NULL), asio::system_category());
+		send_pause_holders_ &= ~holder;
+	}
+
+	ec = asio::error_code();
+
+	if (paused_directions() != paused)
+	{
+		// libcurl might invoke the callbacks of the resumed directions from within curl_easy_pause, which take their holds again if they pause once more
+		ec = asio::error_code(native::curl_easy_pause(handle_, paused_directions()), asio::system_category());
 	}
 }
 
-void easy::add_header(const std::string& name, const std::string& value)
+void easy::hold_pause(int bitmask, pause_holder holder)
 {
-	asio::error_code ec;
-	add_header(name, value, ec);
-	asio::detail::throw_error(ec, "add_header");
+	if (bitmask & pause_recv)
+	{
+		recv_pause_holders_ |= holder;
+	}
+
+	if (bitmask & pause_send)
+	{
+		send_pause_holders_ |= holder;
+	}
 }
 
-void easy::add_header(const std::string& name, const std::string& value, asio::error_code& ec)
+int easy::paused_directions() const
 {
-	add_header(name + ": " + value, ec);
+	return (recv_pause_holders_ ? pause_recv : 0) | (send_pause_holders_ ? pause_send : 0);
 }
 
-void easy::add_header(const std::string& header)
+void easy::set_source(std::shared_ptr<std::istream> source)
 {
 	asio::error_code ec;
-	add_header(header, ec);
-	asio::detail::throw_error(ec, "add_header");
+	set_source(source, ec);
+	asio::detail::throw_error(ec, "set_source");
 }
 
-void easy::add_header(const std::string& header, asio::error_code& ec)
+void easy::set_source(std::shared_ptr<std::istream> source, asio::error_code& ec)
 {
-	if (!headers_)
-	{
-		headers_ = std::make_shared<string_list>();
-	}
-
-	headers_->add(header);
-	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPHEADER, headers_->native_handle()), asio::system_category());
+	source_ = source;
+	file_source_.reset();
+	post_buffers_.reset();
+	upload_streaming_ = false;
+	set_read_function(&easy::read_function, ec);
+	if (!ec) set_read_data(this, ec);
+	if (!ec) set_seek_function(&easy::seek_function, ec);
+	if (!ec) set_seek_data(this, ec);
 }
 
-void easy::set_headers(std::shared_ptr<string_list> headers)
+void easy::set_file_source(std::shared_ptr<file_source> source)
 {
 	asio::error_code ec;
-	set_headers(headers, ec);
-	asio::detail::throw_error(ec, "set_headers");
+	set_file_source(source, ec);
+	asio::detail::throw_error(ec, "set_file_source");
 }
 
-void easy::set_headers(std::shared_ptr<string_list> headers, asio::error_code& ec)
+void easy::set_file_source(std::shared_ptr<file_source> source, asio::error_code& ec)
 {
-	headers_ = headers;
+	source_.reset();
+	file_source_ = source;
+	source_offset_ = 0;
+	post_buffers_.reset();
+	upload_streaming_ = false;
+	set_read_function(&easy::read_function, ec);
+	if (!ec) set_read_data(this, ec);
+	if (!ec) set_seek_function(&easy::seek_function, ec);
+	if (!ec) set_seek_data(this, ec);
 
-	if (headers_)
-	{
-		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPHEADER, headers_->native_handle()), asio::system_category());
-	}
-	else
-	{
-		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPHEADER, NULL), asio::system_category());
-	}
+	// Without a source, the body is empty just like with set_source
+	if (!ec && source) set_post_field_size_large(source->get_size(), ec);
+	if (!ec && source) set_in_file_size_large(source->get_size(), ec);
 }
 
-void easy::add_http200_alias(const std::string& http200_alias)
+void easy::set_upload_encoding(encoder::coding coding, int level)
 {
 	asio::error_code ec;
-	add_http200_alias(http200_alias, ec);
-	asio::detail::throw_error(ec, "add_http200_alias");
+	set_upload_encoding(coding, level, ec);
+	asio::detail::throw_error(ec, "set_upload_encoding");
 }
 
-void easy::add_http200_alias(const std::string& http200_alias, asio::error_code& ec)
+void easy::set_upload_encoding(encoder::coding coding, int level, asio::error_code& ec)
 {
-	if (!http200_aliases_)
+	if (!encoder::is_supported(coding))
 	{
-		http200_aliases_ = std::make_shared<string_list>();
+		ec = asio::error::operation_not_supported;
+		return;
 	}
 
-	http200_aliases_->add(http200_alias);
-	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTP200ALIASES, http200_aliases_->native_handle()), asio::system_category());
+	encoder_ = std::make_shared<encoder>(coding, level);
+	ec = asio::error_code();
 }
 
-void easy::set_http200_aliases(std::shared_ptr<string_list> http200_aliases)
+void easy::clear_upload_encoding()
 {
 	asio::error_code ec;
-	set_http200_aliases(http200_aliases, ec);
-	asio::detail::throw_error(ec, "set_http200_aliases");
+	clear_upload_encoding(ec);
+	asio::detail::throw_error(ec, "clear_upload_encoding");
 }
 
-void easy::set_http200_aliases(std::shared_ptr<string_list> http200_aliases, asio::error_code& ec)
+void easy::clear_upload_encoding(asio::error_code& ec)
+{
+	encoder_.reset();
+	encoder_input_.clear();
+	apply_upload_encoding(ec);
+}
+
+void easy::set_sink(std::shared_ptr<std::ostream> sink)
+{
+	asio::error_code ec;
+	set_sink(sink, ec);
+	asio::detail::throw_error(ec, "set_sink");
+}
+
+void easy::set_sink(std::shared_ptr<std::ostream> sink, asio::error_code& ec)
+{
+	clear_sinks();
+	sink_ = sink;
+	set_write_function(&easy::write_function, ec);
+	if (!ec) set_write_data(this, ec);
+}
+
+void easy::set_spill_sink(std::shared_ptr<spill_buffer> sink)
+{
+	asio::error_code ec;
+	set_spill_sink(sink, ec);
+	asio::detail::throw_error(ec, "set_spill_sink");
+}
+
+void easy::set_spill_sink(std::shared_ptr<spill_buffer> sink, asio::error_code& ec)
+{
+	clear_sinks();
+	spill_sink_ = sink;
+	set_write_function(&easy::write_function, ec);
+	if (!ec) set_write_data(this, ec);
+}
+
+void easy::set_pipeline(std::shared_ptr<curl::pipeline> pipeline)
+{
+	asio::error_code ec;
+	set_pipeline(pipeline, ec);
+	asio::detail::throw_error(ec, "set_pipeline");
+}
+
+void easy::set_pipeline(std::shared_ptr<curl::pipeline> pipeline, asio::error_code& ec)
+{
+	clear_sinks();
+	pipeline_ = pipeline;
+	set_write_function(&easy::write_function, ec);
+	if (!ec) set_write_data(this, ec);
+}
+
+void easy::set_record_sink(std::shared_ptr<record_sink> sink)
+{
+	asio::error_code ec;
+	set_record_sink(sink, ec);
+	asio::detail::throw_error(ec, "set_record_sink");
+}
+
+void easy::set_record_sink(std::shared_ptr<record_sink> sink, asio::error_code& ec)
+{
+	clear_sinks();
+	record_sink_ = sink;
+	set_write_function(&easy::write_function, ec);
+	if (!ec) set_write_data(this, ec);
+}
+
+void easy::set_byterange_sink(std::shared_ptr<byterange_sink> sink)
+{
+	asio::error_code ec;
+	set_byterange_sink(sink, ec);
+	asio::detail::throw_error(ec, "set_byterange_sink");
+}
+
+void easy::set_byterange_sink(std::shared_ptr<byterange_sink> sink, asio::error_code& ec)
+{
+	clear_sinks();
+
+	if (!header_capture_)
+	{
+		set_header_capture(true, ec);
+		if (ec) return;
+	}
+
+	byterange_sink_ = sink;
+	set_write_function(&easy::write_function, ec);
+	if (!ec) set_write_data(this, ec);
+}
+
+void easy::set_header_capture(bool enabled)
+{
+	asio::error_code ec;
+	set_header_capture(enabled, ec);
+	asio::detail::throw_error(ec, "set_header_capture");
+}
+
+void easy::set_header_capture(bool enabled, asio::error_code& ec)
+{
+	header_capture_ = enabled;
+	response_headers_.clear();
+
+	if (enabled)
+	{
+		set_header_function(&easy::header_function, ec);
+		if (!ec) set_header_data(this, ec);
+	}
+	else
+	{
+		// libcurl passes headers to the write function as long as header data is set
+		set_header_function(0, ec);
+		if (!ec) set_header_data(0, ec);
+	}
+}
+
+std::string easy::get_response_header(const std::string& name) const
+{
+	std::string value;
+
+	for (std::size_t i = 0; i < response_headers_.size(); ++i)
+	{
+		if (equals_ignore_case(response_headers_[i].first, name))
+		{
+			if (!value.empty())
+			{
+				value += ", ";
+			}
+
+			value += response_headers_[i].second;
+		}
+	}
+
+	return value;
+}
+
+void easy::add_checksum(std::shared_ptr<checksum> sum, const std::string& expected)
+{
+	asio::error_code ec;
+	add_checksum(sum, expected, ec);
+	asio::detail::throw_error(ec, "add_checksum");
+}
+
+void easy::add_checksum(std::shared_ptr<checksum> sum, const std::string& expected, asio::error_code& ec)
+{
+	std::string digest;
+
+	if (!expected.empty())
+	{
+		digest = checksum::parse_hex_digest(sum->get_algorithm(), expected);
+
+		if (digest.empty())
+		{
+			ec = asio::error::invalid_argument;
+			return;
+		}
+	}
+	else if (!header_capture_)
+	{
+		set_header_capture(true, ec);
+		if (ec) return;
+	}
+
+	set_write_function(&easy::write_function, ec);
+	if (!ec) set_write_data(this, ec);
+	if (!ec) checksums_.push_back(std::make_pair(sum, digest));
+}
+
+void easy::clear_checksums()
+{
+	checksums_.clear();
+}
+
+void easy::set_file_sink(std::shared_ptr<file_sink> sink)
+{
+	asio::error_code ec;
+	set_file_sink(sink, ec);
+	asio::detail::throw_error(ec, "set_file_sink");
+}
+
+void easy::set_file_sink(std::shared_ptr<file_sink> sink, asio::error_code& ec)
+{
+	clear_sinks();
+	file_sink_ = sink;
+	set_write_function(&easy::write_function, ec);
+	if (!ec) set_write_data(this, ec);
+}
+
+void easy::set_buffer_sink(buffer_sink_function_t function, void* context, std::shared_ptr<void> owner, asio::error_code& ec)
+{
+	clear_sinks();
+	buffer_sink_function_ = function;
+	buffer_sink_context_ = context;
+	buffer_sink_owner_ = owner;
+	set_write_function(&easy::write_function, ec);
+	if (!ec) set_write_data(this, ec);
+}
+
+void easy::unset_progress_callback()
+{
+	set_no_progress(true);
+#if LIBCURL_VERSION_NUM < 0x072000
+	set_progress_function(0);
+	set_progress_data(0);
+#else
+	set_xferinfo_function(0);
+	set_xferinfo_data(0);
+#endif
+}
+
+void easy::set_progress_callback(progress_callback_t progress_callback)
+{
+	progress_callback_ = progress_callback;
+	set_no_progress(false);
+#if LIBCURL_VERSION_NUM < 0x072000
+	set_progress_function(&easy::progress_function);
+	set_progress_data(this);
+#else
+	set_xferinfo_function(&easy::xferinfo_function);
+	set_xferinfo_data(this);
+#endif
+}
+
+void easy::set_hedging_policy(std::shared_ptr<hedging_policy> policy)
+{
+	hedging_policy_ = policy;
+}
+
+void easy::set_retry_policy(std::shared_ptr<retry_policy> policy)
+{
+	retry_policy_ = policy;
+}
+
+void easy::set_rate_limit_key(const std::string& key)
+{
+	rate_limit_key_ = key;
+}
+
+void easy::set_bandwidth_class(const std::string& class_key)
+{
+	bandwidth_class_ = class_key;
+}
+
+void easy::set_bandwidth_weight(unsigned int weight)
+{
+	bandwidth_weight_ = weight;
+}
+
+void easy::set_url(const char* url)
+{
+	asio::error_code ec;
+	set_url(url, ec);
+	asio::detail::throw_error(ec, "set_url");
+}
+
+void easy::set_url(const char* url, asio::error_code& ec)
+{
+	url_ = url ? url : "";
+	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_URL, url), asio::system_category());
+}
+
+void easy::set_url(const std::string& url)
+{
+	asio::error_code ec;
+	set_url(url, ec);
+	asio::detail::throw_error(ec, "set_url");
+}
+
+void easy::set_url(const std::string& url, asio::error_code& ec)
+{
+	set_url(url.c_str(), ec);
+}
+
+void easy::set_post_fields(const std::string& post_fields)
+{
+	asio::error_code ec;
+	set_post_fields(post_fields, ec);
+	asio::detail::throw_error(ec, "set_post_fields");
+}
+
+void easy::set_post_fields(const std::string& post_fields, asio::error_code& ec)
+{
+	set_post_fields(std::make_shared<const std::string>(post_fields), ec);
+}
+
+void easy::set_post_fields(std::shared_ptr<const std::string> post_fields)
+{
+	asio::error_code ec;
+	set_post_fields(post_fields, ec);
+	asio::detail::throw_error(ec, "set_post_fields");
+}
+
+void easy::set_post_fields(std::shared_ptr<const std::string> post_fields, asio::error_code& ec)
+{
+	if (post_fields)
+	{
+		set_post_fields(asio::buffer(*post_fields), post_fields, ec);
+	}
+	else
+	{
+		post_fields_.reset();
+		post_buffers_.reset();
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_POSTFIELDS, NULL), asio::system_category());
+
+		if (!ec)
+			set_post_field_size_large(-1, ec);
+	}
+}
+
+void easy::set_post_fields(std::string&& post_fields)
+{
+	asio::error_code ec;
+	set_post_fields(std::move(post_fields), ec);
+	asio::detail::throw_error(ec, "set_post_fields");
+}
+
+void easy::set_post_fields(std::string&& post_fields, asio::error_code& ec)
+{
+	set_post_fields(std::make_shared<const std::string>(std::move(post_fields)), ec);
+}
+
+void easy::set_post_fields(asio::const_buffer post_fields, std::shared_ptr<const void> owner)
+{
+	asio::error_code ec;
+	set_post_fields(post_fields, owner, ec);
+	asio::detail::throw_error(ec, "set_post_fields");
+}
+
+void easy::set_post_fields(asio::const_buffer post_fields, std::shared_ptr<const void> owner, asio::error_code& ec)
+{
+	// libcurl does not copy CURLOPT_POSTFIELDS, so the body can be shared by any number of easy handles
+	post_fields_ = owner;
+	post_buffers_.reset();
+
+	// A null pointer would make libcurl fall back to the read callback, even for an empty body
+	const char* data = asio::buffer_cast<const char*>(post_fields);
+	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_POSTFIELDS, data ? data : ""), asio::system_category());
+
+	if (!ec)
+		set_post_field_size_large(static_cast<native::curl_off_t>(asio::buffer_size(post_fields)), ec);
+}
+
+void easy::set_post_buffer_list(std::shared_ptr<const std::vector<asio::const_buffer> > buffers, std::shared_ptr<const void> owner, asio::error_code& ec)
+{
+	source_.reset();
+	file_source_.reset();
+	upload_streaming_ = false;
+	post_fields_ = owner;
+	post_buffers_ = buffers;
+	post_buffers_size_ = 0;
+	post_buffers_index_ = 0;
+	post_buffers_base_ = 0;
+	source_offset_ = 0;
+
+	for (std::vector<asio::const_buffer>::const_iterator it = buffers->begin(); it != buffers->end(); ++it)
+	{
+		post_buffers_size_ += static_cast<native::curl_off_t>(asio::buffer_size(*it));
+	}
+
+	// CURLOPT_POSTFIELDS would take precedence over the read callback
+	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_POSTFIELDS, NULL), asio::system_category());
+	if (!ec) set_post(true, ec);
+	if (!ec) set_read_function(&easy::read_function, ec);
+	if (!ec) set_read_data(this, ec);
+	if (!ec) set_seek_function(&easy::seek_function, ec);
+	if (!ec) set_seek_data(this, ec);
+	if (!ec) set_post_field_size_large(post_buffers_size_, ec);
+}
+
+void easy::set_http_post(std::shared_ptr<form> form)
+{
+	asio::error_code ec;
+	set_http_post(form, ec);
+	asio::detail::throw_error(ec, "set_http_post");
+}
+
+void easy::set_http_post(std::shared_ptr<form> form, asio::error_code& ec)
+{
+	form_ = form;
+
+	if (form_)
+	{
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPPOST, form_->native_handle()), asio::system_category());
+	}
+	else
+	{
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPPOST, NULL), asio::system_category());
+	}
+}
+
+void easy::add_header(const std::string& name, const std::string& value)
+{
+	asio::error_code ec;
+	add_header(name, value, ec);
+	asio::detail::throw_error(ec, "add_header");
+}
+
+void easy::add_header(const std::string& name, const std::string& value, asio::error_code& ec)
+{
+	add_header(name + ": " + value, ec);
+}
+
+void easy::add_header(const std::string& header)
+{
+	asio::error_code ec;
+	add_header(header, ec);
+	asio::detail::throw_error(ec, "add_header");
+}
+
+void easy::add_header(const std::string& header, asio::error_code& ec)
+{
+	if (!headers_)
+	{
+		headers_ = std::make_shared<string_list>();
+	}
+
+	headers_->add(header);
+	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPHEADER, headers_->native_handle()), asio::system_category());
+}
+
+void easy::set_headers(std::shared_ptr<string_list> headers)
+{
+	asio::error_code ec;
+	set_headers(headers, ec);
+	asio::detail::throw_error(ec, "set_headers");
+}
+
+void easy::set_headers(std::shared_ptr<string_list> headers, asio::error_code& ec)
+{
+	headers_ = headers;
+
+	if (headers_)
+	{
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPHEADER, headers_->native_handle()), asio::system_category());
+	}
+	else
+	{
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPHEADER, NULL), asio::system_category());
+	}
+}
+
+void easy::add_http200_alias(const std::string& http200_alias)
+{
+	asio::error_code ec;
+	add_http200_alias(http200_alias, ec);
+	asio::detail::throw_error(ec, "add_http200_alias");
+}
+
+void easy::add_http200_alias(const std::string& http200_alias, asio::error_code& ec)
+{
+	if (!http200_aliases_)
+	{
+		http200_aliases_ = std::make_shared<string_list>();
+	}
+
+	http200_aliases_->add(http200_alias);
+	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTP200ALIASES, http200_aliases_->native_handle()), asio::system_category());
+}
+
+void easy::set_http200_aliases(std::shared_ptr<string_list> http200_aliases)
+{
+	asio::error_code ec;
+	set_http200_aliases(http200_aliases, ec);
+	asio::detail::throw_error(ec, "set_http200_aliases");
+}
+
+void easy::set_http200_aliases(std::shared_ptr<string_list> http200_aliases, asio::error_code& ec)
 {
 	http200_aliases_ = http200_aliases;
 
@@ -404,87 +1214,422 @@ void easy::set_resolves(std::shared_ptr<string_list> resolved_hosts, asio::error
 	}
 }
 
-void easy::set_share(std::shared_ptr<share> share)
+#if LIBCURL_VERSION_NUM >= 0x073100
+void easy::add_connect_to(const std::string& connect_to)
+{
+	asio::error_code ec;
+	add_connect_to(connect_to, ec);
+	asio::detail::throw_error(ec, "add_connect_to");
+}
+
+void easy::add_connect_to(const std::string& connect_to, asio::error_code& ec)
+{
+	if (!connect_to_)
+	{
+		connect_to_ = std::make_shared<string_list>();
+	}
+
+	connect_to_->add(connect_to);
+	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_CONNECT_TO, connect_to_->native_handle()), asio::system_category());
+}
+
+void easy::set_connect_to(std::shared_ptr<string_list> connect_to)
+{
+	asio::error_code ec;
+	set_connect_to(connect_to, ec);
+	asio::detail::throw_error(ec, "set_connect_to");
+}
+
+void easy::set_connect_to(std::shared_ptr<string_list> connect_to, asio::error_code& ec)
+{
+	connect_to_ = connect_to;
+
+	if (connect_to_)
+	{
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_CONNECT_TO, connect_to_->native_handle()), asio::system_category());
+	}
+	else
+	{
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_CONNECT_TO, NULL), asio::system_category());
+	}
+}
+
+void easy::set_endpoint(const std::string& address)
+{
+	asio::error_code ec;
+	set_endpoint(address, ec);
+	asio::detail::throw_error(ec, "set_endpoint");
+}
+
+void easy::set_endpoint(const std::string& address, asio::error_code& ec)
+{
+	if (address.empty())
+	{
+		endpoint_.reset();
+		set_connect_to(connect_to_, ec);
+		return;
+	}
+
+	origin target(url_);
+	std::string port = std::to_string(static_cast<unsigned int>(target.port));
+	std::string host = (address.find(':') != std::string::npos) ? "[" + address + "]" : address;
+
+	// A fresh list is used for every transfer, as the previous one might still be referenced by a duplicate of this handle
+	endpoint_ = std::make_shared<string_list>();
+	endpoint_->add(target.host_entry() + ":" + port + ":" + host + ":" + port);
+	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_CONNECT_TO, endpoint_->native_handle()), asio::system_category());
+}
+#endif
+
+void easy::set_share(std::shared_ptr<share> share)
+{
+	asio::error_code ec;
+	set_share(share, ec);
+	asio::detail::throw_error(ec, "set_share");
+}
+
+void easy::set_share(std::shared_ptr<share> share, asio::error_code& ec)
+{
+	share_ = share;
+
+	if (share)
+	{
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_SHARE, share->native_handle()), asio::system_category());
+	}
+	else
+	{
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_SHARE, NULL), asio::system_category());
+	}
+}
+
+void easy::add_telnet_option(const std::string& telnet_option)
+{
+	asio::error_code ec;
+	add_telnet_option(telnet_option, ec);
+	asio::detail::throw_error(ec, "add_telnet_option");
+}
+
+void easy::add_telnet_option(const std::string& telnet_option, asio::error_code& ec)
+{
+	if (!telnet_options_)
+	{
+		telnet_options_ = std::make_shared<string_list>();
+	}
+
+	telnet_options_->add(telnet_option);
+	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_TELNETOPTIONS, telnet_options_->native_handle()), asio::system_category());
+}
+
+void easy::add_telnet_option(const std::string& option, const std::string& value)
+{
+	asio::error_code ec;
+	add_telnet_option(option, value, ec);
+	asio::detail::throw_error(ec, "add_telnet_option");
+}
+
+void easy::add_telnet_option(const std::string& option, const std::string& value, asio::error_code& ec)
+{
+	add_telnet_option(option + "=" + value, ec);
+}
+
+void easy::set_telnet_options(std::shared_ptr<string_list> telnet_options)
+{
+	asio::error_code ec;
+	set_telnet_options(telnet_options, ec);
+	asio::detail::throw_error(ec, "set_telnet_options");
+}
+
+void easy::set_telnet_options(std::shared_ptr<string_list> telnet_options, asio::error_code& ec)
+{
+	telnet_options_ = telnet_options;
+
+	if (telnet_options_)
+	{
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_TELNETOPTIONS, telnet_options_->native_handle()), asio::system_category());
+	}
+	else
+	{
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_TELNETOPTIONS, NULL), asio::system_category());
+	}
+}
+
+void easy::handle_completion(const asio::error_code& err)
+{
+	if (hedge_)
+	{
+		// Hedged requests complete once either attempt has won
+		std::shared_ptr<hedged_request> hedge = hedge_;
+		hedge->handle_completion(*this, err);
+	}
+	else
+	{
+		complete(err);
+	}
+}
+
+void easy::complete(const asio::error_code& transfer_err)
+{
+	asio::error_code err = transfer_err;
+
+	if (!err && !verify_checksums())
+	{
+		err = errc::wrapper::make_error_code(errc::wrapper::checksum_mismatch);
+	}
+
+	if (retry_policy_ && schedule_retry(err))
+	{
+		return;
+	}
+
+	if (sink_)
+	{
+		sink_->flush();
+	}
+
+	finish_sinks(err);
+	multi_registered_ = false;
+
+	if (body_streaming_)
+	{
+		body_stream_->finish(err);
+	}
+
+	if (upload_streaming_)
+	{
+		upload_stream_->finish(err);
+	}
+
+	if (file_sink_)
+	{
+		// The writer threads post the completion once they caught up
+		file_sink_->async_flush(std::bind(&easy::handle_file_flush, handler_, err, std::placeholders::_1));
+		return;
+	}
+
+	io_service_.post(std::bind(handler_, err));
+}
+
+void easy::handle_file_flush(handler_type handler, asio::error_code err, const asio::error_code& flush_err)
+{
+	handler(err ? err : flush_err);
+}
+
+void easy::handle_fetch(std::shared_ptr<std::string> body, fetch_handler_type handler, const asio::error_code& err)
+{
+	handler(err, std::move(*body));
+}
+
+void easy::handle_fetch_chain(std::shared_ptr<chunk_chain> body, fetch_chain_handler_type handler, const asio::error_code& err)
+{
+	handler(err, std::move(*body));
+}
+
+void easy::clear_sinks()
+{
+	sink_.reset();
+	buffer_sink_function_ = 0;
+	buffer_sink_context_ = 0;
+	buffer_sink_owner_.reset();
+	buffer_sink_by_library_ = false;
+	fetch_body_.reset();
+	fetch_chain_.reset();
+	spill_sink_.reset();
+	file_sink_.reset();
+	pipeline_.reset();
+	record_sink_.reset();
+	byterange_sink_.reset();
+	body_streaming_ = false;
+}
+
+void easy::finish_sinks(asio::error_code& err)
+{
+	if (record_sink_)
+	{
+		if (err)
+		{
+			record_sink_->reset();
+		}
+		else if (!record_sink_->finish())
+		{
+			err = asio::error_code(native::CURLE_WRITE_ERROR, asio::system_category());
+		}
+	}
+
+	if (pipeline_ && !err && !pipeline_->finish())
+	{
+		err = asio::error_code(native::CURLE_WRITE_ERROR, asio::system_category());
+	}
+
+	// A body cut short or lacking its closing delimiter means ranges are missing, even if the transfer itself went fine
+	if (byterange_sink_ && !err && byterange_sink_->is_started() && !byterange_sink_->finish())
+	{
+		err = asio::error_code(native::CURLE_WRITE_ERROR, asio::system_category());
+	}
+}
+
+std::size_t easy::deliver_byteranges(char* ptr, std::size_t size)
+{
+	if (!byterange_sink_->is_started())
+	{
+		long response_code = 0;
+		native::curl_easy_getinfo(handle_, native::CURLINFO_RESPONSE_CODE, &response_code);
+
+		// Error pages are not part of the resource
+		if (response_code != 200 && response_code != 206)
+		{
+			return size;
+		}
+
+		if (!byterange_sink_->start(get_response_header("Content-Type"), response_code == 206 ? get_response_header("Content-Range") : std::string()))
+		{
+			return 0;
+		}
+	}
+
+	return byterange_sink_->write(ptr, size) ? size : 0;
+}
+
+void easy::reset_checksums()
+{
+	for (std::size_t i = 0; i < checksums_.size(); ++i)
+	{
+		checksums_[i].first->reset();
+	}
+}
+
+bool easy::verify_checksums()
+{
+	for (std::size_t i = 0; i < checksums_.size(); ++i)
+	{
+		const checksum& sum = *checksums_[i].first;
+		std::string expected = checksums_[i].second;
+
+		for (std::size_t j = 0; j < response_headers_.size() && expected.empty(); ++j)
+		{
+			expected = checksum::announced_digest(sum.get_algorithm(), response_headers_[j].first, response_headers_[j].second);
+		}
+
+		if (!expected.empty() && sum.digest() != expected)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::size_t easy::announced_content_length()
 {
-	asio::error_code ec;
-	set_share(share, ec);
-	asio::detail::throw_error(ec, "set_share");
+	// libcurl has parsed the headers by the time the first byte of the body arrives, so the announced length is known unless the response is chunked
+#if LIBCURL_VERSION_NUM >= 0x073700
+	native::curl_off_t content_length = -1;
+	native::curl_easy_getinfo(handle_, native::CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+#else
+	double content_length = -1.0;
+	native::curl_easy_getinfo(handle_, native::CURLINFO_CONTENT_LENGTH_DOWNLOAD, &content_length);
+#endif
+
+	return (content_length > 0) ? static_cast<std::size_t>(content_length) : 0;
 }
 
-void easy::set_share(std::shared_ptr<share> share, asio::error_code& ec)
+void easy::append_fetched(const char* data, std::size_t size)
 {
-	share_ = share;
+	std::string& body = *fetch_body_;
 
-	if (share)
+	if (body.empty())
 	{
-		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_SHARE, share->native_handle()), asio::system_category());
+		body.reserve(std::max(announced_content_length(), size));
 	}
-	else
+
+	if (body.size() + size > body.capacity())
 	{
-		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_SHARE, NULL), asio::system_category());
+		body.reserve(std::max(body.capacity() * 2, body.size() + size));
 	}
-}
 
-void easy::add_telnet_option(const std::string& telnet_option)
-{
-	asio::error_code ec;
-	add_telnet_option(telnet_option, ec);
-	asio::detail::throw_error(ec, "add_telnet_option");
+	body.append(data, size);
 }
 
-void easy::add_telnet_option(const std::string& telnet_option, asio::error_code& ec)
+bool easy::is_retryable_response()
 {
-	if (!telnet_options_)
+	if (!retry_policy_ || source_ || upload_streaming_ || attempts_ >= retry_policy_->get_max_attempts())
 	{
-		telnet_options_ = std::make_shared<string_list>();
+		return false;
 	}
 
-	telnet_options_->add(telnet_option);
-	ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_TELNETOPTIONS, telnet_options_->native_handle()), asio::system_category());
-}
+	long response_code = 0;
+	native::curl_easy_getinfo(handle_, native::CURLINFO_RESPONSE_CODE, &response_code);
 
-void easy::add_telnet_option(const std::string& option, const std::string& value)
-{
-	asio::error_code ec;
-	add_telnet_option(option, value, ec);
-	asio::detail::throw_error(ec, "add_telnet_option");
-}
+	if (!retry_policy_->is_retryable_status(response_code))
+	{
+		return false;
+	}
 
-void easy::add_telnet_option(const std::string& option, const std::string& value, asio::error_code& ec)
-{
-	add_telnet_option(option + "=" + value, ec);
+	// The retry is paid for as soon as the response is dropped; a budget running out later would otherwise complete the request with an empty body
+	retry_acquired_ = retry_policy_->acquire_retry(origin(url_).str());
+	return retry_acquired_;
 }
 
-void easy::set_telnet_options(std::shared_ptr<string_list> telnet_options)
+bool easy::schedule_retry(const asio::error_code& err)
 {
-	asio::error_code ec;
-	set_telnet_options(telnet_options, ec);
-	asio::detail::throw_error(ec, "set_telnet_options");
-}
+	std::string origin_str = origin(url_).str();
+	long response_code = 0;
+	bool acquired = retry_acquired_;
+	retry_acquired_ = false;
 
-void easy::set_telnet_options(std::shared_ptr<string_list> telnet_options, asio::error_code& ec)
-{
-	telnet_options_ = telnet_options;
+	if (!err)
+	{
+		native::curl_easy_getinfo(info_handle(), native::CURLINFO_RESPONSE_CODE, &response_code);
+	}
 
-	if (telnet_options_)
+	if (!retry_policy_->is_retryable(err, response_code))
 	{
-		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_TELNETOPTIONS, telnet_options_->native_handle()), asio::system_category());
+		if (acquired)
+		{
+			retry_policy_->release_retry(origin_str);
+		}
+
+		if (!err)
+		{
+			retry_policy_->record_success(origin_str);
+		}
+
+		return false;
 	}
-	else
+
+	// Data which already reached the sink cannot be taken back, and source streams cannot be replayed
+	if (response_delivered_ || source_ || upload_streaming_ || attempts_ >= retry_policy_->get_max_attempts())
 	{
-		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_TELNETOPTIONS, NULL), asio::system_category());
+		if (acquired)
+		{
+			retry_policy_->release_retry(origin_str);
+		}
+
+		return false;
 	}
-}
 
-void easy::handle_completion(const asio::error_code& err)
-{
-	if (sink_)
+	if (!acquired && !retry_policy_->acquire_retry(origin_str))
 	{
-		sink_->flush();
+		return false;
 	}
 
-	multi_registered_ = false;
-	io_service_.post(std::bind(handler_, err));
+	++attempts_;
+	retry_delay_ = retry_policy_->next_delay(retry_delay_);
+	response_started_ = false;
+	response_discarded_ = false;
+	hedge_.reset();
+	hedge_winner_.reset();
+
+	// libcurl starts the next attempt unpaused
+	recv_pause_holders_ = 0;
+	send_pause_holders_ = 0;
+
+	// File sources and post buffers are sent again from their start; libcurl only rewinds on its own within a transfer
+	source_offset_ = 0;
+	reset_encoder();
+
+	// The same easy handle is used for the next attempt, which allows libcurl to reuse its connection
+	multi_->add_deferred(this, std::chrono::steady_clock::now() + retry_delay_);
+	return true;
 }
 
 void easy::init()
@@ -541,38 +1686,378 @@ size_t easy::write_function(char* ptr, size_t size, size_t nmemb, void* userdata
 		return 0;
 	}
 
-	if (!self->sink_->write(ptr, actual_size))
+	bandwidth_shaper* shaper = self->multi_ ? self->multi_->get_bandwidth_shaper().get() : 0;
+
+	if (shaper && !shaper->acquire(self, bandwidth_shaper::recv))
+	{
+		// libcurl delivers the same data again once the shaper resumed the transfer
+		self->hold_pause(pause_recv, pause_by_shaper);
+		return CURL_WRITEFUNC_PAUSE;
+	}
+
+	std::size_t consumed = actual_size;
+	bool delivered = false;
+
+	// Unless the other attempt of a hedged request is delivering the response
+	if (!self->hedge_ || self->hedge_->commit(*self))
+	{
+		if (!self->response_started_)
+		{
+			self->response_started_ = true;
+			self->response_discarded_ = self->is_retryable_response();
+		}
+
+		// The body of a response which is going to be retried must not reach the sink
+		if (!self->response_discarded_)
+		{
+			self->response_delivered_ = true;
+			delivered = true;
+			consumed = self->deliver_to_sink(ptr, actual_size);
+		}
+	}
+
+	if (consumed == CURL_WRITEFUNC_PAUSE)
+	{
+		// Data the sink paused on is delivered again, so it is neither hashed nor charged until then. Buffer sinks are the only ones the user resumes, unless a library component such as a relay installed them.
+		bool library_sink = self->body_streaming_ || self->pipeline_ || self->file_sink_ || self->buffer_sink_by_library_;
+		self->hold_pause(pause_recv, library_sink ? pause_by_sink : pause_by_user);
+		return consumed;
+	}
+
+	if (delivered && consumed == actual_size)
+	{
+		for (std::size_t i = 0; i < self->checksums_.size(); ++i)
+		{
+			self->checksums_[i].first->update(ptr, actual_size);
+		}
+	}
+
+	if (shaper)
+	{
+		shaper->charge(self, bandwidth_shaper::recv, consumed);
+	}
+
+	return consumed;
+}
+
+std::size_t easy::deliver_to_sink(char* ptr, std::size_t size)
+{
+	if (fetch_body_)
+	{
+		append_fetched(ptr, size);
+		return size;
+	}
+
+	if (fetch_chain_)
+	{
+		fetch_chain_->append(ptr, size);
+		return size;
+	}
+
+	if (body_streaming_)
+	{
+		return body_stream_->deliver(this, ptr, size);
+	}
+
+	if (pipeline_)
+	{
+		return pipeline_->deliver(this, ptr, size);
+	}
+
+	if (record_sink_)
+	{
+		return record_sink_->write(ptr, size) ? size : 0;
+	}
+
+	if (byterange_sink_)
+	{
+		return deliver_byteranges(ptr, size);
+	}
+
+	if (file_sink_)
+	{
+		return file_sink_->write(this, ptr, size, file_sink_->preallocated_ ? 0 : announced_content_length());
+	}
+
+	if (spill_sink_)
+	{
+		asio::error_code ec;
+
+		if (spill_sink_->size() == 0)
+		{
+			spill_sink_->reserve(std::max(announced_content_length(), size), ec);
+		}
+
+		if (!ec)
+		{
+			spill_sink_->append(ptr, size, ec);
+		}
+
+		return ec ? 0 : size;
+	}
+
+	if (buffer_sink_function_)
+	{
+		std::size_t consumed = buffer_sink_function_(buffer_sink_context_, asio::const_buffer(ptr, size));
+		return (consumed == sink_pause) ? CURL_WRITEFUNC_PAUSE : consumed;
+	}
+
+	if (sink_ && !sink_->write(ptr, size))
 	{
 		return 0;
 	}
 	else
 	{
-		return actual_size;
+		// Without a sink, the body only feeds the checksums
+		return size;
 	}
 }
 
-size_t easy::read_function(void* ptr, size_t size, size_t nmemb, void* userdata)
+size_t easy::header_function(void* ptr, size_t size, size_t nmemb, void* userdata)
 {
-	// FIXME readsome doesn't work with TFTP (see cURL docs)
+	easy* self = static_cast<easy*>(userdata);
+	size_t actual_size = size * nmemb;
+	std::string line(static_cast<const char*>(ptr), actual_size);
+
+	if (line.compare(0, 5, "HTTP/") == 0)
+	{
+		// Each redirect, interim and retried response starts over with its status line
+		self->response_headers_.clear();
+	}
+	else if (!line.empty() && (line[0] == ' ' || line[0] == '\t'))
+	{
+		if (!self->response_headers_.empty())
+		{
+			self->response_headers_.back().second += " " + trim(line);
+		}
+	}
+	else
+	{
+		std::size_t colon = line.find(':');
+
+		if (colon != std::string::npos)
+		{
+			self->response_headers_.push_back(std::make_pair(trim(line.substr(0, colon)), trim(line.substr(colon + 1))));
+		}
+	}
+
+	return actual_size;
+}
 
+size_t easy::read_function(void* ptr, size_t size, size_t nmemb, void* userdata)
+{
 	easy* self = static_cast<easy*>(userdata);
 	size_t actual_size = size * nmemb;
 
-	if (self->source_->eof())
+	if (!self->encoder_ && self->source_ && self->source_->eof())
 	{
 		return 0;
 	}
 
-	std::streamsize chars_stored = self->source_->readsome(static_cast<char*>(ptr), actual_size);
+	bandwidth_shaper* shaper = self->multi_ ? self->multi_->get_bandwidth_shaper().get() : 0;
 
-	if (!self->source_)
+	if (shaper && !shaper->acquire(self, bandwidth_shaper::send))
 	{
-		return CURL_READFUNC_ABORT;
+		self->hold_pause(pause_send, pause_by_shaper);
+		return CURL_READFUNC_PAUSE;
 	}
-	else
+
+	std::size_t chars_stored = self->encoder_ ? self->read_encoded(static_cast<char*>(ptr), actual_size) : self->read_source(static_cast<char*>(ptr), actual_size);
+
+	if (chars_stored == CURL_READFUNC_PAUSE)
+	{
+		// Only an upload stream waiting for its next write pauses
+		self->hold_pause(pause_send, pause_by_source);
+		return chars_stored;
+	}
+
+	if (chars_stored == CURL_READFUNC_ABORT)
+	{
+		return chars_stored;
+	}
+
+	if (shaper && chars_stored > 0)
+	{
+		shaper->charge(self, bandwidth_shaper::send, chars_stored);
+	}
+
+	return chars_stored;
+}
+
+std::size_t easy::read_source(char* data, std::size_t size)
+{
+	std::size_t chars_stored = 0;
+
+	if (upload_streaming_)
+	{
+		chars_stored = upload_stream_->read(this, data, size);
+	}
+	else if (file_source_)
+	{
+		asio::error_code ec;
+		chars_stored = file_source_->read_at(source_offset_, data, size, ec);
+
+		if (ec)
+		{
+			return CURL_READFUNC_ABORT;
+		}
+
+		source_offset_ += chars_stored;
+	}
+	else if (post_buffers_)
+	{
+		chars_stored = read_post_buffers(data, size);
+	}
+	else if (source_ && !source_->eof())
+	{
+		// Unlike readsome, read only returns less than requested at the end of the stream. A short count would otherwise be taken for the end of the body, and TFTP requires full blocks.
+		source_->read(data, size);
+
+		if (source_->bad())
+		{
+			return CURL_READFUNC_ABORT;
+		}
+
+		chars_stored = static_cast<std::size_t>(source_->gcount());
+	}
+
+	return chars_stored;
+}
+
+std::size_t easy::read_encoded(char* data, std::size_t size)
+{
+	std::size_t chars_stored = 0;
+
+	// The encoder may swallow input without producing output, so reading goes on until libcurl gets something or the body ends
+	while (chars_stored == 0 && !encoder_->is_finished())
+	{
+		encoder::flush_mode mode = encoder::no_flush;
+
+		if (encoder_input_begin_ == encoder_input_end_ && !encoder_input_eof_)
+		{
+			if (encoder_input_.empty())
+			{
+				encoder_input_.resize(encoder_input_size);
+			}
+
+			std::size_t n = read_source(&encoder_input_[0], encoder_input_.size());
+
+			if (n == CURL_READFUNC_ABORT)
+			{
+				return n;
+			}
+			else if (n == CURL_READFUNC_PAUSE)
+			{
+				// What the encoder holds back is sent before waiting for more, so that a slow stream's data does not sit in it
+				if (!encoder_->has_pending())
+				{
+					return n;
+				}
+
+				mode = encoder::sync_flush;
+			}
+			else
+			{
+				encoder_input_begin_ = 0;
+				encoder_input_end_ = n;
+				encoder_input_eof_ = (n == 0);
+			}
+		}
+
+		if (encoder_input_eof_)
+		{
+			mode = encoder::finish;
+		}
+
+		const char* input = encoder_input_.empty() ? 0 : &encoder_input_[0] + encoder_input_begin_;
+		std::size_t input_size = encoder_input_end_ - encoder_input_begin_;
+		asio::error_code ec;
+		chars_stored = encoder_->encode(input, input_size, data, size, mode, ec);
+
+		if (ec)
+		{
+			return CURL_READFUNC_ABORT;
+		}
+
+		encoder_input_begin_ = encoder_input_end_ - input_size;
+	}
+
+	return chars_stored;
+}
+
+void easy::reset_encoder()
+{
+	if (encoder_)
+	{
+		encoder_->reset();
+		encoder_input_begin_ = 0;
+		encoder_input_end_ = 0;
+		encoder_input_eof_ = false;
+	}
+}
+
+void easy::apply_upload_encoding(asio::error_code& ec)
+{
+	ec = asio::error_code();
+	reset_encoder();
+
+	if (encoder_ && (source_ || file_source_ || post_buffers_ || upload_streaming_))
+	{
+		// The compressed size is only known at the end, hence libcurl has to send the body in chunks
+		set_post_field_size_large(-1, ec);
+		if (!ec) set_in_file_size_large(-1, ec);
+		if (ec) return;
+
+		// The header goes into a copy of the headers, which stay as they are for when the encoding is cleared
+		encoded_headers_ = std::make_shared<string_list>();
+
+		for (native::curl_slist* header = headers_ ? headers_->native_handle() : 0; header; header = header->next)
+		{
+			encoded_headers_->add(header->data);
+		}
+
+		encoded_headers_->add(std::string("Content-Encoding: ") + encoder_->name());
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPHEADER, encoded_headers_->native_handle()), asio::system_category());
+	}
+	else if (encoded_headers_)
+	{
+		encoded_headers_.reset();
+		ec = asio::error_code(native::curl_easy_setopt(handle_, native::CURLOPT_HTTPHEADER, headers_ ? headers_->native_handle() : NULL), asio::system_category());
+	}
+}
+
+std::size_t easy::read_post_buffers(char* data, std::size_t size)
+{
+	const std::vector<asio::const_buffer>& buffers = *post_buffers_;
+	std::size_t stored = 0;
+
+	// The position of the current buffer is cached, which only has to be searched for again after rewinding
+	if (source_offset_ < post_buffers_base_)
+	{
+		post_buffers_index_ = 0;
+		post_buffers_base_ = 0;
+	}
+
+	while (stored < size && post_buffers_index_ < buffers.size())
 	{
-		return static_cast<size_t>(chars_stored);
+		const asio::const_buffer& buffer = buffers[post_buffers_index_];
+		std::size_t buffer_size = asio::buffer_size(buffer);
+		native::curl_off_t skip = source_offset_ - post_buffers_base_;
+
+		if (skip >= static_cast<native::curl_off_t>(buffer_size))
+		{
+			post_buffers_base_ += buffer_size;
+			++post_buffers_index_;
+			continue;
+		}
+
+		std::size_t n = std::min(size - stored, buffer_size - static_cast<std::size_t>(skip));
+		std::memcpy(data + stored, asio::buffer_cast<const char*>(buffer) + skip, n);
+		stored += n;
+		source_offset_ += n;
 	}
+
+	return stored;
 }
 
 int easy::seek_function(void* instream, native::curl_off_t offset, int origin)
@@ -582,6 +2067,49 @@ int easy::seek_function(void* instream, native::curl_off_t offset, int origin)
 
 	easy* self = static_cast<easy*>(instream);
 
+	if (self->encoder_)
+	{
+		// The encoder cannot resume in the middle of the body
+		if (offset != 0 || origin != SEEK_SET)
+		{
+			return CURL_SEEKFUNC_CANTSEEK;
+		}
+
+		self->reset_encoder();
+	}
+
+	if (self->file_source_ || self->post_buffers_)
+	{
+		native::curl_off_t size = self->file_source_ ? self->file_source_->get_size() : self->post_buffers_size_;
+		native::curl_off_t base;
+
+		switch (origin)
+		{
+		case SEEK_SET:
+			base = 0;
+			break;
+
+		case SEEK_CUR:
+			base = self->source_offset_;
+			break;
+
+		case SEEK_END:
+			base = size;
+			break;
+
+		default:
+			return CURL_SEEKFUNC_FAIL;
+		}
+
+		if (base + offset < 0 || base + offset > size)
+		{
+			return CURL_SEEKFUNC_FAIL;
+		}
+
+		self->source_offset_ = base + offset;
+		return CURL_SEEKFUNC_OK;
+	}
+
 	std::ios::seekdir dir;
 
 	switch (origin)
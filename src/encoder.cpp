@@ -0,0 +1,260 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Incremental compression of request bodies for Content-Encoding
+*/
+
+#include <curl-asio/encoder.h>
+#include <algorithm>
+#include <limits>
+#include <new>
+
+#if defined(CURLASIO_WITH_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(CURLASIO_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+using namespace curl;
+
+struct encoder::stream
+{
+#if defined(CURLASIO_WITH_ZLIB)
+	z_stream zlib;
+#endif
+#if defined(CURLASIO_WITH_ZSTD)
+	ZSTD_CCtx* zstd;
+#endif
+};
+
+encoder::encoder(coding c, int level):
+	coding_(c),
+	level_(level),
+	stream_(new stream),
+	pending_(false),
+	finished_(false),
+	bytes_in_(0),
+	bytes_out_(0)
+{
+	if (!is_supported(coding_))
+	{
+		delete stream_;
+		asio::detail::throw_error(asio::error::operation_not_supported, "encoder");
+	}
+
+	bool ok = false;
+
+	switch (coding_)
+	{
+	case gzip:
+	case deflate:
+#if defined(CURLASIO_WITH_ZLIB)
+		stream_->zlib.zalloc = Z_NULL;
+		stream_->zlib.zfree = Z_NULL;
+		stream_->zlib.opaque = Z_NULL;
+
+		// Adding 16 to the window bits selects the gzip wrapper instead of the zlib one, which is what HTTP calls deflate
+		ok = (deflateInit2(&stream_->zlib, level_ < 0 ? Z_DEFAULT_COMPRESSION : level_, Z_DEFLATED, coding_ == gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+#endif
+		break;
+
+	case zstd:
+#if defined(CURLASIO_WITH_ZSTD)
+		stream_->zstd = ZSTD_createCCtx();
+		ok = (stream_->zstd != 0);
+
+		if (ok && ZSTD_isError(ZSTD_CCtx_setParameter(stream_->zstd, ZSTD_c_compressionLevel, level_ < 0 ? ZSTD_CLEVEL_DEFAULT : level_)))
+		{
+			ZSTD_freeCCtx(stream_->zstd);
+			ok = false;
+		}
+#endif
+		break;
+	}
+
+	if (!ok)
+	{
+		delete stream_;
+		throw std::bad_alloc();
+	}
+}
+
+encoder::~encoder()
+{
+	switch (coding_)
+	{
+	case gzip:
+	case deflate:
+#if defined(CURLASIO_WITH_ZLIB)
+		deflateEnd(&stream_->zlib);
+#endif
+		break;
+
+	case zstd:
+#if defined(CURLASIO_WITH_ZSTD)
+		ZSTD_freeCCtx(stream_->zstd);
+#endif
+		break;
+	}
+
+	delete stream_;
+}
+
+bool encoder::is_supported(coding c)
+{
+	switch (c)
+	{
+	case gzip:
+	case deflate:
+#if defined(CURLASIO_WITH_ZLIB)
+		return true;
+#else
+		return false;
+#endif
+
+	case zstd:
+#if defined(CURLASIO_WITH_ZSTD)
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	return false;
+}
+
+const char* encoder::name() const
+{
+	switch (coding_)
+	{
+	case gzip:
+		return "gzip";
+
+	case deflate:
+		return "deflate";
+
+	case zstd:
+		return "zstd";
+	}
+
+	return "identity";
+}
+
+void encoder::reset()
+{
+	switch (coding_)
+	{
+	case gzip:
+	case deflate:
+#if defined(CURLASIO_WITH_ZLIB)
+		deflateReset(&stream_->zlib);
+#endif
+		break;
+
+	case zstd:
+#if defined(CURLASIO_WITH_ZSTD)
+		ZSTD_CCtx_reset(stream_->zstd, ZSTD_reset_session_only);
+#endif
+		break;
+	}
+
+	pending_ = false;
+	finished_ = false;
+	bytes_in_ = 0;
+	bytes_out_ = 0;
+}
+
+std::size_t encoder::encode(const char*& data, std::size_t& size, char* output, std::size_t output_size, flush_mode mode, asio::error_code& ec)
+{
+	ec = asio::error_code();
+
+	if (finished_)
+	{
+		return 0;
+	}
+
+	std::size_t consumed = 0;
+	std::size_t produced = 0;
+	bool complete = false;
+
+	switch (coding_)
+	{
+	case gzip:
+	case deflate:
+#if defined(CURLASIO_WITH_ZLIB)
+		{
+			// zlib counts in unsigned int
+			const std::size_t max_chunk = std::numeric_limits<uInt>::max();
+			z_stream& z = stream_->zlib;
+			std::size_t input_size = std::min(size, max_chunk);
+			std::size_t available = std::min(output_size, max_chunk);
+
+			z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+			z.avail_in = static_cast<uInt>(input_size);
+			z.next_out = reinterpret_cast<Bytef*>(output);
+			z.avail_out = static_cast<uInt>(available);
+
+			int flush = (mode == finish && input_size == size) ? Z_FINISH : (mode == no_flush ? Z_NO_FLUSH : Z_SYNC_FLUSH);
+			int result = ::deflate(&z, flush);
+
+			if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+			{
+				ec = asio::error::invalid_argument;
+				return 0;
+			}
+
+			consumed = input_size - z.avail_in;
+			produced = available - z.avail_out;
+
+			// A flush is complete once it leaves room in the output
+			complete = (flush == Z_FINISH) ? (result == Z_STREAM_END) : (flush == Z_SYNC_FLUSH && z.avail_in == 0 && z.avail_out > 0);
+		}
+#endif
+		break;
+
+	case zstd:
+#if defined(CURLASIO_WITH_ZSTD)
+		{
+			ZSTD_inBuffer in = { data, size, 0 };
+			ZSTD_outBuffer out = { output, output_size, 0 };
+			ZSTD_EndDirective directive = (mode == finish) ? ZSTD_e_end : (mode == sync_flush ? ZSTD_e_flush : ZSTD_e_continue);
+			std::size_t remaining = ZSTD_compressStream2(stream_->zstd, &out, &in, directive);
+
+			if (ZSTD_isError(remaining))
+			{
+				ec = asio::error::invalid_argument;
+				return 0;
+			}
+
+			consumed = in.pos;
+			produced = out.pos;
+
+			// zstd only reports a flush as done once all input has been consumed, too
+			complete = (mode != no_flush && remaining == 0);
+		}
+#endif
+		break;
+	}
+
+	data += consumed;
+	size -= consumed;
+	bytes_in_ += consumed;
+	bytes_out_ += produced;
+
+	if (consumed > 0)
+	{
+		pending_ = true;
+	}
+
+	if (complete)
+	{
+		pending_ = false;
+		finished_ = (mode == finish);
+	}
+
+	return produced;
+}
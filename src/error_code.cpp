@@ -110,6 +110,40 @@ std::string curl_form_error_category::message(int ev) const
 	}
 }
 
+class curl_asio_error_category : public asio::error_category
+{
+public:
+	curl_asio_error_category() { }
+	const char* name() const;
+	std::string message(int ev) const;
+};
+
+const char* curl_asio_error_category::name() const
+{
+	return "curl-asio";
+}
+
+std::string curl_asio_error_category::message(int ev) const
+{
+	switch (static_cast<errc::wrapper::wrapper_error_codes>(ev))
+	{
+	case errc::wrapper::success:
+		return "no error";
+
+	case errc::wrapper::circuit_open:
+		return "circuit breaker is open for this origin";
+
+	case errc::wrapper::checksum_mismatch:
+		return "response body does not match its checksum";
+
+	case errc::wrapper::resource_changed:
+		return "resource changed since the download started";
+
+	default:
+		return "no error description (unknown curl-asio error)";
+	}
+}
+
 const asio::error_category& errc::get_easy_category()
 {
 	static const curl_easy_error_category curl_easy_category_const;
@@ -133,3 +167,9 @@ const asio::error_category& errc::get_form_category()
 	static const curl_form_error_category curl_form_category_const;
 	return curl_form_category_const;
 }
+
+const asio::error_category& errc::get_wrapper_category()
+{
+	static const curl_asio_error_category curl_asio_category_const;
+	return curl_asio_category_const;
+}
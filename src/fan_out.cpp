@@ -0,0 +1,196 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Sends one request body to several URLs and completes once a quorum of them succeeded
+*/
+
+#include <curl-asio/easy.h>
+#include <curl-asio/error_code.h>
+#include <curl-asio/fan_out.h>
+#include <curl-asio/multi.h>
+#include <stdexcept>
+
+using namespace curl;
+
+// The state of a single fan-out operation is kept apart from the fan_out object so that the handlers of cancelled stragglers, which run after completion, never touch an object that might already be gone.
+struct fan_out::operation
+{
+	asio::io_service* io_service;
+	handler_type handler;
+	std::vector<easy*> handles;
+	std::vector<asio::error_code> results;
+	std::vector<bool> done;
+	std::size_t quorum;
+	std::size_t succeeded;
+	std::size_t failed;
+	bool completed;
+};
+
+fan_out::fan_out(multi& multi_handle):
+	multi_(multi_handle),
+	quorum_(0)
+{
+}
+
+fan_out::~fan_out()
+{
+	cancel();
+}
+
+easy& fan_out::add(const std::string& url)
+{
+	std::shared_ptr<easy> handle(new easy(multi_));
+	handle->set_url(url);
+
+	if (body_)
+	{
+		handle->set_post_fields(body_);
+	}
+
+	handles_.push_back(handle);
+	return *handle;
+}
+
+easy& fan_out::at(std::size_t index)
+{
+	return *handles_.at(index);
+}
+
+void fan_out::set_body(std::shared_ptr<const std::string> body)
+{
+	asio::error_code ec;
+	set_body(body, ec);
+	asio::detail::throw_error(ec, "set_body");
+}
+
+void fan_out::set_body(std::shared_ptr<const std::string> body, asio::error_code& ec)
+{
+	body_ = body;
+
+	for (std::size_t i = 0; i < handles_.size() && !ec; ++i)
+	{
+		handles_[i]->set_post_fields(body_, ec);
+	}
+}
+
+void fan_out::set_quorum(std::size_t quorum)
+{
+	quorum_ = quorum;
+}
+
+void fan_out::async_perform(handler_type handler)
+{
+	if (handles_.empty())
+	{
+		throw std::runtime_error("attempt to perform fan-out operation without any requests");
+	}
+
+	if (get_quorum() > handles_.size())
+	{
+		throw std::invalid_argument("fan-out quorum exceeds the number of requests");
+	}
+
+	// Cancel the previous operation, if any
+	cancel();
+
+	operation_ptr op(new operation());
+	op->io_service = &multi_.get_io_service();
+	op->handler = handler;
+	op->results.resize(handles_.size());
+	op->done.resize(handles_.size(), false);
+	op->quorum = get_quorum();
+	op->succeeded = 0;
+	op->failed = 0;
+	op->completed = false;
+
+	for (std::size_t i = 0; i < handles_.size(); ++i)
+	{
+		op->handles.push_back(handles_[i].get());
+	}
+
+	operation_ = op;
+
+	for (std::size_t i = 0; i < handles_.size(); ++i)
+	{
+		handles_[i]->async_perform(std::bind(&fan_out::handle_response, op, i, std::placeholders::_1));
+	}
+}
+
+void fan_out::cancel()
+{
+	if (operation_ && !operation_->completed)
+	{
+		complete(operation_, asio::error_code(asio::error::operation_aborted));
+	}
+}
+
+std::size_t fan_out::succeeded() const
+{
+	return operation_ ? operation_->succeeded : 0;
+}
+
+asio::error_code fan_out::result(std::size_t index) const
+{
+	if (!operation_)
+	{
+		throw std::out_of_range("no fan-out operation has been performed");
+	}
+
+	return operation_->results.at(index);
+}
+
+void fan_out::handle_response(operation_ptr op, std::size_t index, const asio::error_code& err)
+{
+	asio::error_code ec = err;
+	op->done[index] = true;
+
+	if (op->completed)
+	{
+		// A straggler which was cancelled (or raced with) completion
+		op->results[index] = ec;
+		return;
+	}
+
+	if (!ec && op->handles[index]->get_reponse_code() >= 400)
+	{
+		ec = asio::error_code(native::CURLE_HTTP_RETURNED_ERROR, asio::system_category());
+	}
+
+	op->results[index] = ec;
+
+	if (!ec)
+	{
+		++op->succeeded;
+	}
+	else
+	{
+		++op->failed;
+	}
+
+	if (op->succeeded >= op->quorum)
+	{
+		complete(op, asio::error_code());
+	}
+	else if (op->failed > op->handles.size() - op->quorum)
+	{
+		// Not enough requests are left to reach the quorum
+		complete(op, ec);
+	}
+}
+
+void fan_out::complete(operation_ptr op, const asio::error_code& err)
+{
+	op->completed = true;
+
+	for (std::size_t i = 0; i < op->handles.size(); ++i)
+	{
+		if (!op->done[i])
+		{
+			op->handles[i]->cancel();
+		}
+	}
+
+	op->io_service->post(std::bind(op->handler, err));
+}
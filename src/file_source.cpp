@@ -0,0 +1,155 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Upload source reading a file with pread or from a memory mapping
+*/
+
+#include <curl-asio/file_source.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace curl;
+
+// Reads ahead of a pread transfer are requested in windows of this size
+static const native::curl_off_t readahead_window = 4 * 1024 * 1024;
+
+file_source::file_source():
+	fd_(-1),
+	size_(0),
+	mapping_(0)
+{
+}
+
+file_source::~file_source()
+{
+	close();
+}
+
+void file_source::open(const std::string& path, mode_t mode)
+{
+	asio::error_code ec;
+	open(path, mode, ec);
+	asio::detail::throw_error(ec, "open");
+}
+
+void file_source::open(const std::string& path, mode_t mode, asio::error_code& ec)
+{
+	close();
+
+#if !defined(_WIN32)
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd == -1)
+	{
+		ec = asio::error_code(errno, asio::system_category());
+		return;
+	}
+
+	struct stat st;
+
+	if (::fstat(fd, &st) != 0)
+	{
+		ec = asio::error_code(errno, asio::system_category());
+		::close(fd);
+		return;
+	}
+
+	fd_ = fd;
+	size_ = static_cast<native::curl_off_t>(st.st_size);
+	ec = asio::error_code();
+
+	if (mode == read_mapped && size_ > 0 && static_cast<unsigned long long>(size_) <= static_cast<std::size_t>(-1))
+	{
+		void* mapping = ::mmap(0, static_cast<std::size_t>(size_), PROT_READ, MAP_SHARED, fd_, 0);
+
+		if (mapping != MAP_FAILED)
+		{
+			mapping_ = static_cast<char*>(mapping);
+			::madvise(mapping_, static_cast<std::size_t>(size_), MADV_SEQUENTIAL);
+			return;
+		}
+	}
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+	::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#else
+	ec = asio::error::operation_not_supported;
+#endif
+}
+
+void file_source::close()
+{
+#if !defined(_WIN32)
+	if (mapping_)
+	{
+		::munmap(mapping_, static_cast<std::size_t>(size_));
+		mapping_ = 0;
+	}
+
+	if (fd_ != -1)
+	{
+		::close(fd_);
+		fd_ = -1;
+	}
+#endif
+
+	size_ = 0;
+}
+
+std::size_t file_source::read_at(native::curl_off_t offset, char* data, std::size_t size, asio::error_code& ec)
+{
+	ec = asio::error_code();
+
+	if (offset >= size_)
+	{
+		return 0;
+	}
+
+	size = static_cast<std::size_t>(std::min<native::curl_off_t>(size, size_ - offset));
+
+	if (mapping_)
+	{
+		std::memcpy(data, mapping_ + offset, size);
+		return size;
+	}
+
+#if !defined(_WIN32)
+#if defined(POSIX_FADV_WILLNEED)
+	// Ask for the next window whenever the transfer enters a new one, so that the disk stays ahead of the network
+	if (offset / readahead_window != (offset + static_cast<native::curl_off_t>(size)) / readahead_window || offset == 0)
+	{
+		native::curl_off_t window = (offset + static_cast<native::curl_off_t>(size)) / readahead_window + 1;
+		::posix_fadvise(fd_, static_cast<off_t>(window * readahead_window), static_cast<off_t>(readahead_window), POSIX_FADV_WILLNEED);
+	}
+#endif
+
+	for (;;)
+	{
+		ssize_t result = ::pread(fd_, data, size, static_cast<off_t>(offset));
+
+		if (result >= 0)
+		{
+			return static_cast<std::size_t>(result);
+		}
+		else if (errno != EINTR)
+		{
+			ec = asio::error_code(errno, asio::system_category());
+			return 0;
+		}
+	}
+#else
+	ec = asio::error::operation_not_supported;
+	return 0;
+#endif
+}
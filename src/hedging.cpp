@@ -0,0 +1,328 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Hedged requests: a duplicate of a slow request is sent after a delay derived from the origin's observed latency
+*/
+
+#include <curl-asio/easy.h>
+#include <curl-asio/hedging.h>
+#include <curl-asio/multi.h>
+#include <algorithm>
+#include <vector>
+
+using namespace curl;
+
+// Number of samples kept per origin, and the number required before the percentile is trusted
+static const std::size_t max_latency_samples = 256;
+static const std::size_t min_latency_samples = 16;
+
+// Upper bound of the hedge budget, which limits bursts of hedges after a long quiet period
+static const double max_budget_tokens = 10.0;
+
+hedging_policy::hedging_policy():
+	percentile_(0.95),
+	min_delay_(std::chrono::milliseconds(10)),
+	max_delay_(std::chrono::seconds(1)),
+	budget_ratio_(0.05),
+	budget_tokens_(1.0),
+	prefer_other_address_(false),
+	hedges_sent_(0)
+{
+}
+
+void hedging_policy::set_percentile(double percentile)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	percentile_ = std::min(std::max(percentile, 0.0), 1.0);
+}
+
+void hedging_policy::set_delay_bounds(clock_type::duration min_delay, clock_type::duration max_delay)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	min_delay_ = min_delay;
+	max_delay_ = std::max(min_delay, max_delay);
+}
+
+void hedging_policy::set_budget(double percent)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	budget_ratio_ = std::max(percent, 0.0) / 100.0;
+}
+
+void hedging_policy::set_prefer_other_address(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	prefer_other_address_ = enabled;
+}
+
+hedging_policy::clock_type::duration hedging_policy::hedge_delay(const std::string& origin)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	sample_map::iterator it = samples_.find(origin);
+
+	if (it == samples_.end() || it->second.size() < min_latency_samples)
+	{
+		return max_delay_;
+	}
+
+	std::vector<clock_type::duration> sorted(it->second.begin(), it->second.end());
+	std::vector<clock_type::duration>::iterator nth = sorted.begin() + static_cast<std::ptrdiff_t>(percentile_ * (sorted.size() - 1));
+	std::nth_element(sorted.begin(), nth, sorted.end());
+
+	return std::min(std::max(*nth, min_delay_), max_delay_);
+}
+
+void hedging_policy::record_latency(const std::string& origin, clock_type::duration latency)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	sample_list& samples = samples_[origin];
+	samples.push_back(latency);
+
+	if (samples.size() > max_latency_samples)
+	{
+		samples.pop_front();
+	}
+}
+
+void hedging_policy::record_request()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	budget_tokens_ = std::min(budget_tokens_ + budget_ratio_, max_budget_tokens);
+}
+
+bool hedging_policy::acquire_hedge()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (budget_tokens_ < 1.0)
+	{
+		return false;
+	}
+
+	budget_tokens_ -= 1.0;
+	++hedges_sent_;
+	return true;
+}
+
+static void ignore_completion(const asio::error_code&)
+{
+}
+
+hedged_request::hedged_request(easy& primary, std::shared_ptr<hedging_policy> policy):
+	primary_(primary),
+	policy_(policy),
+	origin_(primary.get_url()),
+	timer_(primary.get_io_service()),
+	resolver_(primary.get_io_service()),
+	winner_(0),
+	primary_running_(false),
+	hedge_running_(false),
+	finished_(false)
+{
+}
+
+hedged_request::~hedged_request()
+{
+}
+
+void hedged_request::start()
+{
+	started_ = hedging_policy::clock_type::now();
+	primary_running_ = true;
+	policy_->record_request();
+
+	timer_.expires_from_now(policy_->hedge_delay(origin_.str()));
+	timer_.async_wait(std::bind(&hedged_request::handle_timer, shared_from_this(), std::placeholders::_1));
+}
+
+bool hedged_request::commit(easy& attempt)
+{
+	// The first attempt to deliver response data wins. This way the sink only ever sees the data of a single attempt, and no response has to be buffered.
+	if (!winner_)
+	{
+		winner_ = &attempt;
+
+		if (primary_running_ && hedge_running_)
+		{
+			// Removing easy handles is not allowed from within libcurl's callbacks
+			primary_.get_io_service().post(std::bind(&hedged_request::cancel_loser, shared_from_this()));
+		}
+	}
+
+	return (winner_ == &attempt);
+}
+
+void hedged_request::handle_completion(easy& attempt, const asio::error_code& err)
+{
+	std::shared_ptr<hedged_request> self = shared_from_this();
+	bool is_primary = (&attempt == &primary_);
+
+	if (is_primary)
+	{
+		primary_running_ = false;
+	}
+	else
+	{
+		hedge_running_ = false;
+		attempt.multi_registered_ = false;
+	}
+
+	if (finished_)
+	{
+		return;
+	}
+
+	if (err == asio::error::operation_aborted)
+	{
+		// The hedge is only ever cancelled from within this class, whereas the primary is cancelled by the user
+		if (is_primary)
+		{
+			finish(err, 0);
+		}
+
+		return;
+	}
+
+	bool other_running = is_primary ? hedge_running_ : primary_running_;
+
+	if (winner_ == &attempt || (!winner_ && (!err || !other_running)))
+	{
+		finish(err, &attempt);
+	}
+
+	// Otherwise this attempt either lost, or failed while the other one might still succeed
+}
+
+void hedged_request::handle_timer(const asio::error_code& err)
+{
+	if (err || finished_ || winner_ || !primary_running_)
+	{
+		return;
+	}
+
+	if (!policy_->acquire_hedge())
+	{
+		return;
+	}
+
+	if (policy_->get_prefer_other_address() && !origin_.empty())
+	{
+		char* primary_ip = 0;
+		native::curl_easy_getinfo(primary_.native_handle(), native::CURLINFO_PRIMARY_IP, &primary_ip);
+
+		asio::ip::tcp::resolver::query query(origin_.host, std::to_string(static_cast<unsigned int>(origin_.port)));
+		resolver_.async_resolve(query, std::bind(&hedged_request::handle_resolve, shared_from_this(), std::placeholders::_1, std::placeholders::_2, std::string(primary_ip ? primary_ip : "")));
+	}
+	else
+	{
+		launch(std::string());
+	}
+}
+
+void hedged_request::handle_resolve(const asio::error_code& err, asio::ip::tcp::resolver::iterator it, std::string primary_ip)
+{
+	if (finished_ || winner_ || !primary_running_)
+	{
+		return;
+	}
+
+	std::string connect_to;
+
+	for (; !err && it != asio::ip::tcp::resolver::iterator(); ++it)
+	{
+		asio::ip::address address = it->endpoint().address();
+
+		if (address.to_string() != primary_ip)
+		{
+			std::string port = std::to_string(static_cast<unsigned int>(origin_.port));
+			std::string host = address.is_v6() ? "[" + address.to_string() + "]" : address.to_string();
+			connect_to = origin_.host_entry() + ":" + port + ":" + host + ":" + port;
+			break;
+		}
+	}
+
+	launch(connect_to);
+}
+
+void hedged_request::launch(const std::string& connect_to)
+{
+	hedge_ = primary_.duplicate();
+
+#if LIBCURL_VERSION_NUM >= 0x073100
+	if (!connect_to.empty())
+	{
+		hedge_->add_connect_to(connect_to);
+	}
+#endif
+
+	// The multi handle may complete the hedge right away, e.g. when the origin's circuit is open, so it has to be known as running beforehand
+	hedge_running_ = true;
+	hedge_->start_async_perform(&ignore_completion, shared_from_this());
+}
+
+void hedged_request::cancel_loser()
+{
+	if (finished_)
+	{
+		return;
+	}
+
+	if (winner_ == &primary_ && hedge_running_)
+	{
+		hedge_->cancel();
+	}
+	else if (winner_ == hedge_.get() && primary_running_)
+	{
+		// The primary's handler stays pending until the hedge completes
+		primary_running_ = false;
+		primary_.multi_->remove(&primary_);
+	}
+}
+
+void hedged_request::finish(const asio::error_code& err, easy* winner)
+{
+	finished_ = true;
+	timer_.cancel();
+	resolver_.cancel();
+
+	if (!err && winner)
+	{
+		policy_->record_latency(origin_.str(), hedging_policy::clock_type::now() - started_);
+	}
+
+	if (hedge_)
+	{
+		if (hedge_running_)
+		{
+			hedge_->cancel();
+		}
+
+		hedge_->hedge_.reset();
+
+		if (winner == hedge_.get())
+		{
+			// The primary keeps the winning hedge, whose status, timings and headers describe the response, including for the retry decision in complete
+			primary_.response_delivered_ = hedge_->response_delivered_;
+			primary_.response_headers_.swap(hedge_->response_headers_);
+			primary_.hedge_winner_ = hedge_;
+		}
+		else
+		{
+			// The hedge might be the caller of this function, so it is destroyed asynchronously
+			std::shared_ptr<easy> hedge = hedge_;
+			primary_.get_io_service().post([hedge]() {});
+		}
+
+		hedge_.reset();
+	}
+
+	if (primary_running_)
+	{
+		primary_running_ = false;
+		primary_.multi_->remove(&primary_);
+	}
+
+	primary_.complete(err);
+}
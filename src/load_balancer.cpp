@@ -0,0 +1,210 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Client-side load balancing across the addresses of an origin using power-of-two-choices
+*/
+
+#include <curl-asio/load_balancer.h>
+#include <curl-asio/origin.h>
+#include <algorithm>
+
+using namespace curl;
+
+// Latency assumed for endpoints without samples, which makes untried endpoints attractive without starving the others
+static const double initial_latency = 0.001;
+
+load_balancer::endpoint::endpoint():
+	in_flight(0),
+	requests(0),
+	latency(0.0)
+{
+}
+
+load_balancer::load_balancer():
+	smoothing_(0.2),
+	failure_penalty_(1.0),
+	random_(std::random_device()())
+{
+}
+
+void load_balancer::set_endpoints(const std::string& url, const std::vector<std::string>& addresses)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	endpoint_list& current = origins_[origin(url).str()];
+	endpoint_list updated;
+
+	for (std::vector<std::string>::const_iterator it = addresses.begin(); it != addresses.end(); ++it)
+	{
+		endpoint e;
+		e.address = *it;
+
+		for (endpoint_list::iterator existing = current.begin(); existing != current.end(); ++existing)
+		{
+			if (existing->address == *it)
+			{
+				e = *existing;
+				break;
+			}
+		}
+
+		updated.push_back(e);
+	}
+
+	current.swap(updated);
+}
+
+void load_balancer::async_resolve(asio::io_service& io_service, const std::string& url, resolve_handler_type handler)
+{
+	origin o(url);
+	std::shared_ptr<asio::ip::tcp::resolver> resolver(new asio::ip::tcp::resolver(io_service));
+	asio::ip::tcp::resolver::query query(o.host, std::to_string(static_cast<unsigned int>(o.port)));
+	resolver->async_resolve(query, std::bind(&load_balancer::handle_resolve, this, resolver, url, handler, std::placeholders::_1, std::placeholders::_2));
+}
+
+void load_balancer::handle_resolve(std::shared_ptr<asio::ip::tcp::resolver>, std::string url, resolve_handler_type handler, const asio::error_code& err, asio::ip::tcp::resolver::iterator it)
+{
+	if (!err)
+	{
+		std::vector<std::string> addresses;
+
+		for (; it != asio::ip::tcp::resolver::iterator(); ++it)
+		{
+			std::string address = it->endpoint().address().to_string();
+
+			if (std::find(addresses.begin(), addresses.end(), address) == addresses.end())
+			{
+				addresses.push_back(address);
+			}
+		}
+
+		set_endpoints(url, addresses);
+	}
+
+	handler(err);
+}
+
+void load_balancer::set_smoothing(double alpha)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	smoothing_ = std::min(std::max(alpha, 0.01), 1.0);
+}
+
+void load_balancer::set_failure_penalty(clock_type::duration penalty)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	failure_penalty_ = std::chrono::duration<double>(penalty).count();
+}
+
+std::vector<load_balancer::endpoint_stats> load_balancer::get_stats(const std::string& url)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::vector<endpoint_stats> stats;
+	origin_map::iterator it = origins_.find(origin(url).str());
+
+	if (it != origins_.end())
+	{
+		for (endpoint_list::iterator e = it->second.begin(); e != it->second.end(); ++e)
+		{
+			endpoint_stats s;
+			s.address = e->address;
+			s.in_flight = e->in_flight;
+			s.requests = e->requests;
+			s.latency = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(e->latency));
+			stats.push_back(s);
+		}
+	}
+
+	return stats;
+}
+
+std::string load_balancer::acquire(const std::string& origin)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	origin_map::iterator it = origins_.find(origin);
+
+	if (it == origins_.end() || it->second.empty())
+	{
+		return std::string();
+	}
+
+	endpoint_list& endpoints = it->second;
+	endpoint* chosen = &endpoints[0];
+
+	if (endpoints.size() > 1)
+	{
+		// Power of two choices: comparing two random endpoints avoids both the herding of always picking the best one and the overhead of comparing all of them
+		std::uniform_int_distribution<std::size_t> distribution(0, endpoints.size() - 1);
+		std::size_t first = distribution(random_);
+		std::size_t second = distribution(random_);
+
+		while (second == first)
+		{
+			second = distribution(random_);
+		}
+
+		chosen = (cost(endpoints[first]) <= cost(endpoints[second])) ? &endpoints[first] : &endpoints[second];
+	}
+
+	++chosen->in_flight;
+	++chosen->requests;
+	return chosen->address;
+}
+
+void load_balancer::record_result(const std::string& origin, const std::string& address, clock_type::duration latency, bool success)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	endpoint* e = find(origin, address);
+
+	if (e)
+	{
+		double sample = std::chrono::duration<double>(latency).count();
+
+		if (!success)
+		{
+			sample = std::max(sample, failure_penalty_);
+		}
+
+		e->latency = (e->latency == 0.0) ? sample : e->latency + smoothing_ * (sample - e->latency);
+
+		if (e->in_flight > 0)
+		{
+			--e->in_flight;
+		}
+	}
+}
+
+void load_balancer::release(const std::string& origin, const std::string& address)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	endpoint* e = find(origin, address);
+
+	if (e && e->in_flight > 0)
+	{
+		--e->in_flight;
+	}
+}
+
+load_balancer::endpoint* load_balancer::find(const std::string& origin, const std::string& address)
+{
+	origin_map::iterator it = origins_.find(origin);
+
+	if (it != origins_.end())
+	{
+		for (endpoint_list::iterator e = it->second.begin(); e != it->second.end(); ++e)
+		{
+			if (e->address == address)
+			{
+				return &*e;
+			}
+		}
+	}
+
+	return 0;
+}
+
+double load_balancer::cost(const endpoint& e) const
+{
+	return static_cast<double>(e.in_flight + 1) * std::max(e.latency, initial_latency);
+}
@@ -6,15 +6,29 @@
 	Integration of libcurl's multi interface with Boost.Asio
 */
 
+#include <curl-asio/bandwidth_shaper.h>
+#include <curl-asio/buffer_pool.h>
+#include <curl-asio/circuit_breaker.h>
 #include <curl-asio/easy.h>
 #include <curl-asio/error_code.h>
+#include <curl-asio/load_balancer.h>
 #include <curl-asio/multi.h>
+#include <curl-asio/origin.h>
+#include <curl-asio/rate_limiter.h>
 
 using namespace curl;
 
+// Requests share a rate limit bucket by key, or by origin if they have none
+static std::string rate_limit_key(easy* easy_handle)
+{
+	std::string key = easy_handle->get_rate_limit_key();
+	return key.empty() ? origin(easy_handle->get_url()).str() : key;
+}
+
 multi::multi(asio::io_service& io_service):
 	io_service_(io_service),
 	timeout_(io_service),
+	deferred_timer_(io_service),
 	still_running_(0)
 {
 	initref_ = initialization::ensure_initialization();
@@ -51,7 +65,7 @@ multi::~multi()
 void multi::add(easy* easy_handle)
 {
 	easy_handles_.insert(easy_handle);
-	add_handle(easy_handle->native_handle());
+	start(easy_handle);
 }
 
 void multi::remove(easy* easy_handle)
@@ -61,7 +75,205 @@ void multi::remove(easy* easy_handle)
 	if (it != easy_handles_.end())
 	{
 		easy_handles_.erase(it);
-		remove_handle(easy_handle->native_handle());
+		release_ticket(easy_handle);
+
+		if (rate_reserved_.erase(easy_handle) != 0 && rate_limiter_)
+		{
+			// Cancelled while waiting for its token
+			rate_limiter_->refund(rate_limit_key(easy_handle));
+		}
+
+		if (bandwidth_shaper_)
+		{
+			bandwidth_shaper_->remove(easy_handle);
+		}
+
+		deferred_index_type::iterator deferred_it = deferred_index_.find(easy_handle);
+
+		if (deferred_it != deferred_index_.end())
+		{
+			// The handle has not been passed to libcurl yet
+			deferred_.erase(deferred_it->second);
+			deferred_index_.erase(deferred_it);
+			schedule_deferred();
+		}
+		else
+		{
+			remove_handle(easy_handle->native_handle());
+		}
+	}
+}
+
+void multi::add_deferred(easy* easy_handle, std::chrono::steady_clock::time_point when)
+{
+	easy_handles_.insert(easy_handle);
+
+	deferred_map_type::iterator it = deferred_.insert(deferred_map_type::value_type(when, easy_handle));
+	deferred_index_[easy_handle] = it;
+
+	if (it == deferred_.begin())
+	{
+		schedule_deferred();
+	}
+}
+
+void multi::set_circuit_breaker(std::shared_ptr<circuit_breaker> breaker)
+{
+	circuit_breaker_ = breaker;
+}
+
+void multi::set_rate_limiter(std::shared_ptr<rate_limiter> limiter)
+{
+	rate_limiter_ = limiter;
+}
+
+void multi::set_bandwidth_shaper(std::shared_ptr<bandwidth_shaper> shaper)
+{
+	bandwidth_shaper_ = shaper;
+}
+
+void multi::set_load_balancer(std::shared_ptr<load_balancer> balancer)
+{
+	load_balancer_ = balancer;
+}
+
+void multi::set_buffer_pool(std::shared_ptr<buffer_pool> pool)
+{
+	buffer_pool_ = pool;
+}
+
+std::shared_ptr<buffer_pool> multi::get_buffer_pool()
+{
+	if (!buffer_pool_)
+	{
+		buffer_pool_ = std::make_shared<buffer_pool>();
+	}
+
+	return buffer_pool_;
+}
+
+void multi::start(easy* easy_handle)
+{
+	// Requests which come back from the deferred queue already hold a token
+	if (rate_limiter_ && rate_reserved_.erase(easy_handle) == 0)
+	{
+		std::chrono::steady_clock::duration wait = rate_limiter_->reserve(rate_limit_key(easy_handle));
+
+		if (wait > std::chrono::steady_clock::duration::zero())
+		{
+			rate_reserved_.insert(easy_handle);
+			add_deferred(easy_handle, std::chrono::steady_clock::now() + wait);
+			return;
+		}
+	}
+
+	if (!circuit_breaker_ && !load_balancer_ && !bandwidth_shaper_)
+	{
+		add_handle(easy_handle->native_handle());
+		return;
+	}
+
+	ticket t;
+	t.origin = origin(easy_handle->get_url()).str();
+	t.circuit_admitted = false;
+	t.circuit_probe = false;
+
+	if (circuit_breaker_)
+	{
+		if (!circuit_breaker_->admit(t.origin, t.circuit_probe))
+		{
+			// Fail fast without opening a socket or arming a timer. The request does not reach the origin, so it does not count against its rate either.
+			if (rate_limiter_)
+			{
+				rate_limiter_->refund(rate_limit_key(easy_handle));
+			}
+
+			easy_handles_.erase(easy_handle);
+			easy_handle->handle_completion(errc::wrapper::make_error_code(errc::wrapper::circuit_open));
+			return;
+		}
+
+		t.circuit_admitted = true;
+	}
+
+#if LIBCURL_VERSION_NUM >= 0x073100
+	if (load_balancer_ && !easy_handle->has_connect_to())
+	{
+		t.endpoint = load_balancer_->acquire(t.origin);
+
+		// Without an endpoint to offer, the address pinned for the previous transfer of this handle is cleared
+		asio::error_code ec;
+		easy_handle->set_endpoint(t.endpoint, ec);
+
+		if (ec && !t.endpoint.empty())
+		{
+			load_balancer_->release(t.origin, t.endpoint);
+			t.endpoint.clear();
+		}
+	}
+#endif
+
+	if (bandwidth_shaper_)
+	{
+		std::string class_key = easy_handle->get_bandwidth_class();
+		bandwidth_shaper_->add(easy_handle, class_key.empty() ? t.origin : class_key, easy_handle->get_bandwidth_weight());
+	}
+
+	if (t.circuit_admitted || !t.endpoint.empty())
+	{
+		tickets_[easy_handle] = t;
+	}
+
+	add_handle(easy_handle->native_handle());
+}
+
+void multi::record_result(easy* easy_handle, const asio::error_code& err)
+{
+	ticket_map::iterator it = tickets_.find(easy_handle);
+
+	if (it == tickets_.end())
+	{
+		return;
+	}
+
+	const ticket& t = it->second;
+	long response_code = 0;
+	native::curl_easy_getinfo(easy_handle->native_handle(), native::CURLINFO_RESPONSE_CODE, &response_code);
+	bool success = !circuit_breaker::is_failure(err, response_code);
+
+	if (t.circuit_admitted && circuit_breaker_)
+	{
+		circuit_breaker_->record_result(t.origin, t.circuit_probe, success);
+	}
+
+	if (!t.endpoint.empty() && load_balancer_)
+	{
+		double total_time = 0.0;
+		native::curl_easy_getinfo(easy_handle->native_handle(), native::CURLINFO_TOTAL_TIME, &total_time);
+		load_balancer_->record_result(t.origin, t.endpoint, std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(total_time)), success);
+	}
+
+	tickets_.erase(it);
+}
+
+void multi::release_ticket(easy* easy_handle)
+{
+	ticket_map::iterator it = tickets_.find(easy_handle);
+
+	if (it != tickets_.end())
+	{
+		// Cancelled requests do not tell anything about the origin, but their probe slot and in-flight count have to be returned
+		if (it->second.circuit_probe && circuit_breaker_)
+		{
+			circuit_breaker_->release_probe(it->second.origin);
+		}
+
+		if (!it->second.endpoint.empty() && load_balancer_)
+		{
+			load_balancer_->release(it->second.origin, it->second.endpoint);
+		}
+
+		tickets_.erase(it);
 	}
 }
 
@@ -187,6 +399,7 @@ void multi::process_messages()
 				ec = asio::error_code(msg->data.result, asio::system_category());
 			}
 
+			record_result(easy_handle, ec);
 			remove(easy_handle);
 			easy_handle->handle_completion(ec);
 		}
@@ -227,7 +440,13 @@ void multi::handle_socket_read(const asio::error_code& err, socket_info_ptr si)
 		if (err != asio::error::operation_aborted)
 		{
 			socket_action(si->socket->native_handle(), CURL_CSELECT_ERR);
-			process_messages();			
+			process_messages();
+		}
+		else if (si->socket && si->monitor_read)
+		{
+			// libcurl asked for the socket again while the cancelled operation was still pending
+			start_read_op(si);
+			return;
 		}
 
 		si->pending_read_op = false;
@@ -265,6 +484,12 @@ void multi::handle_socket_write(const asio::error_code& err, socket_info_ptr si)
 			socket_action(si->socket->native_handle(), CURL_CSELECT_ERR);
 			process_messages();
 		}
+		else if (si->socket && si->monitor_write)
+		{
+			// libcurl asked for the socket again while the cancelled operation was still pending
+			start_write_op(si);
+			return;
+		}
 
 		si->pending_write_op = false;
 	}
@@ -279,6 +504,39 @@ void multi::handle_timeout(const asio::error_code& err)
 	}
 }
 
+void multi::schedule_deferred()
+{
+	if (deferred_.empty())
+	{
+		deferred_timer_.cancel();
+	}
+	else
+	{
+		deferred_timer_.expires_at(deferred_.begin()->first);
+		deferred_timer_.async_wait(std::bind(&multi::handle_deferred, this, std::placeholders::_1));
+	}
+}
+
+void multi::handle_deferred(const asio::error_code& err)
+{
+	if (err)
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	while (!deferred_.empty() && deferred_.begin()->first <= now)
+	{
+		easy* easy_handle = deferred_.begin()->second;
+		deferred_index_.erase(easy_handle);
+		deferred_.erase(deferred_.begin());
+		start(easy_handle);
+	}
+
+	schedule_deferred();
+}
+
 multi::socket_info_ptr multi::get_socket_from_native(native::curl_socket_t native_socket)
 {
 	socket_map_type::iterator it = sockets_.find(native_socket);
@@ -333,15 +591,16 @@ int multi::timer(native::CURLM* native_multi, long timeout_ms, void* userp)
 {
 	multi* self = static_cast<multi*>(userp);
 
-	if (timeout_ms > 0)
+	if (timeout_ms >= 0)
 	{
+		// A timeout of zero requests immediate action. Calling back into libcurl from within this callback is not allowed, so it waits for the timer as well, which the destructor cancels.
 		self->timeout_.expires_from_now(std::chrono::milliseconds(timeout_ms));
 		self->timeout_.async_wait(std::bind(&multi::handle_timeout, self, std::placeholders::_1));
 	}
 	else
 	{
+		// -1 deletes the timer
 		self->timeout_.cancel();
-		self->handle_timeout(asio::error_code());
 	}
 
 	return 0;
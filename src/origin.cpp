@@ -0,0 +1,121 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Scheme, host and port of a URL, used to key per-origin state
+*/
+
+#include <curl-asio/origin.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+using namespace curl;
+
+static unsigned short default_port(const std::string& scheme)
+{
+	if (scheme == "http" || scheme == "ws")
+		return 80;
+	else if (scheme == "https" || scheme == "wss")
+		return 443;
+	else if (scheme == "ftp")
+		return 21;
+	else if (scheme == "ftps")
+		return 990;
+	else if (scheme == "sftp" || scheme == "scp")
+		return 22;
+	else
+		return 0;
+}
+
+static std::string to_lower(std::string str)
+{
+	std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+	return str;
+}
+
+origin::origin():
+	port(0)
+{
+}
+
+origin::origin(const std::string& url):
+	port(0)
+{
+	std::string::size_type authority_begin = 0;
+	std::string::size_type scheme_end = url.find("://");
+
+	if (scheme_end != std::string::npos)
+	{
+		scheme = to_lower(url.substr(0, scheme_end));
+		authority_begin = scheme_end + 3;
+	}
+	else
+	{
+		// libcurl guesses the protocol for URLs without a scheme, which is HTTP for anything but a few well-known host name prefixes
+		scheme = "http";
+	}
+
+	std::string::size_type authority_end = url.find_first_of("/?#", authority_begin);
+	std::string authority = url.substr(authority_begin, authority_end == std::string::npos ? std::string::npos : authority_end - authority_begin);
+
+	std::string::size_type at = authority.rfind('@');
+	if (at != std::string::npos)
+	{
+		authority.erase(0, at + 1);
+	}
+
+	std::string port_str;
+
+	if (!authority.empty() && authority[0] == '[')
+	{
+		std::string::size_type bracket = authority.find(']');
+		if (bracket == std::string::npos)
+		{
+			return;
+		}
+
+		host = authority.substr(1, bracket - 1);
+
+		if (bracket + 1 < authority.size() && authority[bracket + 1] == ':')
+		{
+			port_str = authority.substr(bracket + 2);
+		}
+	}
+	else
+	{
+		std::string::size_type colon = authority.find(':');
+		host = authority.substr(0, colon);
+
+		if (colon != std::string::npos)
+		{
+			port_str = authority.substr(colon + 1);
+		}
+	}
+
+	host = to_lower(host);
+	port = port_str.empty() ? default_port(scheme) : static_cast<unsigned short>(std::atoi(port_str.c_str()));
+}
+
+std::string origin::str() const
+{
+	if (empty())
+	{
+		return std::string();
+	}
+
+	return scheme + "://" + host_entry() + ":" + std::to_string(static_cast<unsigned int>(port));
+}
+
+std::string origin::host_entry() const
+{
+	if (host.find(':') != std::string::npos)
+	{
+		return "[" + host + "]";
+	}
+	else
+	{
+		return host;
+	}
+}
@@ -0,0 +1,245 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Chain of stages processing the response of a transfer on the write path
+*/
+
+#include <curl-asio/easy.h>
+#include <curl-asio/pipeline.h>
+
+using namespace curl;
+
+pipeline::pipeline():
+	root_(this),
+	holds_(0),
+	paused_(0),
+	pauses_(0)
+{
+}
+
+pipeline::~pipeline()
+{
+}
+
+std::size_t pipeline::add_tap(const std::string& name, tap_type tap)
+{
+	stage& s = add_stage(stage::tap, name);
+	s.tap_function = tap;
+	return stages_.size() - 1;
+}
+
+std::size_t pipeline::add_transform(const std::string& name, transform_type transform)
+{
+	stage& s = add_stage(stage::transform, name);
+	s.transform_function = transform;
+	return stages_.size() - 1;
+}
+
+pipeline& pipeline::add_branch(const std::string& name)
+{
+	stage& s = add_stage(stage::branch, name);
+	s.branch_pipeline = std::make_shared<pipeline>();
+	s.branch_pipeline->root_ = root_;
+	return *s.branch_pipeline;
+}
+
+void pipeline::hold(std::size_t stage)
+{
+	if (!stages_.at(stage).held)
+	{
+		stages_[stage].held = true;
+		++stages_[stage].stats.holds;
+		++root_->holds_;
+	}
+}
+
+void pipeline::release(std::size_t stage)
+{
+	if (stages_.at(stage).held)
+	{
+		stages_[stage].held = false;
+
+		if (--root_->holds_ == 0 && root_->paused_)
+		{
+			// libcurl delivers the chunk it held back from within curl_easy_pause
+			easy* easy_handle = root_->paused_;
+			root_->paused_ = 0;
+
+			asio::error_code ec;
+			easy_handle->release_pause(easy::pause_recv, easy::pause_by_sink, ec);
+		}
+	}
+}
+
+std::vector<pipeline::stage_stats> pipeline::get_stats() const
+{
+	std::vector<stage_stats> stats;
+	collect_stats(stats);
+	return stats;
+}
+
+void pipeline::reset_stats()
+{
+	for (std::size_t i = 0; i < stages_.size(); ++i)
+	{
+		stages_[i].stats.calls = 0;
+		stages_[i].stats.bytes = 0;
+		stages_[i].stats.time = std::chrono::steady_clock::duration::zero();
+		stages_[i].stats.holds = 0;
+
+		if (stages_[i].branch_pipeline)
+		{
+			stages_[i].branch_pipeline->reset_stats();
+		}
+	}
+
+	pauses_ = 0;
+}
+
+pipeline::stage& pipeline::add_stage(stage::kind_t kind, const std::string& name)
+{
+	stages_.push_back(stage());
+	stage& s = stages_.back();
+	s.kind = kind;
+	s.held = false;
+	s.stats.name = name;
+	s.stats.calls = 0;
+	s.stats.bytes = 0;
+	s.stats.time = std::chrono::steady_clock::duration::zero();
+	s.stats.holds = 0;
+	return s;
+}
+
+void pipeline::reset()
+{
+	paused_ = 0;
+}
+
+std::size_t pipeline::deliver(easy* easy_handle, const char* data, std::size_t size)
+{
+	if (holds_ > 0)
+	{
+		paused_ = easy_handle;
+		++pauses_;
+		return easy::sink_pause;
+	}
+
+	// An empty buffer marks the end of the response to the stages
+	if (size == 0)
+	{
+		return 0;
+	}
+
+	return run(asio::const_buffer(data, size)) ? size : 0;
+}
+
+bool pipeline::run(asio::const_buffer data, std::size_t first)
+{
+	for (std::size_t i = first; i < stages_.size(); ++i)
+	{
+		stage& s = stages_[i];
+		bool ok;
+
+		++s.stats.calls;
+		s.stats.bytes += asio::buffer_size(data);
+
+		if (s.kind == stage::branch)
+		{
+			// The stages of the branch account for themselves
+			ok = s.branch_pipeline->run(data);
+		}
+		else
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			if (s.kind == stage::tap)
+			{
+				ok = s.tap_function(data);
+			}
+			else
+			{
+				s.output.clear();
+				ok = s.transform_function(data, s.output);
+			}
+
+			s.stats.time += std::chrono::steady_clock::now() - start;
+		}
+
+		if (!ok)
+		{
+			return false;
+		}
+
+		if (s.kind == stage::transform)
+		{
+			if (s.output.empty())
+			{
+				return true;
+			}
+
+			data = asio::buffer(s.output);
+		}
+	}
+
+	return true;
+}
+
+bool pipeline::finish(std::size_t first)
+{
+	for (std::size_t i = first; i < stages_.size(); ++i)
+	{
+		stage& s = stages_[i];
+		bool ok;
+
+		++s.stats.calls;
+
+		if (s.kind == stage::branch)
+		{
+			ok = s.branch_pipeline->finish();
+		}
+		else
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			if (s.kind == stage::tap)
+			{
+				ok = s.tap_function(asio::const_buffer());
+			}
+			else
+			{
+				s.output.clear();
+				ok = s.transform_function(asio::const_buffer(), s.output);
+			}
+
+			s.stats.time += std::chrono::steady_clock::now() - start;
+
+			// What the transform held back is data to the stages behind it, which only then learn that the response ended
+			if (ok && s.kind == stage::transform && !s.output.empty())
+			{
+				ok = run(asio::buffer(s.output), i + 1);
+			}
+		}
+
+		if (!ok)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void pipeline::collect_stats(std::vector<stage_stats>& stats) const
+{
+	for (std::size_t i = 0; i < stages_.size(); ++i)
+	{
+		stats.push_back(stages_[i].stats);
+
+		if (stages_[i].branch_pipeline)
+		{
+			stages_[i].branch_pipeline->collect_stats(stats);
+		}
+	}
+}
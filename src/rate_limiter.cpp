@@ -0,0 +1,116 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Token-bucket request rate limits per origin or per user-supplied key
+*/
+
+#include <curl-asio/rate_limiter.h>
+#include <algorithm>
+
+using namespace curl;
+
+rate_limiter::bucket::bucket():
+	rate(0.0),
+	burst(0.0),
+	tokens(0.0),
+	explicit_limit(false)
+{
+}
+
+rate_limiter::rate_limiter():
+	default_rate_(0.0),
+	default_burst_(1.0),
+	throttled_(0)
+{
+}
+
+void rate_limiter::set_default_limit(double rate, double burst)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	default_rate_ = std::max(rate, 0.0);
+	default_burst_ = std::max(burst, 1.0);
+
+	for (bucket_map::iterator it = buckets_.begin(); it != buckets_.end(); ++it)
+	{
+		if (!it->second.explicit_limit)
+		{
+			it->second.rate = default_rate_;
+			it->second.burst = default_burst_;
+		}
+	}
+}
+
+void rate_limiter::set_limit(const std::string& key, double rate, double burst)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	bucket& b = buckets_[key];
+
+	if (!b.explicit_limit && b.rate == 0.0)
+	{
+		// A new bucket starts full
+		b.tokens = std::max(burst, 1.0);
+		b.updated_at = clock_type::now();
+	}
+
+	b.rate = std::max(rate, 0.0);
+	b.burst = std::max(burst, 1.0);
+	b.explicit_limit = true;
+}
+
+rate_limiter::clock_type::duration rate_limiter::reserve(const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	clock_type::time_point now = clock_type::now();
+	bucket_map::iterator it = buckets_.find(key);
+
+	if (it == buckets_.end())
+	{
+		if (default_rate_ == 0.0)
+		{
+			return clock_type::duration::zero();
+		}
+
+		bucket b;
+		b.rate = default_rate_;
+		b.burst = default_burst_;
+		b.tokens = default_burst_;
+		b.updated_at = now;
+		it = buckets_.insert(bucket_map::value_type(key, b)).first;
+	}
+
+	bucket& b = it->second;
+
+	if (b.rate == 0.0)
+	{
+		return clock_type::duration::zero();
+	}
+
+	// Buckets are refilled lazily, so idle keys cost nothing
+	double elapsed = std::chrono::duration<double>(now - b.updated_at).count();
+	b.tokens = std::min(b.tokens + elapsed * b.rate, b.burst);
+	b.updated_at = now;
+
+	// The balance may go negative: each waiting request holds a reservation for a later token, which spaces them out evenly
+	b.tokens -= 1.0;
+
+	if (b.tokens >= 0.0)
+	{
+		return clock_type::duration::zero();
+	}
+
+	++throttled_;
+	return std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(-b.tokens / b.rate));
+}
+
+void rate_limiter::refund(const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	bucket_map::iterator it = buckets_.find(key);
+
+	if (it != buckets_.end() && it->second.rate != 0.0)
+	{
+		it->second.tokens = std::min(it->second.tokens + 1.0, it->second.burst);
+	}
+}
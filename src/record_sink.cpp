@@ -0,0 +1,270 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Splits streamed responses into NDJSON records or server-sent events
+*/
+
+#include <curl-asio/record_sink.h>
+#include <cstring>
+
+using namespace curl;
+
+static const char utf8_bom[] = "\xef\xbb\xbf";
+
+template <std::size_t N>
+static inline bool field_is(const char* name, std::size_t size, const char (&expected)[N])
+{
+	return size == N - 1 && std::memcmp(name, expected, size) == 0;
+}
+
+record_sink::record_sink(format fmt, handler_type handler, std::size_t max_record_size):
+	format_(fmt),
+	handler_(handler),
+	max_record_size_(max_record_size),
+	started_(false),
+	has_data_(false),
+	data_in_place_(false),
+	data_view_(0),
+	data_view_size_(0),
+	retry_(-1),
+	records_(0),
+	copied_records_(0)
+{
+}
+
+record_sink::~record_sink()
+{
+}
+
+void record_sink::reset()
+{
+	started_ = false;
+	carry_.clear();
+	has_data_ = false;
+	data_in_place_ = false;
+	data_view_ = 0;
+	data_view_size_ = 0;
+	data_.clear();
+	event_type_.clear();
+	pending_event_id_ = last_event_id_;
+}
+
+bool record_sink::write(const char* data, std::size_t size)
+{
+	const char* end = data + size;
+
+	if (!started_ && size > 0)
+	{
+		started_ = true;
+
+		// Skipping a byte order mark is only attempted at the very start, which is where servers put it
+		if (size >= 3 && std::memcmp(data, utf8_bom, 3) == 0)
+		{
+			data += 3;
+		}
+	}
+
+	const char* line = data;
+	const char* p = data;
+
+	// The C libraries' memchr is vectorized already; a hand-written SSE2 search was no faster, as short records are bound by the work per record
+	while (p < end && (p = static_cast<const char*>(std::memchr(p, '\n', end - p))) != 0)
+	{
+		if (!end_line(line, p))
+		{
+			return false;
+		}
+
+		line = ++p;
+	}
+
+	// Whatever is left of the piece must outlive it
+	if (line < end)
+	{
+		if (carry_.size() + (end - line) > max_record_size_)
+		{
+			return false;
+		}
+
+		carry_.append(line, end - line);
+	}
+
+	if (has_data_ && data_in_place_)
+	{
+		data_.assign(data_view_, data_view_size_);
+		data_in_place_ = false;
+	}
+
+	return true;
+}
+
+bool record_sink::finish()
+{
+	bool ok = true;
+
+	if (format_ == ndjson && !carry_.empty())
+	{
+		ok = handle_line(carry_.data(), carry_.size(), false);
+	}
+
+	reset();
+	return ok;
+}
+
+bool record_sink::end_line(const char* begin, const char* end)
+{
+	if (carry_.empty())
+	{
+		return handle_line(begin, end - begin, true);
+	}
+
+	if (carry_.size() + (end - begin) > max_record_size_)
+	{
+		return false;
+	}
+
+	carry_.append(begin, end - begin);
+	bool ok = handle_line(carry_.data(), carry_.size(), false);
+	carry_.clear();
+	return ok;
+}
+
+bool record_sink::handle_line(const char* line, std::size_t size, bool in_place)
+{
+	if (size > 0 && line[size - 1] == '\r')
+	{
+		--size;
+	}
+
+	if (format_ == ndjson)
+	{
+		return size == 0 || dispatch(asio::const_buffer(line, size), in_place);
+	}
+
+	if (size == 0)
+	{
+		// A blank line commits the ID given so far, and dispatches the event if it has any data
+		last_event_id_ = pending_event_id_;
+
+		if (!has_data_)
+		{
+			event_type_.clear();
+			return true;
+		}
+
+		bool ok = data_in_place_ ? dispatch(asio::const_buffer(data_view_, data_view_size_), true) : dispatch(asio::buffer(data_), false);
+		has_data_ = false;
+		data_in_place_ = false;
+		data_.clear();
+		event_type_.clear();
+		return ok;
+	}
+
+	if (line[0] == ':')
+	{
+		return true;
+	}
+
+	return handle_field(line, size, in_place);
+}
+
+bool record_sink::handle_field(const char* line, std::size_t size, bool in_place)
+{
+	const char* colon = static_cast<const char*>(std::memchr(line, ':', size));
+	std::size_t name_size = colon ? colon - line : size;
+	const char* value = colon ? colon + 1 : line + size;
+	std::size_t value_size = size - (value - line);
+
+	if (value_size > 0 && value[0] == ' ')
+	{
+		++value;
+		--value_size;
+	}
+
+	if (field_is(line, name_size, "data"))
+	{
+		if (!has_data_)
+		{
+			has_data_ = true;
+			data_in_place_ = in_place;
+
+			if (in_place)
+			{
+				data_view_ = value;
+				data_view_size_ = value_size;
+			}
+			else
+			{
+				data_.assign(value, value_size);
+			}
+
+			return true;
+		}
+
+		// Further data lines are joined in the sink's buffer
+		if (data_in_place_)
+		{
+			data_.assign(data_view_, data_view_size_);
+			data_in_place_ = false;
+		}
+
+		if (data_.size() + 1 + value_size > max_record_size_)
+		{
+			return false;
+		}
+
+		data_ += '\n';
+		data_.append(value, value_size);
+	}
+	else if (field_is(line, name_size, "event"))
+	{
+		event_type_.assign(value, value_size);
+	}
+	else if (field_is(line, name_size, "id"))
+	{
+		if (!std::memchr(value, '\0', value_size))
+		{
+			pending_event_id_.assign(value, value_size);
+		}
+	}
+	else if (field_is(line, name_size, "retry"))
+	{
+		long retry = 0;
+		std::size_t i = 0;
+
+		for (; i < value_size && value[i] >= '0' && value[i] <= '9' && retry < 100000000; ++i)
+		{
+			retry = retry * 10 + (value[i] - '0');
+		}
+
+		if (value_size > 0 && i == value_size)
+		{
+			retry_ = retry;
+		}
+	}
+
+	return true;
+}
+
+bool record_sink::dispatch(const asio::const_buffer& data, bool in_place)
+{
+	++records_;
+
+	if (!in_place)
+	{
+		++copied_records_;
+	}
+
+	record r;
+	r.data = data;
+
+	if (format_ == sse)
+	{
+		r.event = asio::buffer(event_type_);
+		r.id = asio::buffer(last_event_id_);
+	}
+
+	return handler_(r);
+}
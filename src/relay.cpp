@@ -0,0 +1,345 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Relays the body of a transfer to or from an asio stream with backpressure
+*/
+
+#include <curl-asio/easy.h>
+#include <curl-asio/relay.h>
+#include <curl-asio/upload_stream.h>
+#include <algorithm>
+
+using namespace curl;
+
+relay::relay(easy& easy_handle, std::size_t buffer_size, std::size_t max_buffers):
+	easy_(easy_handle),
+	upload_(0),
+	buffer_size_(buffer_size),
+	max_buffers_(std::max<std::size_t>(max_buffers, 1)),
+	stream_busy_(false),
+	curl_busy_(false),
+	paused_(false),
+	eof_(false),
+	transfer_done_(false),
+	upload_size_(-1),
+	bytes_relayed_(0),
+	pauses_(0)
+{
+}
+
+relay::~relay()
+{
+}
+
+void relay::start(handler_type handler)
+{
+	recycle();
+	handler_ = handler;
+	writer_ = stream_writer_type();
+	reader_ = stream_reader_type();
+	upload_ = 0;
+	stream_busy_ = false;
+	curl_busy_ = false;
+	paused_ = false;
+	eof_ = false;
+	transfer_done_ = false;
+	upload_size_ = -1;
+	stream_error_ = asio::error_code();
+	transfer_error_ = asio::error_code();
+	bytes_relayed_ = 0;
+	pauses_ = 0;
+}
+
+void relay::start_download(stream_writer_type writer, handler_type handler)
+{
+	start(handler);
+	writer_ = writer;
+
+	easy_.set_buffer_sink(std::bind(&relay::deliver, this, std::placeholders::_1));
+	easy_.buffer_sink_by_library_ = true;
+	easy_.async_perform(std::bind(&relay::handle_transfer, this, std::placeholders::_1));
+}
+
+std::size_t relay::deliver(asio::const_buffer data)
+{
+	if (stream_error_)
+	{
+		return 0;
+	}
+
+	std::size_t size = asio::buffer_size(data);
+	const char* bytes = asio::buffer_cast<const char*>(data);
+
+	// libcurl hands over at most CURLOPT_BUFFERSIZE bytes at a time, which are collected in the newest buffer as long as it is not being written yet
+	if (!queue_.empty() && !(stream_busy_ && queue_.size() == 1) && queue_.back().size() + size <= buffer_size_)
+	{
+		queue_.back().append(bytes, size);
+	}
+	else if (queue_.size() < max_buffers_)
+	{
+		queue_.push_back(std::string());
+
+		if (!spare_.empty())
+		{
+			queue_.back().swap(spare_.back());
+			spare_.pop_back();
+		}
+
+		queue_.back().reserve(std::max(buffer_size_, size));
+		queue_.back().assign(bytes, size);
+	}
+	else
+	{
+		// libcurl delivers the same data again once the transfer is resumed by handle_write
+		paused_ = true;
+		++pauses_;
+		return easy::sink_pause;
+	}
+
+	bytes_relayed_ += size;
+
+	if (!stream_busy_)
+	{
+		write_next();
+	}
+
+	return size;
+}
+
+void relay::write_next()
+{
+	stream_busy_ = true;
+	writer_(asio::buffer(queue_.front()), std::bind(&relay::handle_write, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void relay::handle_write(const asio::error_code& err, std::size_t)
+{
+	stream_busy_ = false;
+
+	if (err)
+	{
+		fail(err);
+		return;
+	}
+
+	spare_.push_back(std::string());
+	spare_.back().swap(queue_.front());
+	spare_.back().clear();
+	queue_.pop_front();
+
+	if (!queue_.empty())
+	{
+		write_next();
+	}
+
+	if (paused_)
+	{
+		// The relay's pauses are held by the sink, so a pause the application holds stays in place. libcurl might deliver the data it held back from within curl_easy_pause.
+		paused_ = false;
+
+		asio::error_code ec;
+		easy_.release_pause(easy::pause_recv, easy::pause_by_sink, ec);
+	}
+
+	check_completion();
+}
+
+void relay::start_upload(stream_reader_type reader, native::curl_off_t size, handler_type handler)
+{
+	start(handler);
+	reader_ = reader;
+	upload_size_ = size;
+
+	asio::error_code ec;
+	upload_ = &easy_.upload_stream(size, ec);
+
+	if (ec)
+	{
+		easy_.get_io_service().post(std::bind(&relay::handle_transfer, this, ec));
+		return;
+	}
+
+	easy_.async_perform(std::bind(&relay::handle_transfer, this, std::placeholders::_1));
+	read_next();
+}
+
+void relay::read_next()
+{
+	if (stream_busy_ || eof_ || stream_error_ || transfer_done_)
+	{
+		return;
+	}
+
+	std::size_t want = buffer_size_;
+
+	if (upload_size_ >= 0)
+	{
+		// Stopping at the end of the body leaves the stream positioned at whatever follows it, such as the client's next request
+		if (bytes_relayed_ >= upload_size_)
+		{
+			eof_ = true;
+
+			if (!curl_busy_)
+			{
+				send_next();
+			}
+
+			return;
+		}
+
+		want = static_cast<std::size_t>(std::min<native::curl_off_t>(want, upload_size_ - bytes_relayed_));
+	}
+
+	if (queue_.size() >= max_buffers_)
+	{
+		// Reading resumes once libcurl has taken a buffer, which leaves the socket's receive window to throttle the client
+		++pauses_;
+		return;
+	}
+
+	if (!spare_.empty())
+	{
+		reading_.swap(spare_.back());
+		spare_.pop_back();
+	}
+
+	reading_.resize(want);
+	stream_busy_ = true;
+	reader_(asio::buffer(&reading_[0], reading_.size()), std::bind(&relay::handle_read, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void relay::handle_read(const asio::error_code& err, std::size_t size)
+{
+	stream_busy_ = false;
+
+	if (size > 0 && !transfer_done_)
+	{
+		reading_.resize(size);
+		queue_.push_back(std::string());
+		queue_.back().swap(reading_);
+		bytes_relayed_ += size;
+	}
+	else
+	{
+		spare_.push_back(std::string());
+		spare_.back().swap(reading_);
+	}
+
+	if (transfer_done_)
+	{
+		check_completion();
+		return;
+	}
+
+	if (err == asio::error::eof)
+	{
+		eof_ = true;
+	}
+	else if (err)
+	{
+		fail(err);
+		return;
+	}
+
+	if (!curl_busy_)
+	{
+		send_next();
+	}
+
+	read_next();
+}
+
+void relay::send_next()
+{
+	if (queue_.empty())
+	{
+		if (eof_)
+		{
+			upload_->close();
+		}
+
+		return;
+	}
+
+	curl_busy_ = true;
+	asio::async_write(*upload_, asio::buffer(queue_.front()), std::bind(&relay::handle_send, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void relay::handle_send(const asio::error_code& err, std::size_t)
+{
+	curl_busy_ = false;
+
+	if (err)
+	{
+		// The transfer has finished or failed, which handle_transfer reports
+		recycle();
+		check_completion();
+		return;
+	}
+
+	spare_.push_back(std::string());
+	spare_.back().swap(queue_.front());
+	spare_.back().clear();
+	queue_.pop_front();
+
+	send_next();
+	read_next();
+	check_completion();
+}
+
+void relay::handle_transfer(const asio::error_code& err)
+{
+	transfer_done_ = true;
+	transfer_error_ = err;
+
+	if (reader_)
+	{
+		// Whatever the upstream server did not take is dropped
+		recycle();
+	}
+
+	check_completion();
+}
+
+void relay::fail(const asio::error_code& err)
+{
+	stream_error_ = err;
+	recycle();
+
+	if (!transfer_done_)
+	{
+		// The cancelled transfer completes through handle_transfer
+		easy_.cancel();
+	}
+	else
+	{
+		check_completion();
+	}
+}
+
+void relay::recycle()
+{
+	while (!queue_.empty())
+	{
+		spare_.push_back(std::string());
+		spare_.back().swap(queue_.front());
+		spare_.back().clear();
+		queue_.pop_front();
+	}
+
+	paused_ = false;
+}
+
+void relay::check_completion()
+{
+	if (!handler_ || !transfer_done_ || stream_busy_ || curl_busy_ || !queue_.empty())
+	{
+		return;
+	}
+
+	handler_type handler;
+	handler.swap(handler_);
+	handler(stream_error_ ? stream_error_ : transfer_error_);
+}
@@ -0,0 +1,149 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Retries of transient failures with decorrelated jitter and a per-origin retry budget
+*/
+
+#include <curl-asio/retry.h>
+#include <asio/error.hpp>
+#include <algorithm>
+
+using namespace curl;
+
+retry_policy::retry_policy():
+	max_attempts_(3),
+	base_delay_(std::chrono::milliseconds(100)),
+	max_delay_(std::chrono::seconds(10)),
+	refill_ratio_(0.1),
+	max_tokens_(10.0),
+	random_(std::random_device()()),
+	retries_sent_(0)
+{
+	add_retryable_error(errc::easy::could_not_connect);
+	add_retryable_error(errc::easy::operation_timedout);
+	add_retryable_error(errc::easy::got_nothing);
+	add_retryable_error(errc::easy::send_error);
+	add_retryable_error(errc::easy::recv_error);
+	add_retryable_status(502);
+	add_retryable_status(503);
+	add_retryable_status(504);
+}
+
+void retry_policy::set_max_attempts(unsigned int max_attempts)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	max_attempts_ = std::max(max_attempts, 1u);
+}
+
+void retry_policy::set_backoff(clock_type::duration base, clock_type::duration cap)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	base_delay_ = base;
+	max_delay_ = std::max(base, cap);
+}
+
+void retry_policy::set_retry_budget(double refill_ratio, double max_tokens)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	refill_ratio_ = refill_ratio;
+	max_tokens_ = max_tokens;
+}
+
+void retry_policy::add_retryable_error(errc::easy::easy_error_codes code)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	retryable_errors_.insert(static_cast<int>(code));
+}
+
+void retry_policy::add_retryable_status(long response_code)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	retryable_statuses_.insert(response_code);
+}
+
+void retry_policy::clear_retryable_errors()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	retryable_errors_.clear();
+}
+
+void retry_policy::clear_retryable_statuses()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	retryable_statuses_.clear();
+}
+
+bool retry_policy::is_retryable(const asio::error_code& err, long response_code) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (err)
+	{
+		// Transfer results are reported as libcurl error codes in the system category, see multi::process_messages
+		return (err.category() == asio::system_category() && err != asio::error::operation_aborted && retryable_errors_.count(err.value()) != 0);
+	}
+	else
+	{
+		return (retryable_statuses_.count(response_code) != 0);
+	}
+}
+
+bool retry_policy::is_retryable_status(long response_code) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (retryable_statuses_.count(response_code) != 0);
+}
+
+retry_policy::clock_type::duration retry_policy::next_delay(clock_type::duration previous_delay)
+{
+	// "Decorrelated jitter": spreads retries of simultaneously failed requests while still backing off exponentially
+	std::lock_guard<std::mutex> lock(mutex_);
+	clock_type::rep low = base_delay_.count();
+	clock_type::rep high = std::max(low, std::max(previous_delay, base_delay_).count() * 3);
+	std::uniform_int_distribution<clock_type::rep> distribution(low, high);
+	return std::min(clock_type::duration(distribution(random_)), max_delay_);
+}
+
+bool retry_policy::acquire_retry(const std::string& origin)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	bucket_map::iterator it = buckets_.insert(bucket_map::value_type(origin, max_tokens_)).first;
+
+	if (it->second < 1.0)
+	{
+		return false;
+	}
+
+	it->second -= 1.0;
+	++retries_sent_;
+	return true;
+}
+
+void retry_policy::release_retry(const std::string& origin)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	bucket_map::iterator it = buckets_.find(origin);
+
+	if (it != buckets_.end())
+	{
+		it->second = std::min(it->second + 1.0, max_tokens_);
+	}
+
+	if (retries_sent_ > 0)
+	{
+		--retries_sent_;
+	}
+}
+
+void retry_policy::record_success(const std::string& origin)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	bucket_map::iterator it = buckets_.find(origin);
+
+	if (it != buckets_.end())
+	{
+		it->second = std::min(it->second + refill_ratio_, max_tokens_);
+	}
+}
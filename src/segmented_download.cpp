@@ -0,0 +1,812 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Downloads an object in ranges over several connections into a memory-mapped file
+*/
+
+#include <curl-asio/download_journal.h>
+#include <curl-asio/easy.h>
+#include <curl-asio/error_code.h>
+#include <curl-asio/multi.h>
+#include <curl-asio/segmented_download.h>
+#include <curl-asio/string_list.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace curl;
+
+static const std::size_t no_index = static_cast<std::size_t>(-1);
+
+struct segmented_download::operation
+{
+	struct segment
+	{
+		std::uint64_t begin;
+		std::uint64_t position;
+		std::uint64_t end;
+		std::size_t connection;
+		std::size_t attempts;
+	};
+
+	struct connection
+	{
+		easy* handle;
+		std::size_t segment;
+		std::size_t mirror;
+		bool checked;
+		bool rejected;
+		bool changed;
+	};
+
+	asio::io_service* io_service;
+	std::shared_ptr<checkpoint_worker> worker;
+	handler_type handler;
+	std::string path;
+	std::vector<std::string> urls;
+	std::string etag;
+	std::string last_modified;
+	std::string validator;
+	std::shared_ptr<download_journal> journal;
+	std::shared_ptr<asio::steady_timer> timer;
+	easy* head;
+	std::vector<connection> connections;
+	std::vector<segment> segments;
+	std::uint64_t size;
+	std::uint64_t min_segment_size;
+	std::size_t max_attempts;
+	bool ranges;
+	int file;
+	char* mapping;
+	std::uint64_t received;
+	std::uint64_t resumed;
+	std::size_t splits;
+	bool completed;
+	bool finished;
+	bool checkpointing;
+	asio::error_code error;
+};
+
+// Saves are queued on an io_service of their own, which the thread runs until the last operation using it is gone
+struct segmented_download::checkpoint_worker
+{
+	asio::io_service io_service;
+	std::unique_ptr<asio::io_service::work> work;
+	std::thread thread;
+
+	checkpoint_worker():
+		work(new asio::io_service::work(io_service))
+	{
+		thread = std::thread(std::bind(&checkpoint_worker::run, this));
+	}
+
+	~checkpoint_worker()
+	{
+		work.reset();
+		thread.join();
+	}
+
+	void run()
+	{
+		io_service.run();
+	}
+};
+
+// Offset of the first byte a Content-Range field announces
+static bool parse_range_start(const std::string& content_range, std::uint64_t& start)
+{
+	std::size_t pos = content_range.find_first_of("0123456789");
+
+	if (pos == std::string::npos)
+	{
+		return false;
+	}
+
+	start = 0;
+
+	for (; pos < content_range.size() && content_range[pos] >= '0' && content_range[pos] <= '9'; ++pos)
+	{
+		start = start * 10 + (content_range[pos] - '0');
+	}
+
+	return pos < content_range.size() && content_range[pos] == '-';
+}
+
+// Shares the ranges out into segments of about equal size, one per connection unless that makes them smaller than the minimum
+static void add_segments(std::vector<segmented_download::segment_info>& segments, const std::vector<download_journal::range_type>& ranges, std::size_t connections, std::uint64_t min_segment_size)
+{
+	std::uint64_t missing = 0;
+
+	for (std::size_t i = 0; i < ranges.size(); ++i)
+	{
+		missing += ranges[i].second - ranges[i].first;
+	}
+
+	std::uint64_t target = std::max<std::uint64_t>(min_segment_size, (missing + connections - 1) / connections);
+
+	for (std::size_t i = 0; i < ranges.size(); ++i)
+	{
+		std::uint64_t size = ranges[i].second - ranges[i].first;
+		std::uint64_t count = std::max<std::uint64_t>(size / target, 1);
+
+		for (std::uint64_t j = 0; j < count; ++j)
+		{
+			segmented_download::segment_info segment;
+			segment.begin = ranges[i].first + size * j / count;
+			segment.position = segment.begin;
+			segment.end = ranges[i].first + size * (j + 1) / count;
+			segment.active = false;
+			segments.push_back(segment);
+		}
+	}
+}
+
+segmented_download::segmented_download(multi& multi_handle):
+	multi_(multi_handle),
+	prototype_(new easy(multi_handle)),
+	connections_(4),
+	min_segment_size_(1024 * 1024),
+	max_attempts_(3),
+	size_(0),
+	size_set_(false)
+{
+}
+
+segmented_download::~segmented_download()
+{
+	cancel();
+}
+
+void segmented_download::add_url(const std::string& url)
+{
+	urls_.push_back(url);
+}
+
+void segmented_download::set_connections(std::size_t connections)
+{
+	connections_ = std::max<std::size_t>(connections, 1);
+}
+
+void segmented_download::set_min_segment_size(std::uint64_t size)
+{
+	min_segment_size_ = std::max<std::uint64_t>(size, 1);
+}
+
+void segmented_download::set_max_attempts(std::size_t attempts)
+{
+	max_attempts_ = std::max<std::size_t>(attempts, 1);
+}
+
+void segmented_download::set_size(std::uint64_t size)
+{
+	size_ = size;
+	size_set_ = true;
+}
+
+void segmented_download::set_journal(std::shared_ptr<download_journal> journal)
+{
+	journal_ = journal;
+}
+
+void segmented_download::async_download(const std::string& path, handler_type handler)
+{
+	if (urls_.empty())
+	{
+		throw std::runtime_error("attempt to perform segmented download without any URLs");
+	}
+
+	// Cancel the previous operation, if any
+	cancel();
+	handles_.clear();
+
+	operation_ptr op(new operation());
+	op->io_service = &multi_.get_io_service();
+	op->handler = handler;
+	op->path = path;
+	op->urls = urls_;
+	op->journal = journal_;
+	op->head = 0;
+	op->size = size_;
+	op->min_segment_size = min_segment_size_;
+	op->max_attempts = max_attempts_;
+	op->ranges = true;
+	op->file = -1;
+	op->mapping = 0;
+	op->received = 0;
+	op->resumed = 0;
+	op->splits = 0;
+	op->completed = false;
+	op->finished = false;
+	op->checkpointing = false;
+
+	if (journal_)
+	{
+		if (!checkpoint_worker_)
+		{
+			checkpoint_worker_ = std::make_shared<checkpoint_worker>();
+		}
+
+		op->worker = checkpoint_worker_;
+	}
+
+	// Each connection keeps one handle for all of its segments, which lets libcurl reuse the connection
+	for (std::size_t i = 0; i < connections_; ++i)
+	{
+		handles_.push_back(prototype_->duplicate());
+
+		operation::connection c;
+		c.handle = handles_.back().get();
+		c.segment = no_index;
+		c.mirror = i % urls_.size();
+		c.checked = false;
+		c.rejected = false;
+		c.changed = false;
+		op->connections.push_back(c);
+
+		// The handles live in this object, so the sinks refer to the operation without owning it
+		c.handle->set_header_capture(true);
+		c.handle->set_buffer_sink(std::bind(&segmented_download::write_segment, op.get(), i, std::placeholders::_1));
+	}
+
+	operation_ = op;
+
+	if (size_set_)
+	{
+		start(op);
+		return;
+	}
+
+	handles_.push_back(prototype_->duplicate());
+	op->head = handles_.back().get();
+	op->head->set_url(urls_[0]);
+	op->head->set_no_body(true);
+	op->head->set_header_capture(true);
+	op->head->async_perform(std::bind(&segmented_download::handle_head, op, std::placeholders::_1));
+}
+
+void segmented_download::cancel()
+{
+	if (operation_ && !operation_->completed)
+	{
+		complete(operation_, asio::error_code(asio::error::operation_aborted));
+	}
+}
+
+std::uint64_t segmented_download::get_size() const
+{
+	return operation_ ? operation_->size : size_;
+}
+
+std::uint64_t segmented_download::get_bytes_received() const
+{
+	return operation_ ? operation_->received : 0;
+}
+
+std::uint64_t segmented_download::get_bytes_resumed() const
+{
+	return operation_ ? operation_->resumed : 0;
+}
+
+std::size_t segmented_download::get_splits() const
+{
+	return operation_ ? operation_->splits : 0;
+}
+
+std::vector<segmented_download::segment_info> segmented_download::get_segments() const
+{
+	std::vector<segment_info> segments;
+
+	if (operation_)
+	{
+		for (std::size_t i = 0; i < operation_->segments.size(); ++i)
+		{
+			const operation::segment& s = operation_->segments[i];
+			segment_info info;
+			info.begin = s.begin;
+			info.position = s.position;
+			info.end = s.end;
+			info.active = (s.connection != no_index);
+			segments.push_back(info);
+		}
+	}
+
+	return segments;
+}
+
+void segmented_download::handle_head(operation_ptr op, const asio::error_code& err)
+{
+	if (op->completed)
+	{
+		return;
+	}
+
+	if (err)
+	{
+		complete(op, err);
+		return;
+	}
+
+	if (op->head->get_reponse_code() >= 400)
+	{
+		complete(op, asio::error_code(native::CURLE_HTTP_RETURNED_ERROR, asio::system_category()));
+		return;
+	}
+
+	double length = op->head->get_content_length_download();
+
+	if (length < 0)
+	{
+		complete(op, asio::error_code(asio::error::operation_not_supported));
+		return;
+	}
+
+	std::string accept_ranges = op->head->get_response_header("Accept-Ranges");
+	std::transform(accept_ranges.begin(), accept_ranges.end(), accept_ranges.begin(), ::tolower);
+
+	op->size = static_cast<std::uint64_t>(length);
+	op->ranges = (accept_ranges.find("bytes") != std::string::npos);
+	op->etag = op->head->get_response_header("ETag");
+	op->last_modified = op->head->get_response_header("Last-Modified");
+	start(op);
+}
+
+void segmented_download::start(operation_ptr op)
+{
+#if !defined(_WIN32)
+	if (op->size > std::numeric_limits<std::size_t>::max())
+	{
+		complete(op, asio::error_code(asio::error::message_size));
+		return;
+	}
+
+	// An existing file is not truncated, as its contents may be resumed from
+	op->file = ::open(op->path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+	if (op->file == -1)
+	{
+		complete(op, asio::error_code(errno, asio::system_category()));
+		return;
+	}
+
+	if (::ftruncate(op->file, static_cast<off_t>(op->size)) != 0)
+	{
+		complete(op, asio::error_code(errno, asio::system_category()));
+		return;
+	}
+
+#if defined(__linux__)
+	// Allocating the blocks up front turns a full disk into an error here, rather than into SIGBUS when the mapping is written
+	int result = ::posix_fallocate(op->file, 0, static_cast<off_t>(op->size));
+
+	if (result != 0 && result != EOPNOTSUPP && result != EINVAL)
+	{
+		complete(op, asio::error_code(result, asio::system_category()));
+		return;
+	}
+#endif
+
+	if (op->size > 0)
+	{
+		void* mapping = ::mmap(0, static_cast<std::size_t>(op->size), PROT_READ | PROT_WRITE, MAP_SHARED, op->file, 0);
+
+		if (mapping == MAP_FAILED)
+		{
+			complete(op, asio::error_code(errno, asio::system_category()));
+			return;
+		}
+
+		op->mapping = static_cast<char*>(mapping);
+	}
+
+	std::vector<download_journal::range_type> missing(1, download_journal::range_type(0, op->size));
+
+	if (op->journal)
+	{
+		// Without ranges, whatever the journal says cannot be made use of
+		if (op->ranges && op->journal->load() && op->journal->matches(op->size, op->etag, op->last_modified))
+		{
+			missing = op->journal->get_missing();
+			op->resumed = op->journal->get_completed_bytes();
+		}
+		else
+		{
+			op->journal->reset(op->size, op->etag, op->last_modified);
+		}
+
+		op->timer = std::make_shared<asio::steady_timer>(*op->io_service);
+		op->timer->expires_from_now(op->journal->get_interval());
+		op->timer->async_wait(std::bind(&segmented_download::handle_checkpoint, op, std::placeholders::_1));
+	}
+
+	// Weak ETags are not allowed in If-Range
+	op->validator = (!op->etag.empty() && op->etag.compare(0, 2, "W/") != 0) ? op->etag : op->last_modified;
+
+	if (op->ranges && !op->validator.empty())
+	{
+		for (std::size_t i = 0; i < op->connections.size(); ++i)
+		{
+			// The headers of the prototype are shared with its duplicates, hence each handle gets a copy with If-Range added
+			std::shared_ptr<string_list> prototype_headers = op->connections[i].handle->get_headers();
+			std::shared_ptr<string_list> headers = std::make_shared<string_list>();
+
+			for (native::curl_slist* header = prototype_headers ? prototype_headers->native_handle() : 0; header; header = header->next)
+			{
+				headers->add(header->data);
+			}
+
+			headers->add("If-Range: " + op->validator);
+			op->connections[i].handle->set_headers(headers);
+		}
+	}
+
+	// Without ranges there is nothing to share out
+	std::vector<segment_info> segments;
+
+	if (op->size > 0)
+	{
+		add_segments(segments, missing, op->ranges ? op->connections.size() : 1, op->ranges ? op->min_segment_size : op->size);
+	}
+
+	if (!op->ranges)
+	{
+		op->connections.resize(1);
+	}
+
+	for (std::size_t i = 0; i < segments.size(); ++i)
+	{
+		operation::segment s;
+		s.begin = segments[i].begin;
+		s.position = s.begin;
+		s.end = segments[i].end;
+		s.connection = no_index;
+		s.attempts = 0;
+		op->segments.push_back(s);
+	}
+
+	schedule(op);
+#else
+	// No mapping support here yet
+	complete(op, asio::error_code(asio::error::operation_not_supported));
+#endif
+}
+
+void segmented_download::schedule(operation_ptr op)
+{
+	bool busy = false;
+
+	for (std::size_t i = 0; i < op->connections.size(); ++i)
+	{
+		if (op->connections[i].segment == no_index)
+		{
+			std::size_t segment = next_segment(op.get());
+
+			if (segment != no_index)
+			{
+				start_transfer(op, i, segment);
+			}
+		}
+
+		busy = busy || (op->connections[i].segment != no_index);
+	}
+
+	if (!busy)
+	{
+		complete(op, asio::error_code());
+	}
+}
+
+std::size_t segmented_download::next_segment(operation* op)
+{
+	std::size_t largest = no_index;
+	std::uint64_t largest_remaining = 0;
+
+	for (std::size_t i = 0; i < op->segments.size(); ++i)
+	{
+		const operation::segment& s = op->segments[i];
+
+		if (s.position >= s.end)
+		{
+			continue;
+		}
+
+		if (s.connection == no_index)
+		{
+			return i;
+		}
+
+		if (s.end - s.position > largest_remaining)
+		{
+			largest = i;
+			largest_remaining = s.end - s.position;
+		}
+	}
+
+	// Splitting leaves the running request alone; it is cut off once it reaches its new end
+	if (!op->ranges || largest == no_index || largest_remaining < 2 * op->min_segment_size)
+	{
+		return no_index;
+	}
+
+	operation::segment tail;
+	tail.begin = op->segments[largest].position + largest_remaining / 2;
+	tail.position = tail.begin;
+	tail.end = op->segments[largest].end;
+	tail.connection = no_index;
+	tail.attempts = 0;
+
+	op->segments[largest].end = tail.begin;
+	op->segments.push_back(tail);
+	++op->splits;
+	return op->segments.size() - 1;
+}
+
+void segmented_download::start_transfer(operation_ptr op, std::size_t connection, std::size_t segment)
+{
+	operation::connection& c = op->connections[connection];
+	operation::segment& s = op->segments[segment];
+
+	c.segment = segment;
+	c.checked = false;
+	c.rejected = false;
+	c.changed = false;
+	s.connection = connection;
+
+	c.handle->set_url(op->urls[c.mirror]);
+
+	if (op->ranges)
+	{
+		c.handle->set_range(std::to_string(s.position) + "-" + std::to_string(s.end - 1));
+	}
+
+	c.handle->async_perform(std::bind(&segmented_download::handle_transfer, op, connection, std::placeholders::_1));
+}
+
+std::size_t segmented_download::write_segment(operation* op, std::size_t connection, const asio::const_buffer& data)
+{
+	operation::connection& c = op->connections[connection];
+	operation::segment& s = op->segments[c.segment];
+
+	// Error pages and ranges other than the one asked for must not end up in the file
+	if (!c.checked)
+	{
+		std::uint64_t start = 0;
+		long response_code = c.handle->get_reponse_code();
+
+		// With If-Range, a whole object instead of the range means it is not the one the download started with
+		if (op->ranges && response_code == 200 && !op->validator.empty())
+		{
+			c.changed = true;
+			return 0;
+		}
+
+		if (op->ranges ? (response_code != 206 || !parse_range_start(c.handle->get_response_header("Content-Range"), start) || start != s.position) : response_code != 200)
+		{
+			c.rejected = true;
+			return 0;
+		}
+
+		c.checked = true;
+	}
+
+	std::size_t size = static_cast<std::size_t>(std::min<std::uint64_t>(asio::buffer_size(data), s.end - s.position));
+	std::memcpy(op->mapping + s.position, asio::buffer_cast<const char*>(data), size);
+	s.position += size;
+	op->received += size;
+
+	// Returning less ends a request whose segment was split, or a server sending more than asked for
+	return size;
+}
+
+void segmented_download::handle_transfer(operation_ptr op, std::size_t connection, const asio::error_code& err)
+{
+	if (op->completed)
+	{
+		return;
+	}
+
+	operation::connection& c = op->connections[connection];
+	operation::segment& s = op->segments[c.segment];
+	c.segment = no_index;
+	s.connection = no_index;
+
+	// A segment may well be complete despite an error, namely when it was cut off after a split
+	if (s.position < s.end)
+	{
+		asio::error_code ec = err;
+
+		if (c.changed)
+		{
+			complete(op, errc::wrapper::make_error_code(errc::wrapper::resource_changed));
+			return;
+		}
+
+		if (c.rejected)
+		{
+			ec = asio::error_code(native::CURLE_HTTP_RETURNED_ERROR, asio::system_category());
+		}
+		else if (!ec)
+		{
+			ec = asio::error_code(native::CURLE_PARTIAL_FILE, asio::system_category());
+		}
+
+		if (++s.attempts >= op->max_attempts)
+		{
+			complete(op, ec);
+			return;
+		}
+
+		// The segment resumes where it stopped, from the next mirror; plain requests start over
+		c.mirror = (c.mirror + 1) % op->urls.size();
+
+		if (!op->ranges)
+		{
+			op->received -= s.position - s.begin;
+			s.position = s.begin;
+		}
+	}
+
+	schedule(op);
+}
+
+void segmented_download::handle_checkpoint(operation_ptr op, const asio::error_code& err)
+{
+	if (err || op->completed)
+	{
+		return;
+	}
+
+	checkpoint(op);
+}
+
+void segmented_download::checkpoint(operation_ptr op)
+{
+	for (std::size_t i = 0; i < op->segments.size(); ++i)
+	{
+		op->journal->add_completed(op->segments[i].begin, op->segments[i].position);
+	}
+
+	// The worker saves a copy, as this journal goes on recording progress in the meantime
+	std::shared_ptr<download_journal> snapshot = std::make_shared<download_journal>(op->journal->get_path());
+	snapshot->reset(op->journal->get_size(), op->journal->get_etag(), op->journal->get_last_modified());
+	const std::vector<download_journal::range_type>& completed = op->journal->get_completed();
+
+	for (std::size_t i = 0; i < completed.size(); ++i)
+	{
+		snapshot->add_completed(completed[i].first, completed[i].second);
+	}
+
+	int file = -1;
+
+#if !defined(_WIN32)
+	// Starts writing the mapping back, which the worker waits for
+	::msync(op->mapping, static_cast<std::size_t>(op->size), MS_ASYNC);
+	file = ::dup(op->file);
+#endif
+
+	// The work keeps the io_service running until the save has been reported back
+	std::function<void()> done = std::bind(&segmented_download::handle_checkpoint_saved, op, std::make_shared<asio::io_service::work>(*op->io_service));
+	op->checkpointing = true;
+	op->worker->io_service.post(std::bind(&segmented_download::save_checkpoint, std::ref(*op->io_service), file, snapshot, std::move(done)));
+}
+
+void segmented_download::save_checkpoint(asio::io_service& io_service, int file, std::shared_ptr<download_journal> journal, std::function<void()>& done)
+{
+#if !defined(_WIN32)
+#if defined(__APPLE__)
+	bool synced = (file != -1 && ::fsync(file) == 0);
+#else
+	bool synced = (file != -1 && ::fdatasync(file) == 0);
+#endif
+
+	if (file != -1)
+	{
+		::close(file);
+	}
+
+	// The journal may only claim what is on disk. One which cannot be written costs progress after a crash, but not the download.
+	if (synced)
+	{
+		asio::error_code ec;
+		journal->save(ec);
+	}
+#endif
+
+	// Moving the handler out of the job leaves the worker without a reference to the operation, which must only be destroyed on the io_service's thread. That also keeps the worker from joining itself.
+	io_service.post(std::move(done));
+}
+
+void segmented_download::handle_checkpoint_saved(operation_ptr op, std::shared_ptr<asio::io_service::work>)
+{
+	op->checkpointing = false;
+
+	if (op->finished)
+	{
+		op->io_service->post(std::bind(op->handler, op->error));
+	}
+	else if (op->completed)
+	{
+		finish(op);
+	}
+	else
+	{
+		op->timer->expires_from_now(op->journal->get_interval());
+		op->timer->async_wait(std::bind(&segmented_download::handle_checkpoint, op, std::placeholders::_1));
+	}
+}
+
+void segmented_download::complete(operation_ptr op, const asio::error_code& err)
+{
+	op->completed = true;
+	op->error = err;
+
+	if (op->timer)
+	{
+		op->timer->cancel();
+	}
+
+	for (std::size_t i = 0; i < op->connections.size(); ++i)
+	{
+		if (op->connections[i].segment != no_index)
+		{
+			op->connections[i].handle->cancel();
+		}
+	}
+
+	if (op->head)
+	{
+		op->head->cancel();
+	}
+
+	// A save in progress is waited for, so that it cannot bring back a journal deleted here or overwrite the final one
+	if (!op->checkpointing)
+	{
+		finish(op);
+	}
+}
+
+void segmented_download::finish(operation_ptr op)
+{
+	op->finished = true;
+
+	if (op->journal && (!op->error || op->error == errc::wrapper::make_error_code(errc::wrapper::resource_changed)))
+	{
+		// A journal of an object which has changed is of no use either
+		op->journal->remove();
+	}
+	else if (op->journal && op->mapping)
+	{
+		// The handler runs once the final checkpoint has been saved
+		checkpoint(op);
+	}
+
+#if !defined(_WIN32)
+	if (op->mapping)
+	{
+		::munmap(op->mapping, static_cast<std::size_t>(op->size));
+		op->mapping = 0;
+	}
+
+	if (op->file != -1)
+	{
+		::close(op->file);
+		op->file = -1;
+	}
+#endif
+
+	if (!op->checkpointing)
+	{
+		op->io_service->post(std::bind(op->handler, op->error));
+	}
+}
@@ -0,0 +1,235 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Response body kept in memory up to a threshold and in a memory-mapped temporary file beyond it
+*/
+
+#include <curl-asio/spill_buffer.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace curl;
+
+spill_buffer::spill_buffer(std::size_t threshold):
+	threshold_(threshold),
+	size_(0),
+	file_(-1),
+	mapping_(0),
+	mapping_size_(0)
+{
+	const char* temp_directory = std::getenv("TMPDIR");
+	temp_directory_ = (temp_directory && *temp_directory) ? temp_directory : "/tmp";
+}
+
+spill_buffer::~spill_buffer()
+{
+	clear();
+}
+
+void spill_buffer::set_temp_directory(const std::string& path)
+{
+	temp_directory_ = path;
+}
+
+void spill_buffer::reserve(std::size_t size)
+{
+	asio::error_code ec;
+	reserve(size, ec);
+	asio::detail::throw_error(ec, "reserve");
+}
+
+void spill_buffer::reserve(std::size_t size, asio::error_code& ec)
+{
+	ec = asio::error_code();
+
+	if (is_spilled())
+	{
+		if (size > mapping_size_)
+		{
+			extend(size, ec);
+		}
+	}
+	else if (size > threshold_)
+	{
+		spill(size, ec);
+	}
+	else
+	{
+		memory_.reserve(size);
+	}
+
+	if (ec)
+	{
+		error_ = ec;
+	}
+}
+
+void spill_buffer::append(const char* data, std::size_t size)
+{
+	asio::error_code ec;
+	append(data, size, ec);
+	asio::detail::throw_error(ec, "append");
+}
+
+void spill_buffer::append(const char* data, std::size_t size, asio::error_code& ec)
+{
+	ec = asio::error_code();
+
+	if (!is_spilled() && size_ + size > threshold_)
+	{
+		spill(std::max(size_ + size, threshold_ * 2), ec);
+	}
+	else if (is_spilled() && size_ + size > mapping_size_)
+	{
+		extend(std::max(size_ + size, mapping_size_ * 2), ec);
+	}
+
+	if (ec)
+	{
+		error_ = ec;
+		return;
+	}
+
+	if (is_spilled())
+	{
+		std::memcpy(mapping_ + size_, data, size);
+	}
+	else
+	{
+		memory_.append(data, size);
+	}
+
+	size_ += size;
+}
+
+void spill_buffer::clear()
+{
+	unmap();
+
+#if !defined(_WIN32)
+	if (file_ != -1)
+	{
+		::close(file_);
+		file_ = -1;
+	}
+#endif
+
+	std::string().swap(memory_);
+	size_ = 0;
+	error_ = asio::error_code();
+}
+
+void spill_buffer::spill(std::size_t capacity, asio::error_code& ec)
+{
+#if !defined(_WIN32)
+	int fd = -1;
+
+#if defined(O_TMPFILE)
+	// The file never gets a name, so nothing is left behind if the process dies
+	fd = ::open(temp_directory_.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+
+	if (fd == -1)
+	{
+		std::string path = temp_directory_ + "/curl-asio-XXXXXX";
+		std::vector<char> path_buffer(path.begin(), path.end());
+		path_buffer.push_back('\0');
+		fd = ::mkstemp(&path_buffer[0]);
+
+		if (fd != -1)
+		{
+			::unlink(&path_buffer[0]);
+			::fcntl(fd, F_SETFD, FD_CLOEXEC);
+		}
+	}
+
+	if (fd == -1)
+	{
+		ec = asio::error_code(errno, asio::system_category());
+		return;
+	}
+
+	file_ = fd;
+	extend(capacity, ec);
+
+	if (ec)
+	{
+		::close(file_);
+		file_ = -1;
+		return;
+	}
+
+	std::memcpy(mapping_, memory_.data(), size_);
+	std::string().swap(memory_);
+#else
+	// No mapping support here yet, so the body grows in memory
+	memory_.reserve(capacity);
+#endif
+}
+
+void spill_buffer::extend(std::size_t capacity, asio::error_code& ec)
+{
+#if !defined(_WIN32)
+#if defined(__linux__)
+	// Allocating the blocks up front turns a full disk into an error here, rather than into SIGBUS when the mapping is written
+	int result = ::posix_fallocate(file_, 0, static_cast<off_t>(capacity));
+
+	if (result != 0 && result != EOPNOTSUPP && result != EINVAL)
+	{
+		ec = asio::error_code(result, asio::system_category());
+		return;
+	}
+
+	if (result != 0 && ::ftruncate(file_, static_cast<off_t>(capacity)) != 0)
+#else
+	if (::ftruncate(file_, static_cast<off_t>(capacity)) != 0)
+#endif
+	{
+		ec = asio::error_code(errno, asio::system_category());
+		return;
+	}
+
+	// Either way, the previous mapping stays valid until the new one is in place
+#if defined(__linux__)
+	void* mapping = mapping_ ? ::mremap(mapping_, mapping_size_, capacity, MREMAP_MAYMOVE) : ::mmap(0, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, file_, 0);
+#else
+	void* mapping = ::mmap(0, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, file_, 0);
+#endif
+
+	if (mapping == MAP_FAILED)
+	{
+		ec = asio::error_code(errno, asio::system_category());
+		return;
+	}
+
+#if !defined(__linux__)
+	unmap();
+#endif
+
+	mapping_ = static_cast<char*>(mapping);
+	mapping_size_ = capacity;
+#endif
+}
+
+void spill_buffer::unmap()
+{
+#if !defined(_WIN32)
+	if (mapping_)
+	{
+		::munmap(mapping_, mapping_size_);
+		mapping_ = 0;
+		mapping_size_ = 0;
+	}
+#endif
+}
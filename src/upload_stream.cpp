@@ -0,0 +1,120 @@
+/**
+	curl-asio: wrapper for integrating libcurl with boost.asio applications
+	Copyright (c) 2013 Oliver Kuckertz <oliver.kuckertz@mologie.de>
+	See COPYING for license information.
+
+	Request body of a transfer exposed as an asio AsyncWriteStream
+*/
+
+#include <curl-asio/easy.h>
+#include <curl-asio/upload_stream.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace curl;
+
+upload_stream::upload_stream(asio::io_service& io_service):
+	io_service_(io_service),
+	bytes_sent_(0),
+	paused_(0),
+	closed_(false),
+	finished_(false)
+{
+}
+
+upload_stream::~upload_stream()
+{
+}
+
+void upload_stream::close()
+{
+	closed_ = true;
+
+	// libcurl learns about the end of the body from the next call of the read callback
+	resume();
+}
+
+void upload_stream::start_write(asio::const_buffer buffer, write_handler_type handler)
+{
+	if (finished_ || closed_)
+	{
+		io_service_.post(std::bind(handler, error_ ? error_ : asio::error_code(asio::error::broken_pipe), 0));
+		return;
+	}
+
+	if (asio::buffer_size(buffer) == 0)
+	{
+		io_service_.post(std::bind(handler, asio::error_code(), 0));
+		return;
+	}
+
+	write_buffer_ = buffer;
+	write_handler_ = handler;
+	resume();
+}
+
+void upload_stream::reset()
+{
+	write_handler_ = write_handler_type();
+	write_buffer_ = asio::const_buffer();
+	bytes_sent_ = 0;
+	paused_ = 0;
+	closed_ = false;
+	finished_ = false;
+	error_ = asio::error_code();
+}
+
+std::size_t upload_stream::read(easy* easy_handle, char* data, std::size_t size)
+{
+	if (!write_handler_)
+	{
+		if (closed_)
+		{
+			return 0;
+		}
+
+		paused_ = easy_handle;
+		return CURL_READFUNC_PAUSE;
+	}
+
+	// Completing the write with fewer bytes than requested is fine for write_some; asio::async_write simply writes the rest
+	std::size_t n = std::min(size, asio::buffer_size(write_buffer_));
+	std::memcpy(data, asio::buffer_cast<const char*>(write_buffer_), n);
+	bytes_sent_ += n;
+
+	complete_write(asio::error_code(), n);
+	return n;
+}
+
+void upload_stream::finish(const asio::error_code& err)
+{
+	finished_ = true;
+	error_ = err;
+	paused_ = 0;
+
+	if (write_handler_)
+	{
+		complete_write(err ? err : asio::error_code(asio::error::broken_pipe), 0);
+	}
+}
+
+void upload_stream::complete_write(const asio::error_code& err, std::size_t size)
+{
+	write_handler_type handler;
+	handler.swap(write_handler_);
+	write_buffer_ = asio::const_buffer();
+	io_service_.post(std::bind(handler, err, size));
+}
+
+void upload_stream::resume()
+{
+	if (paused_)
+	{
+		// libcurl might call the read callback from within curl_easy_pause
+		easy* easy_handle = paused_;
+		paused_ = 0;
+
+		asio::error_code ec;
+		easy_handle->release_pause(easy::pause_send, easy::pause_by_source, ec);
+	}
+}